@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <atomic>
+
+#include "CommandQueue.hpp"
+#include "CommandPool.hpp"
+
+/*
+  Measures how long producer threads spend in CommandQueue::Enqueue while a
+  consumer thread drains the queue the same way the render thread does.
+
+  For comparison, the same workload is run against a queue guarded by a single
+  mutex (the implementation CommandQueue replaced).
+
+  Every enqueue gets its own command from a <RenderCommandPool>, like the renderer's
+  streaming updates, since the queue writes its bookkeeping into the command.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr size_t CommandsPerProducer = 200000;
+
+class NoopCommand : public ar::PooledRenderCommand<NoopCommand>
+{
+public:
+  using PooledRenderCommand::PooledRenderCommand;
+
+  virtual void execute() override { }
+};
+
+// The previous CommandQueue: one mutex shared by all producers and the consumer
+class MutexCommandQueue
+{
+public:
+  void Enqueue(ar::RenderCommand* command)
+  {
+    ar::MutexLockGuard guard(_mutex);
+    _commands.push(command);
+  }
+
+  size_t DequeueAll(ar::Vector<ar::RenderCommand*>& commands)
+  {
+    ar::MutexLockGuard guard(_mutex);
+    const size_t numCommands = _commands.size();
+    for (; !_commands.empty(); _commands.pop())
+      commands.push_back(_commands.front());
+    return numCommands;
+  }
+
+private:
+  std::mutex _mutex;
+  std::queue<ar::RenderCommand*> _commands;
+};
+
+struct Result
+{
+  double p50;
+  double p99;
+  double max;
+  double throughput; // commands per second, summed over all producers
+};
+
+template <typename QueueT>
+Result run(int numProducers)
+{
+  QueueT queue;
+  ar::RenderCommandPool<NoopCommand> pool(1 << 14);
+  std::atomic_bool producing(true);
+  std::atomic_int ready(0);
+  std::atomic_bool go(false);
+
+  // consumer: drain and execute like Renderer::Update
+  std::thread consumer([&]()
+  {
+    ar::Vector<ar::RenderCommand*> commands;
+    commands.reserve(CommandsPerProducer);
+    auto drain = [&]()
+    {
+      const size_t numCommands = queue.DequeueAll(commands);
+      for (auto c : commands)
+      {
+        c->execute();
+        c->release();
+      }
+      commands.clear();
+      return numCommands;
+    };
+
+    while (producing)
+      drain();
+    while (drain() > 0) { }
+  });
+
+  ar::Vector<ar::Vector<float>> latencies(numProducers);
+  ar::Vector<std::thread> producers;
+  Clock::time_point start;
+
+  for (int p = 0; p < numProducers; p++)
+  {
+    producers.emplace_back([&, p]()
+    {
+      auto& samples = latencies[p];
+      samples.resize(CommandsPerProducer);
+
+      ready++;
+      while (!go)
+        std::this_thread::yield();
+
+      for (size_t i = 0; i < CommandsPerProducer; i++)
+      {
+        NoopCommand* command = pool.Acquire();
+        const auto t0 = Clock::now();
+        queue.Enqueue(command);
+        const auto t1 = Clock::now();
+        samples[i] = std::chrono::duration<float, std::nano>(t1 - t0).count();
+      }
+    });
+  }
+
+  while (ready < numProducers)
+    std::this_thread::yield();
+
+  start = Clock::now();
+  go = true;
+
+  for (auto& t : producers)
+    t.join();
+
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  producing = false;
+  consumer.join();
+
+  ar::Vector<float> all;
+  all.reserve(numProducers * CommandsPerProducer);
+  for (auto& samples : latencies)
+    all.insert(all.end(), samples.begin(), samples.end());
+  std::sort(all.begin(), all.end());
+
+  Result r;
+  r.p50 = all[all.size() / 2];
+  r.p99 = all[all.size() * 99 / 100];
+  r.max = all.back();
+  r.throughput = (double)all.size() / seconds;
+  return r;
+}
+
+static void print(const char* name, int numProducers, const Result& r)
+{
+  printf("%-10s %9d %10.0f %10.0f %12.0f %14.2f\n", name, numProducers, r.p50, r.p99, r.max, r.throughput / 1e6);
+}
+
+int main(void)
+{
+  printf("Enqueue latency, %zu commands per producer (times in ns)\n\n", CommandsPerProducer);
+  printf("%-10s %9s %10s %10s %12s %14s\n", "queue", "producers", "p50", "p99", "max", "Mcmds/s");
+
+  for (int numProducers : { 1, 2, 4, 8, 16 })
+  {
+    print("mutex", numProducers, run<MutexCommandQueue>(numProducers));
+    print("lock-free", numProducers, run<ar::CommandQueue>(numProducers));
+  }
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "mesh/MeshFactory.hpp"
+#include "geometry/PolyMesh.hpp"
+
+/*
+  Counts the heap allocations and bytes allocated for every ARVisualizer::Add(PolyMesh),
+  from the caller's arrays to the mesh data in the renderer's vertex & index buffers.
+
+  The previous path is replayed step by step: the PolyMesh was collected into three
+  vectors with push_back, MeshFactory took those by value, the Mesh was copied into
+  the render command, and the renderer got its vertices & indices from by-value getters.
+  The current path builds the Mesh straight from the PolyMesh arrays and moves it along.
+  Both append the mesh to a CPU copy of the vertex & index buffer, like the MeshRenderer.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr int Runs = 200;
+
+static size_t numAllocations = 0;
+static size_t numBytesAllocated = 0;
+
+void* operator new(size_t size)
+{
+  numAllocations++;
+  numBytesAllocated += size;
+  if (void* p = std::malloc(size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+typedef ar::Mesh<ar::VertexP3N3> Mesh3D;
+
+// CPU side of the mesh renderer's vertex & index buffers
+struct Buffers
+{
+  ar::Vector<ar::VertexP3N3> vertices;
+  ar::Vector<GLuint> indices;
+
+  void Append(const ar::Vector<ar::VertexP3N3>& v, const ar::Vector<GLuint>& i)
+  {
+    vertices.insert(vertices.end(), v.begin(), v.end());
+    indices.insert(indices.end(), i.begin(), i.end());
+  }
+};
+
+// MeshFactory::MakeTriangleMesh as it was, with its arguments taken by value
+static Mesh3D legacyMakeTriangleMesh(ar::Vector<glm::vec3> vertexPositions, ar::Vector<GLuint> indices, ar::Vector<glm::vec3> normals)
+{
+  ar::Vector<ar::VertexP3N3> vertices;
+  for (size_t i = 0; i < vertexPositions.size(); i++)
+  {
+    vertices.push_back({
+      { vertexPositions[i].x, vertexPositions[i].y, vertexPositions[i].z },
+      { normals[i].x, normals[i].y, normals[i].z }
+    });
+  }
+
+  // the Mesh constructor took its arguments by value and copied them into its members
+  ar::Vector<ar::VertexP3N3> vertexArgument = vertices;
+  ar::Vector<GLuint> indexArgument = indices;
+  ar::Vector<ar::VertexP3N3> meshVertices = vertexArgument;
+  ar::Vector<GLuint> meshIndices = indexArgument;
+  return Mesh3D(std::move(meshVertices), std::move(meshIndices));
+}
+
+static void legacyAdd(const ar::PolyMesh& mesh, Buffers& buffers)
+{
+  ar::Vector<glm::vec3> vertices;
+  ar::Vector<glm::vec3> normals;
+  ar::Vector<GLuint> indices;
+
+  for (size_t i = 0; i < mesh.numPoints * 3; i += 3)
+  {
+    vertices.push_back({ mesh.points[i], mesh.points[i+1], mesh.points[i+2] });
+    normals.push_back({ mesh.normals[i], mesh.normals[i+1], mesh.normals[i+2] });
+  }
+  for (size_t i = 0; i < mesh.numIndices; i++)
+    indices.push_back(mesh.indices[i]);
+
+  const Mesh3D made = legacyMakeTriangleMesh(vertices, indices, normals);
+
+  // RenderCommandAddMesh copied the mesh
+  Mesh3D* command = new Mesh3D(made);
+
+  // the renderer got copies from GetVertices() & GetIndices()
+  const ar::Vector<ar::VertexP3N3> meshVertices = command->GetVertices();
+  const ar::Vector<GLuint> meshIndices = command->GetIndices();
+  buffers.Append(meshVertices, meshIndices);
+
+  delete command;
+}
+
+static void currentAdd(const ar::PolyMesh& mesh, Buffers& buffers)
+{
+  Mesh3D made = ar::MeshFactory::MakeTriangleMesh<Mesh3D>(mesh.points, mesh.numPoints, mesh.indices, mesh.numIndices, mesh.normals);
+  Mesh3D* command = new Mesh3D(std::move(made));
+
+  buffers.Append(command->GetVertices(), command->GetIndices());
+
+  delete command;
+}
+
+struct Result
+{
+  double allocations; // per Add
+  double bytes;       // per Add
+  double micros;      // per Add
+};
+
+template <typename F>
+static Result measure(const ar::PolyMesh& mesh, F add)
+{
+  // the buffers have room for the mesh already, like after removing a mesh of the same size
+  Buffers buffers;
+  buffers.vertices.reserve(mesh.numPoints);
+  buffers.indices.reserve(mesh.numIndices);
+
+  const size_t allocations0 = numAllocations;
+  const size_t bytes0 = numBytesAllocated;
+  const auto t0 = Clock::now();
+  for (int run = 0; run < Runs; run++)
+  {
+    buffers.vertices.clear();
+    buffers.indices.clear();
+    add(mesh, buffers);
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+  Result result;
+  result.allocations = (double)(numAllocations - allocations0) / Runs;
+  result.bytes = (double)(numBytesAllocated - bytes0) / Runs;
+  result.micros = seconds * 1e6 / Runs;
+  return result;
+}
+
+int main(void)
+{
+  // a grid of quads with normals, like a height map
+  const unsigned int sizes[] = { 16, 128, 512 };
+
+  printf("Add(PolyMesh) ingest, per mesh\n\n");
+  printf("%-10s %-8s %12s %14s %16s %10s\n", "vertices", "path", "allocations", "bytes", "x mesh size", "us");
+
+  for (unsigned int n : sizes)
+  {
+    std::vector<double> points, normals;
+    std::vector<unsigned int> indices;
+    for (unsigned int y = 0; y < n; y++)
+    {
+      for (unsigned int x = 0; x < n; x++)
+      {
+        points.insert(points.end(), { (double)x, (double)y, (double)((x * y) % 7) * 0.1 });
+        normals.insert(normals.end(), { 0.0, 0.0, 1.0 });
+        if (x + 1 < n && y + 1 < n)
+        {
+          const unsigned int i = y * n + x;
+          indices.insert(indices.end(), { i, i + 1, i + n, i + 1, i + n + 1, i + n });
+        }
+      }
+    }
+
+    const ar::PolyMesh mesh(points.data(), n * n, indices.data(), indices.size(), normals.data());
+    const double payload = (double)mesh.numPoints * sizeof(ar::VertexP3N3) + (double)mesh.numIndices * sizeof(GLuint);
+
+    const Result legacy = measure(mesh, legacyAdd);
+    const Result current = measure(mesh, currentAdd);
+
+    printf("%-10u %-8s %12.1f %14.0f %16.2f %10.1f\n", n * n, "before", legacy.allocations, legacy.bytes, legacy.bytes / payload, legacy.micros);
+    printf("%-10u %-8s %12.1f %14.0f %16.2f %10.1f\n", n * n, "after", current.allocations, current.bytes, current.bytes / payload, current.micros);
+
+    delete[] mesh.points;
+    delete[] mesh.normals;
+    delete[] mesh.indices;
+  }
+
+  return 0;
+}
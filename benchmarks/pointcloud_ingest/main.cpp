@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#include "pointcloud/PointCloudIngest.hpp"
+
+/*
+  Measures how fast colored PCL points are converted to the format the point
+  cloud renderer stores them in, on the producer thread.
+
+  Compares the plain copy colored clouds were made with before (vector::assign of
+  the 32 byte PCL points) with the scalar, SSE2 and AVX2 ingest kernels, which
+  write 16 byte points and drop the invalid ones. The input looks like an organized
+  640x480 depth camera frame, where about a third of the points are NaN.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr size_t NumPoints = 640 * 480;
+static constexpr int Runs = 200;
+
+// @return Input points per second, in millions
+template <typename F>
+static double measure(F convert)
+{
+  convert(); // warm up
+
+  const auto t0 = Clock::now();
+  for (int run = 0; run < Runs; run++)
+    convert();
+  const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+  return (double)NumPoints * Runs / seconds / 1e6;
+}
+
+int main(void)
+{
+  std::vector<ar::Vertex_PCL_PointXYZRGBA> points(NumPoints);
+  for (size_t i = 0; i < NumPoints; i++)
+  {
+    auto& point = points[i];
+    const bool valid = (i * 2654435761u) % 10 >= 3;
+    point.position[0] = valid ? (float)(i % 640) * 0.01f : std::numeric_limits<float>::quiet_NaN();
+    point.position[1] = valid ? (float)(i / 640) * 0.01f : std::numeric_limits<float>::quiet_NaN();
+    point.position[2] = valid ? 1.0f + (float)(i % 7) * 0.1f : std::numeric_limits<float>::quiet_NaN();
+    point.position[3] = 1.0f;
+    point.color = 0xFF000000u | (uint32_t)(i * 0x010203u & 0xFFFFFFu);
+  }
+
+  printf("Colored point cloud ingest, %zu points per frame (million input points/s)\n\n", NumPoints);
+
+  std::vector<ar::Vertex_PCL_PointXYZRGBA> copied;
+  const double copy = measure([&]()
+  {
+    copied.assign(points.begin(), points.end());
+  });
+  printf("%-8s %10.1f\n", "assign", copy);
+
+  const char* names[] = { "scalar", "sse2", "avx2" };
+  const ar::IngestKernel kernels[] = { ar::IngestKernel::Scalar, ar::IngestKernel::SSE2, ar::IngestKernel::AVX2 };
+
+  std::vector<ar::VertexP3RGBA> ingested(NumPoints);
+  for (int k = 0; k < 3; k++)
+  {
+    if (!ar::IsIngestKernelSupported(kernels[k]))
+    {
+      printf("%-8s %10s\n", names[k], "n/a");
+      continue;
+    }
+
+    size_t numValid = 0;
+    const double rate = measure([&]()
+    {
+      numValid = ar::IngestPoints(points.data(), NumPoints, ingested.data(), true, kernels[k]);
+    });
+    printf("%-8s %10.1f   (%zu points kept)\n", names[k], rate, numValid);
+  }
+
+  return 0;
+}
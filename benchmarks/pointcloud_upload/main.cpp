@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "rendering/StreamingVertexBuffer.hpp"
+#include "mesh/Vertex.hpp"
+
+/*
+  Measures point cloud upload throughput the way the render thread uses a cloud's
+  vertex buffer: every frame the points are replaced and drawn once.
+
+  Compares reallocating the buffer on every upload (the regular point cloud path),
+  orphaning plus glBufferSubData, and the segmented StreamingVertexBuffer.
+  Draws go to a small hidden window, so the GPU is busy with the previous frames
+  while the next upload happens, like in the visualizer.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr int FramesPerRun = 60;
+
+static const char* VertexShader =
+  "#version 330 core\n"
+  "layout(location = 0) in vec4 position;\n"
+  "void main() { gl_Position = vec4(position.xyz * 0.001, 1.0); }\n";
+
+static const char* FragmentShader =
+  "#version 330 core\n"
+  "out vec4 color;\n"
+  "void main() { color = vec4(1.0); }\n";
+
+enum class UploadMode
+{
+  Reallocate,
+  OrphanSubData,
+  Streaming
+};
+
+static GLuint compileProgram()
+{
+  GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(vs, 1, &VertexShader, nullptr);
+  glCompileShader(vs);
+
+  GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(fs, 1, &FragmentShader, nullptr);
+  glCompileShader(fs);
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  return program;
+}
+
+// @return Upload throughput in GB/s
+static double run(UploadMode mode, const ar::Vector<ar::VertexP4>& points, size_t& numOrphans)
+{
+  ar::StreamingVertexBuffer<ar::VertexP4> buffer;
+  buffer.SetStreaming(mode == UploadMode::Streaming);
+  buffer.Init();
+
+  double uploadSeconds = 0.0;
+  size_t capacity = 0;
+
+  for (int frame = 0; frame < FramesPerRun; frame++)
+  {
+    const auto t0 = Clock::now();
+    if (mode == UploadMode::OrphanSubData)
+    {
+      const size_t size = points.size() * sizeof(ar::VertexP4);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer._vbo);
+      if (size > capacity)
+        capacity = size;
+      glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, size, points.data());
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    else
+    {
+      buffer.BufferVertices(points.data(), points.size());
+    }
+    uploadSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindVertexArray(buffer._vao);
+    glDrawArrays(GL_POINTS, buffer.FirstVertex(), points.size());
+    glBindVertexArray(0);
+    buffer.FenceDraw();
+    glFlush();
+  }
+
+  glFinish();
+  numOrphans = buffer.NumOrphans();
+  buffer.Release();
+
+  return (double)points.size() * sizeof(ar::VertexP4) * FramesPerRun / uploadSeconds / 1e9;
+}
+
+int main(void)
+{
+  if (!glfwInit())
+  {
+    fprintf(stderr, "Failed to initialize GLFW\n");
+    return 1;
+  }
+
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  GLFWwindow* window = glfwCreateWindow(256, 256, "benchmark", nullptr, nullptr);
+  if (window == nullptr)
+  {
+    fprintf(stderr, "Failed to create an OpenGL 3.3 context\n");
+    glfwTerminate();
+    return 1;
+  }
+  glfwMakeContextCurrent(window);
+
+  GLuint program = compileProgram();
+  glUseProgram(program);
+
+  printf("Point cloud upload throughput, %d frames per run (GB/s, VertexP4)\n\n", FramesPerRun);
+  printf("%-10s %12s %14s %12s %14s\n", "points", "reallocate", "orphan+subdata", "streaming", "stream orphans");
+
+  for (size_t numPoints : { 300000, 1000000, 2000000, 5000000 })
+  {
+    ar::Vector<ar::VertexP4> points(numPoints);
+    for (size_t i = 0; i < numPoints; i++)
+    {
+      const GLfloat p[4] = { (GLfloat)(i % 1000), (GLfloat)(i / 1000 % 1000), (GLfloat)(i % 7), 1.0f };
+      std::memcpy(points[i].position, p, sizeof(p));
+    }
+
+    size_t numOrphans;
+    const double reallocate = run(UploadMode::Reallocate, points, numOrphans);
+    const double orphanSubData = run(UploadMode::OrphanSubData, points, numOrphans);
+    const double streaming = run(UploadMode::Streaming, points, numOrphans);
+    printf("%-10zu %12.2f %14.2f %12.2f %14zu\n", numPoints, reallocate, orphanSubData, streaming, numOrphans);
+  }
+
+  glDeleteProgram(program);
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include <cstring>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/io/openni_grabber.h>
@@ -15,10 +16,13 @@ void cloud_cb (const pcl::PointCloud<PointT>::ConstPtr& cloud)
   // only send data if the visualizer has started
   if (visualizer && visualizer->IsRunning())
   {
-    const PointT* data = &cloud->points[0];
-    pointCloud.pointData = reinterpret_cast<const void*>(data);
-    pointCloud.numPoints = cloud->size();
-    visualizer->Update(cloud_handle, pointCloud); // give the visualizer the new points
+    // write the points straight into one of the visualizer's buffers, so they are not copied again
+    void* buffer = visualizer->AcquirePointCloudBuffer(cloud_handle, cloud->size(), ar::PCL_PointXYZ);
+    if (buffer == nullptr)
+      return; // renderer is still busy with the previous frames, skip this one
+
+    std::memcpy(buffer, &cloud->points[0], cloud->size() * sizeof(PointT));
+    visualizer->PublishPointCloudBuffer(cloud_handle); // give the visualizer the new points
   }
 }
 
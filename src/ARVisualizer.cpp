@@ -4,12 +4,80 @@
 #include "windowmanager/WindowManager.hpp"
 #include "ui/ui_internal.hpp"
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 namespace ar
 {
 
+// Shapes which are drawn as instances of a unit mesh, see <PrimitiveRenderer>
+// Center and orientation go into the shape transform, like they went into the vertices of the meshes these shapes
+// used to be, so the object transform starts out as identity and absolute transform updates don't move the shape.
+static Primitive MakePrimitive(const Sphere& sphere)
+{
+  Primitive primitive;
+  primitive.shape = PrimitiveShape::Sphere;
+  primitive.shapeTransform = glm::translate(glm::mat4(1.0f), glm::make_vec3(sphere.center)) *
+                             glm::scale(glm::mat4(1.0f), glm::vec3(sphere.radius));
+  primitive.color = sphere.color;
+  return primitive;
+}
+
+static Primitive MakePrimitive(const Box& box)
+{
+  Primitive primitive;
+  primitive.shape = PrimitiveShape::Box;
+  primitive.shapeTransform = glm::translate(glm::mat4(1.0f), glm::make_vec3(box.center)) *
+                             glm::scale(glm::mat4(1.0f), glm::vec3(box.sizeX, box.sizeY, box.sizeZ));
+  primitive.color = box.color;
+  return primitive;
+}
+
+static Primitive MakePrimitive(const Cube& cube)
+{
+  Primitive primitive;
+  primitive.shape = PrimitiveShape::Box;
+  primitive.shapeTransform = glm::translate(glm::mat4(1.0f), glm::make_vec3(cube.center)) *
+                             glm::scale(glm::mat4(1.0f), glm::vec3(cube.size));
+  primitive.color = cube.color;
+  return primitive;
+}
+
+static Primitive MakePrimitive(const Capsule& capsule)
+{
+  const glm::vec3 center1 = glm::make_vec3(capsule.center1);
+  const glm::vec3 center2 = glm::make_vec3(capsule.center2);
+  const float distance = glm::length(center2 - center1);
+  const glm::vec3 axis = distance > 0.0f ? (center2 - center1) / distance : glm::vec3(1, 0, 0);
+
+  Primitive primitive;
+  primitive.shape = PrimitiveShape::Capsule;
+  primitive.shapeTransform = MeshFactory::MakeTransform(0.5f * (center1 + center2), glm::vec3(1, 0, 0), axis) *
+                             glm::scale(glm::mat4(1.0f), glm::vec3(0.5f * distance, capsule.radius, capsule.radius));
+  primitive.color = capsule.color;
+  return primitive;
+}
+
+static Primitive MakePrimitive(const Ellipsoid& ellipsoid)
+{
+  const float* t = ellipsoid.transform;
+
+  float transform[16]
+  {
+    t[6],                t[7],                t[8],                0,
+    t[3],                t[4],                t[5],                0,
+    t[0],                t[1],                t[2],                0,
+    ellipsoid.center[0], ellipsoid.center[1], ellipsoid.center[2], 1,
+  };
+
+  Primitive primitive;
+  primitive.shape = PrimitiveShape::Sphere;
+  primitive.shapeTransform = glm::make_mat4(transform) * glm::scale(glm::mat4(1.0f), glm::vec3(ellipsoid.radius));
+  primitive.color = ellipsoid.color;
+  return primitive;
+}
+
 ARVisualizer::ARVisualizer()
-  : _requestedClose(false), _ui(new UserInterface)
+  : _requestedClose(false), _ui(new UserInterface), _pointBudget(PointCloudRenderer::DefaultLodPointBudget)
 {
   _renderer = nullptr;
 }
@@ -44,6 +112,9 @@ void ARVisualizer::Start(const char* name, int width, int height)
   if (!_renderer)
   {
     _renderer = WindowManager::Instance().NewRenderer(width, height, name);
+    _renderer->SetQueueBudget(_queueBudget);
+    _renderer->SetPointCloudLodBudget(_pointBudget);
+    _renderer->SetPrimitiveLodThresholds(_lodThresholds);
     _renderer->_renderGUIDelegate += [this]()
     {
       this->renderExternGUI();
@@ -79,16 +150,22 @@ bool ARVisualizer::IsRunning() const
   return _renderer != nullptr;
 }
 
-void ARVisualizer::NotifyNewVideoFrame(int width, int height, const unsigned char* pixels)
+bool ARVisualizer::NotifyNewVideoFrame(int width, int height, const unsigned char* pixels)
 {
-  if (!IsRunning()) { return; }
-  _renderer->NotifyNewVideoFrame(width, height, pixels);
+  if (!IsRunning()) { return false; }
+  return _renderer->NotifyNewVideoFrame(width, height, pixels);
 }
 
-void ARVisualizer::NotifyNewVideoFrame(int width, int height, const unsigned char* pixels, float largefactor)
+bool ARVisualizer::NotifyNewVideoFrame(int width, int height, const unsigned char* pixels, float largefactor)
 {
-  if (!IsRunning()) { return; }
-  _renderer->NotifyNewVideoFrame(width, height, pixels, largefactor);
+  if (!IsRunning()) { return false; }
+  return _renderer->NotifyNewVideoFrame(width, height, pixels, largefactor);
+}
+
+bool ARVisualizer::NotifyNewDepthFrame(int width, int height, const uint16_t* depth, const double camera_matrix[3][3], const unsigned char* rgb, float depthScale)
+{
+  if (!IsRunning()) { return false; }
+  return _renderer->NotifyNewDepthFrame(width, height, depth, camera_matrix, rgb, depthScale);
 }
 
 void ARVisualizer::SetCameraPose(double position[3], double forward[3], double up[3])
@@ -156,6 +233,7 @@ mesh_handle ARVisualizer::Add(Polygon polygon)
 {
   if (!IsRunning()) { return 0; }
   Vector<glm::vec3> points;
+  points.reserve(polygon.numPoints);
   for(size_t i = 0; i < polygon.numPoints * 3; i += 3)
   {
     points.push_back({ polygon.points[i], polygon.points[i+1], polygon.points[i+2] });
@@ -167,264 +245,195 @@ mesh_handle ARVisualizer::Add(Polygon polygon)
 mesh_handle ARVisualizer::Add(PolyMesh mesh)
 {
   if (!IsRunning()) { return 0; }
-  Vector<glm::vec3> vertices;
-  Vector<glm::vec3> normals;
-  Vector<GLuint> indices;
-
-  // get vertices & normals (if any)
-  for (size_t i = 0; i < mesh.numPoints * 3; i += 3)
-  {
-    vertices.push_back({ mesh.points[i], mesh.points[i+1], mesh.points[i+2] });
-
-    if (mesh.normals != NULL)
-    {
-      normals.push_back({ mesh.normals[i], mesh.normals[i+1], mesh.normals[i+2] });
-    }
-  }
-
-  // if indices were provided, collect them, otherwise assume all vertices are to be used in order
-  if (mesh.numIndices > 0)
-  {
-    for (size_t i = 0; i < mesh.numIndices; i++)
-    {
-      indices.push_back(mesh.indices[i]);
-    }
-  }
-  else
-  {
-    for (size_t i = 0; i < mesh.numPoints; i++)
-    {
-      indices.push_back(i);
-    }
-  }
 
-  return _renderer->Add3DMesh(MeshFactory::MakeTriangleMesh<Mesh<Vertex3D>>(vertices, indices, normals), std::make_shared<FlatColorMaterial>(mesh.color));
+  // the mesh is built straight from the caller's arrays, see <MeshFactory::MakeTriangleMesh>
+  return _renderer->Add3DMesh(MeshFactory::MakeTriangleMesh<Mesh<Vertex3D>>(mesh.points, mesh.numPoints, mesh.indices, mesh.numIndices, mesh.normals),
+                              std::make_shared<FlatColorMaterial>(mesh.color));
 }
 
 mesh_handle ARVisualizer::Add(Box box)
 {
   if (!IsRunning()) { return 0; }
-  glm::vec3 vCenter = glm::vec3( box.center[0], box.center[1], box.center[2] );
-
-  return _renderer->Add3DMesh(MeshFactory::MakeBox<Mesh<Vertex3D>>(vCenter, box.sizeX, box.sizeY, box.sizeZ), std::make_shared<FlatColorMaterial>(box.color));
+  return _renderer->AddPrimitive(MakePrimitive(box));
 }
 
 mesh_handle ARVisualizer::Add(Cube cube)
 {
   if (!IsRunning()) { return 0; }
-  glm::vec3 vCenter = glm::vec3( cube.center[0], cube.center[1], cube.center[2] );
-
-  return _renderer->Add3DMesh(MeshFactory::MakeCube<Mesh<Vertex3D>>(vCenter, cube.size), std::make_shared<FlatColorMaterial>(cube.color));
+  return _renderer->AddPrimitive(MakePrimitive(cube));
 }
 
 mesh_handle ARVisualizer::Add(Sphere sphere)
 {
   if (!IsRunning()) { return 0; }
-  glm::vec3 vCenter = glm::vec3( sphere.center[0], sphere.center[1], sphere.center[2] );
-
-  return _renderer->Add3DMesh(MeshFactory::MakeUVSphere<Mesh<Vertex3D>>(vCenter, sphere.radius, UVSPHERE_RESOLUTION), std::make_shared<FlatColorMaterial>(sphere.color));
+  return _renderer->AddPrimitive(MakePrimitive(sphere));
 }
 
 mesh_handle ARVisualizer::Add(Capsule capsule)
 {
   if (!IsRunning()) { return 0; }
-  glm::vec3 vCenter1 = glm::vec3( capsule.center1[0], capsule.center1[1], capsule.center1[2] );
-  glm::vec3 vCenter2 = glm::vec3( capsule.center2[0], capsule.center2[1], capsule.center2[2] );
-
-  return _renderer->Add3DMesh(MeshFactory::MakeCapsule<Mesh<Vertex3D>>(vCenter1, vCenter2, capsule.radius, UVSPHERE_RESOLUTION), std::make_shared<FlatColorMaterial>(capsule.color));
+  return _renderer->AddPrimitive(MakePrimitive(capsule));
 }
 
 mesh_handle ARVisualizer::Add(Ellipsoid ellipsoid)
 {
   if (!IsRunning()) { return 0; }
-  glm::vec3 vCenter = glm::vec3( ellipsoid.center[0], ellipsoid.center[1], ellipsoid.center[2] );
-
-  Mesh<Vertex3D> mesh = MeshFactory::MakeUVSphere<Mesh<Vertex3D>>(vCenter, ellipsoid.radius, UVSPHERE_RESOLUTION);
-
-  float* t = ellipsoid.transform;
-
-  float transform[16]
-  {
-    t[6],                t[7],                t[8],                0,
-    t[3],                t[4],                t[5],                0,
-    t[0],                t[1],                t[2],                0,
-    ellipsoid.center[0], ellipsoid.center[1], ellipsoid.center[2], 1,
-  };
-
-  mesh.SetTransform(glm::make_mat4(transform));
-  return _renderer->Add3DMesh(mesh, std::make_shared<FlatColorMaterial>(ellipsoid.color));
+  return _renderer->AddPrimitive(MakePrimitive(ellipsoid));
 }
 
 mesh_handle ARVisualizer::Add(LinePath linePath)
 {
   if (!IsRunning()) { return 0; }
   Vector<glm::vec3> points;
+  points.reserve(linePath.points.size() / 3);
 
   for (size_t i = 0; i < linePath.points.size(); i += 3)
     points.push_back(glm::make_vec3(&linePath.points[i]));
 
   LineMesh mesh = MeshFactory::MakeLineMesh(points);
   mesh.SetThickness(linePath.thickness);
-  return _renderer->AddLineMesh(mesh, std::make_shared<FlatColorMaterial>(linePath.color));
+  return _renderer->AddLineMesh(std::move(mesh), std::make_shared<FlatColorMaterial>(linePath.color));
 }
 
 
-mesh_handle ARVisualizer::Add(PointCloudData pointcloud)
+mesh_handle ARVisualizer::Add(PointCloudData pointcloud, const PointCloudOptions& options)
 {
   if (!IsRunning()) { return 0; }
 
   const bool colored = pointcloud.type == PCL_PointXYZRGBA;
-  return _renderer->AddPointCloud(pointcloud.pointData, pointcloud.numPoints, colored, pointcloud.color);
+  if (options.capacity > 0)
+  {
+    const mesh_handle handle = _renderer->AddRollingPointCloud(colored, pointcloud.color, options);
+    if (pointcloud.numPoints > 0)
+      _renderer->AppendPoints(handle, pointcloud.pointData, pointcloud.numPoints);
+    return handle;
+  }
+
+  if (pointcloud.sharedPointData != nullptr)
+    return _renderer->AddPointCloud(pointcloud.sharedPointData, pointcloud.numPoints, colored, pointcloud.color, options);
+
+  return _renderer->AddPointCloud(pointcloud.pointData, pointcloud.numPoints, colored, pointcloud.color, options);
 }
 
-void ARVisualizer::Update(mesh_handle handle, Triangle t)
+bool ARVisualizer::Update(mesh_handle handle, Triangle t)
 {
-  if (!IsRunning()) { return; }
+  if (!IsRunning()) { return false; }
   Vector<glm::vec3> positions = {
     { t.p1[0], t.p1[1], t.p1[2] },
     { t.p2[0], t.p2[1], t.p2[2] },
     { t.p3[0], t.p3[1], t.p3[2] }
   };
 
-  _renderer->UpdateMesh(handle, MeshFactory::MakeTriangle<Mesh<Vertex3D>>(positions), std::make_shared<FlatColorMaterial>(t.color));
+  return _renderer->UpdateMesh(handle, MeshFactory::MakeTriangle<Mesh<Vertex3D>>(positions), std::make_shared<FlatColorMaterial>(t.color));
 }
 
-void ARVisualizer::Update(mesh_handle handle, Quad quad)
+bool ARVisualizer::Update(mesh_handle handle, Quad quad)
 {
-  if (!IsRunning()) { return; }
+  if (!IsRunning()) { return false; }
   glm::vec3 vCenter = glm::vec3( quad.center[0], quad.center[1], quad.center[2] );
   glm::vec3 vNormal = glm::vec3( quad.normal[0], quad.normal[1], quad.normal[2] );
 
-  _renderer->UpdateMesh(handle, MeshFactory::MakeQuad<Mesh<Vertex3D>>(vCenter, vNormal, quad.width, quad.height), std::make_shared<FlatColorMaterial>(quad.color));
+  return _renderer->UpdateMesh(handle, MeshFactory::MakeQuad<Mesh<Vertex3D>>(vCenter, vNormal, quad.width, quad.height), std::make_shared<FlatColorMaterial>(quad.color));
 }
 
-void ARVisualizer::Update(mesh_handle handle, Polygon polygon)
+bool ARVisualizer::Update(mesh_handle handle, Polygon polygon)
 {
-  if (!IsRunning()) { return; }
+  if (!IsRunning()) { return false; }
   Vector<glm::vec3> points;
+  points.reserve(polygon.numPoints);
   for(size_t i = 0; i < polygon.numPoints * 3; i += 3)
   {
     points.push_back({ polygon.points[i], polygon.points[i+1], polygon.points[i+2] });
   }
 
-  _renderer->UpdateMesh(handle, MeshFactory::MakeTriangleFan<Mesh<Vertex3D>>(points, true), std::make_shared<FlatColorMaterial>(polygon.color));
+  return _renderer->UpdateMesh(handle, MeshFactory::MakeTriangleFan<Mesh<Vertex3D>>(points, true), std::make_shared<FlatColorMaterial>(polygon.color));
 }
 
-void ARVisualizer::Update(mesh_handle handle, PolyMesh mesh)
+bool ARVisualizer::Update(mesh_handle handle, PolyMesh mesh)
 {
-  if (!IsRunning()) { return; }
-  Vector<glm::vec3> vertices;
-  Vector<glm::vec3> normals;
-  Vector<GLuint> indices;
-
-  // get vertices
-  for (size_t i = 0; i < mesh.numPoints * 3; i += 3)
-  {
-    vertices.push_back({ mesh.points[i], mesh.points[i+1], mesh.points[i+2] });
-
-    if (mesh.normals != NULL)
-    {
-      normals.push_back({ mesh.normals[i], mesh.normals[i+1], mesh.normals[i+2] });
-    }
-  }
-
-  // if indices were provided, collect them, otherwise assume all vertices are to be used in order
-  if (mesh.numIndices > 0)
-  {
-    for (size_t i = 0; i < mesh.numIndices; i++)
-    {
-      indices.push_back(mesh.indices[i]);
-    }
-  }
-  else
-  {
-    for (size_t i = 0; i < mesh.numPoints; i++)
-    {
-      indices.push_back(i);
-    }
-  }
+  if (!IsRunning()) { return false; }
 
-  _renderer->UpdateMesh(handle, MeshFactory::MakeTriangleMesh<Mesh<Vertex3D>>(vertices, indices, normals), std::make_shared<FlatColorMaterial>(mesh.color));
+  // the mesh is built straight from the caller's arrays, see <MeshFactory::MakeTriangleMesh>
+  return _renderer->UpdateMesh(handle, MeshFactory::MakeTriangleMesh<Mesh<Vertex3D>>(mesh.points, mesh.numPoints, mesh.indices, mesh.numIndices, mesh.normals),
+                               std::make_shared<FlatColorMaterial>(mesh.color));
 }
 
-void ARVisualizer::Update(mesh_handle handle, Box box)
+bool ARVisualizer::Update(mesh_handle handle, Box box)
 {
-  if (!IsRunning()) { return; }
-  glm::vec3 vCenter = glm::vec3( box.center[0], box.center[1], box.center[2] );
-
-  _renderer->UpdateMesh(handle, MeshFactory::MakeBox<Mesh<Vertex3D>>(vCenter, box.sizeX, box.sizeY, box.sizeZ), std::make_shared<FlatColorMaterial>(box.color));
+  if (!IsRunning()) { return false; }
+  return _renderer->UpdatePrimitive(handle, MakePrimitive(box));
 }
 
-void ARVisualizer::Update(mesh_handle handle, Cube cube)
+bool ARVisualizer::Update(mesh_handle handle, Cube cube)
 {
-  if (!IsRunning()) { return; }
-  glm::vec3 vCenter = glm::vec3( cube.center[0], cube.center[1], cube.center[2] );
-
-  _renderer->UpdateMesh(handle, MeshFactory::MakeCube<Mesh<Vertex3D>>(vCenter, cube.size), std::make_shared<FlatColorMaterial>(cube.color));
+  if (!IsRunning()) { return false; }
+  return _renderer->UpdatePrimitive(handle, MakePrimitive(cube));
 }
 
-void ARVisualizer::Update(mesh_handle handle, Sphere sphere)
+bool ARVisualizer::Update(mesh_handle handle, Sphere sphere)
 {
-  if (!IsRunning()) { return; }
-  glm::vec3 vCenter = glm::vec3( sphere.center[0], sphere.center[1], sphere.center[2] );
-
-  _renderer->UpdateMesh(handle, MeshFactory::MakeUVSphere<Mesh<Vertex3D>>(vCenter, sphere.radius, UVSPHERE_RESOLUTION), std::make_shared<FlatColorMaterial>(sphere.color));
+  if (!IsRunning()) { return false; }
+  return _renderer->UpdatePrimitive(handle, MakePrimitive(sphere));
 }
 
-void ARVisualizer::Update(mesh_handle handle, Capsule capsule)
+bool ARVisualizer::Update(mesh_handle handle, Capsule capsule)
 {
-  if (!IsRunning()) { return; }
-  glm::vec3 vCenter1 = glm::vec3( capsule.center1[0], capsule.center1[1], capsule.center1[2] );
-  glm::vec3 vCenter2 = glm::vec3( capsule.center2[0], capsule.center2[1], capsule.center2[2] );
-
-  _renderer->UpdateMesh(handle, MeshFactory::MakeCapsule<Mesh<Vertex3D>>(vCenter1, vCenter2, capsule.radius, UVSPHERE_RESOLUTION), std::make_shared<FlatColorMaterial>(capsule.color));
+  if (!IsRunning()) { return false; }
+  return _renderer->UpdatePrimitive(handle, MakePrimitive(capsule));
 }
 
-void ARVisualizer::Update(mesh_handle handle, Ellipsoid ellipsoid)
+bool ARVisualizer::Update(mesh_handle handle, Ellipsoid ellipsoid)
 {
-  if (!IsRunning()) { return; }
-  glm::vec3 vCenter = glm::vec3( ellipsoid.center[0], ellipsoid.center[1], ellipsoid.center[2] );
-
-  Mesh<Vertex3D> mesh = MeshFactory::MakeUVSphere<Mesh<Vertex3D>>(vCenter, ellipsoid.radius, UVSPHERE_RESOLUTION);
-
-  float* t = ellipsoid.transform;
-
-  float transform[16]
-  {
-    t[6],                t[7],                t[8],                0,
-    t[3],                t[4],                t[5],                0,
-    t[0],                t[1],                t[2],                0,
-    ellipsoid.center[0], ellipsoid.center[1], ellipsoid.center[2], 1,
-  };
-
-  mesh.SetTransform(glm::make_mat4(transform));
-  _renderer->UpdateMesh(handle, mesh, std::make_shared<FlatColorMaterial>(ellipsoid.color));
+  if (!IsRunning()) { return false; }
+  return _renderer->UpdatePrimitive(handle, MakePrimitive(ellipsoid));
 }
 
-void ARVisualizer::Update(mesh_handle handle, LinePath linePath)
+bool ARVisualizer::Update(mesh_handle handle, LinePath linePath)
 {
-  if (!IsRunning()) { return; }
+  if (!IsRunning()) { return false; }
   Vector<glm::vec3> points;
+  points.reserve(linePath.points.size() / 3);
 
   for (size_t i = 0; i < linePath.points.size(); i += 3)
     points.push_back(glm::make_vec3(&linePath.points[i]));
 
   LineMesh mesh = MeshFactory::MakeLineMesh(points);
   mesh.SetThickness(linePath.thickness);
-  return _renderer->UpdateLineMesh(handle, mesh, std::make_shared<FlatColorMaterial>(linePath.color));
+  return _renderer->UpdateLineMesh(handle, std::move(mesh), std::make_shared<FlatColorMaterial>(linePath.color));
 }
 
-void ARVisualizer::Update(mesh_handle handle, PointCloudData pointcloud)
+bool ARVisualizer::Update(mesh_handle handle, PointCloudData pointcloud)
 {
-  if (!IsRunning()) { return; }
+  if (!IsRunning()) { return false; }
 
   const bool colored = pointcloud.type == PCL_PointXYZRGBA;
-  _renderer->UpdatePointCloud(handle, pointcloud.pointData, pointcloud.numPoints, colored, pointcloud.color);
+  if (pointcloud.sharedPointData != nullptr)
+    return _renderer->UpdatePointCloud(handle, pointcloud.sharedPointData, pointcloud.numPoints, colored, pointcloud.color);
+
+  return _renderer->UpdatePointCloud(handle, pointcloud.pointData, pointcloud.numPoints, colored, pointcloud.color);
 }
 
-void ARVisualizer::Update(mesh_handle handle, ar::Transform transform, bool absolute)
+bool ARVisualizer::AppendPoints(mesh_handle handle, const void* pointData, unsigned long numPoints)
 {
-  if (!IsRunning()) { return; }
+  if (!IsRunning()) { return false; }
+  return _renderer->AppendPoints(handle, pointData, numPoints);
+}
+
+void* ARVisualizer::AcquirePointCloudBuffer(mesh_handle handle, unsigned long numPoints, PointCloudDataType type)
+{
+  if (!IsRunning()) { return nullptr; }
+  return _renderer->AcquirePointCloudBuffer(handle, numPoints, type == PCL_PointXYZRGBA);
+}
+
+bool ARVisualizer::PublishPointCloudBuffer(mesh_handle handle, Color color)
+{
+  if (!IsRunning()) { return false; }
+  return _renderer->PublishPointCloudBuffer(handle, color);
+}
+
+bool ARVisualizer::Update(mesh_handle handle, ar::Transform transform, bool absolute)
+{
+  if (!IsRunning()) { return false; }
   glm::mat4 transformMat = glm::mat4(
     transform.rotation[0][0], transform.rotation[1][0], transform.rotation[2][0], 0,
     transform.rotation[0][1], transform.rotation[1][1], transform.rotation[2][1], 0,
@@ -432,13 +441,13 @@ void ARVisualizer::Update(mesh_handle handle, ar::Transform transform, bool abso
     transform.translation[0], transform.translation[1], transform.translation[2], 1
   );
 
-  _renderer->UpdateTransform(handle, transformMat, absolute);
+  return _renderer->UpdateTransform(handle, transformMat, absolute);
 }
 
-void ARVisualizer::SetVisibility(mesh_handle handle, bool visible)
+bool ARVisualizer::SetVisibility(mesh_handle handle, bool visible)
 {
-  if (!IsRunning()) { return; }
-  _renderer->SetVisibility(handle, visible);
+  if (!IsRunning()) { return false; }
+  return _renderer->SetVisibility(handle, visible);
 }
 
 void ARVisualizer::Remove(mesh_handle handle)
@@ -459,10 +468,70 @@ void ARVisualizer::RemoveAllVoxels()
   _renderer->RemoveAllVoxels();
 }
 
-void ARVisualizer::DrawVoxels(const Voxel* voxels, unsigned long numVoxels)
+bool ARVisualizer::DrawVoxels(const Voxel* voxels, unsigned long numVoxels)
+{
+  if (!IsRunning()) { return false; }
+  return _renderer->DrawVoxels(voxels, numVoxels);
+}
+
+void ARVisualizer::BeginBatch()
+{
+  if (!IsRunning()) { return; }
+  _renderer->BeginBatch();
+}
+
+void ARVisualizer::CommitBatch()
 {
   if (!IsRunning()) { return; }
-  _renderer->DrawVoxels(voxels, numVoxels);
+  _renderer->CommitBatch();
+}
+
+void ARVisualizer::SetQueueBudget(const QueueBudget& budget)
+{
+  _queueBudget = budget;
+  if (!IsRunning()) { return; }
+  _renderer->SetQueueBudget(budget);
+}
+
+QueueBudget ARVisualizer::GetQueueBudget() const
+{
+  return _queueBudget;
+}
+
+void ARVisualizer::SetPointBudget(unsigned long numPoints)
+{
+  _pointBudget = numPoints;
+  if (!IsRunning()) { return; }
+  _renderer->SetPointCloudLodBudget(numPoints);
+}
+
+unsigned long ARVisualizer::GetPointBudget() const
+{
+  return _pointBudget;
+}
+
+void ARVisualizer::SetLodThresholds(const LodThresholds& thresholds)
+{
+  _lodThresholds = thresholds;
+  if (!IsRunning()) { return; }
+  _renderer->SetPrimitiveLodThresholds(thresholds);
+}
+
+LodThresholds ARVisualizer::GetLodThresholds() const
+{
+  return _lodThresholds;
+}
+
+size_t ARVisualizer::NumQueuedCommands() const
+{
+  if (!IsRunning()) { return 0; }
+  return _renderer->NumQueuedCommands();
+}
+
+size_t ARVisualizer::NumQueuedBytes() const
+{
+  if (!IsRunning()) { return 0; }
+  return _renderer->NumQueuedBytes();
 }
 
 IUIWindow* ARVisualizer::AddUIWindow(const char* name)
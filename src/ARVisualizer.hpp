@@ -16,20 +16,15 @@
 #include "geometry/Voxel.hpp"
 #include "geometry/Line.hpp"
 #include "Delegate.hpp"
+#include "QueueBudget.hpp"
+#include "LodThresholds.hpp"
 #include <atomic>
+#include <cstdint>
 #include <condition_variable>
 
 namespace ar
 {
 
-// Number of times to subdivide icosphere meshes (larger == smoother spheres)
-// This should be a non-negative number between 0 and 5. Smaller is faster.
-#define ICOSPHERE_SUBDIV_LEVELS 2
-
-// Number of vertices around major axis to generate on UV sphere-based meshes.
-// This should be a non-negative even number. Smaller is faster, larger is smoother.
-#define UVSPHERE_RESOLUTION 16
-
 class Renderer;
 class UserInterface;
 
@@ -75,14 +70,31 @@ public:
   // @width  width, in pixels, of the image
   // @height height, in pixles, of the image
   // @pixels image data
-  void NotifyNewVideoFrame(int width, int height, const unsigned char* pixels);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool NotifyNewVideoFrame(int width, int height, const unsigned char* pixels);
 
   // Updates video texture with (RGB24) data in pixels, but starts a larger screen    // TODO: determine if any other pixel formats need to be supported
   // @width  width, in pixels, of the image
   // @height height, in pixles, of the image
   // @pixels image data
   // @largefactor how much bigger should the width be
-  void NotifyNewVideoFrame(int width, int height, const unsigned char* pixels, float largefactor);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool NotifyNewVideoFrame(int width, int height, const unsigned char* pixels, float largefactor);
+
+  // Draws a depth image as a point cloud, replacing the previous depth frame.
+  // The image is unprojected on the GPU, which is much cheaper than converting it to a <PointCloudData> first.
+  // The points are in the camera frame of the depth sensor (x right, y down, z forward).
+  // @width         Width, in pixels, of the image
+  // @height        Height, in pixels, of the image
+  // @depth         Depth values, 0 where there is no measurement
+  // @camera_matrix Intrinsic parameters of the depth sensor, see <SetCameraIntrinsics>
+  // @rgb           Color image registered to the depth image, ordered [r,g,b,r,g,b,...]. Optional.
+  // @depthScale    Meters per depth unit, millimeters by default
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool NotifyNewDepthFrame(int width, int height, const uint16_t* depth, const double camera_matrix[3][3], const unsigned char* rgb = nullptr, float depthScale = 0.001f);
 
   // Updates the camera parameters used for rendering.
   // @position Position of the camera in world-coordinates
@@ -161,76 +173,136 @@ public:
 
   // Adds a PointCloud to the scene
   // @pointcloud Struct describing the PointCloud
+  // @options    How the cloud is stored and drawn, see <PointCloudOptions>
   //
   // @return Handle which can be used to update or remove the object in the future
-  mesh_handle Add(PointCloudData pointcloud);
+  mesh_handle Add(PointCloudData pointcloud, const PointCloudOptions& options = PointCloudOptions());
 
   // Updates an existing object to match the given shape
   // @handle <mesh_handle> for the object to be updated
   // @triangle <Triangle> to replace the object with
-  void Update(mesh_handle handle, Triangle triangle);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Triangle triangle);
 
   // Updates an existing object to match the given shape
   // @handle <mesh_handle> for the object to be updated
   // @quad <Quad> to replace the object with
-  void Update(mesh_handle handle, Quad quad);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Quad quad);
 
   // Updates an existing object to match the given shape
   // @handle <mesh_handle> for the object to be updated
   // @polygon <Polygon> to replace the object with
-  void Update(mesh_handle handle, Polygon polygon);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Polygon polygon);
 
   // Updates an existing object to match the given shape
   // @handle <mesh_handle> for the object to be updated
   // @mesh <PolyMesh> to replace the object with
-  void Update(mesh_handle handle, PolyMesh mesh);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, PolyMesh mesh);
 
   // Updates an existing object to match the given shape
+  // Only boxes, cubes, spheres, capsules and ellipsoids can be replaced with this shape.
   // @handle <mesh_handle> for the object to be updated
   // @box <Box> to replace the object with
-  void Update(mesh_handle handle, Box box);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Box box);
 
   // Updates an existing object to match the given shape
+  // Only boxes, cubes, spheres, capsules and ellipsoids can be replaced with this shape.
   // @handle <mesh_handle> for the object to be updated
   // @cube <Cube> to replace the object with
-  void Update(mesh_handle handle, Cube cube);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Cube cube);
 
   // Updates an existing object to match the given shape
+  // Only boxes, cubes, spheres, capsules and ellipsoids can be replaced with this shape.
   // @handle <mesh_handle> for the object to be updated
   // @sphere <Sphere> to replace the object with
-  void Update(mesh_handle handle, Sphere sphere);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Sphere sphere);
 
   // Updates an existing object to match the given shape
+  // Only boxes, cubes, spheres, capsules and ellipsoids can be replaced with this shape.
   // @handle <mesh_handle> for the object to be updated
   // @capsule <Capsule> to replace the object with
-  void Update(mesh_handle handle, Capsule capsule);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Capsule capsule);
 
   // Updates an existing object to match the given shape
+  // Only boxes, cubes, spheres, capsules and ellipsoids can be replaced with this shape.
   // @handle <mesh_handle> for the object to be updated
   // @ellipsoid <Ellipsoid> to replace the object with
-  void Update(mesh_handle handle, Ellipsoid ellipsoid);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, Ellipsoid ellipsoid);
 
   // Updates an existing object to match the given shape
   // @handle <mesh_handle> for the object to be updated
   // @linePath <LinePath> to replace the object with
-  void Update(mesh_handle handle, LinePath linePath);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, LinePath linePath);
 
   // Updates an existing object to match the given shape
   // @handle <mesh_handle> for the object to be updated
   // @pointcloud PointCloud to replace the object with
-  void Update(mesh_handle handle, PointCloudData pointcloud);
+  //
+  // @return False if <handle> is a rolling point cloud (see <PointCloudOptions::capacity>), whose points can only be
+  //         added with <AppendPoints>, or if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, PointCloudData pointcloud);
+
+  // Adds points to a rolling point cloud (see <PointCloudOptions::capacity>) without touching the points it already has.
+  // Once the cloud holds as many points as its capacity, the oldest points are replaced.
+  // @handle    <mesh_handle> for the rolling point cloud
+  // @pointData The new points, in the format the cloud was added with
+  // @numPoints Number of points in <pointData>
+  //
+  // @return False if <handle> is not a rolling point cloud, or if the update was rejected (see <QueuePolicy::Reject>)
+  bool AppendPoints(mesh_handle handle, const void* pointData, unsigned long numPoints);
+
+  // Gets a buffer to write the next points of a point cloud into, which saves copying them in <Update>.
+  // Fill the buffer with <numPoints> points of the given type, then call <PublishPointCloudBuffer>.
+  // Every point cloud has a small number of buffers which are reused once the renderer uploaded them.
+  // @handle    <mesh_handle> for the point cloud to be updated
+  // @numPoints Number of points which will be written to the buffer
+  // @type      Point format, see <PointCloudData>
+  //
+  // @return nullptr if all buffers of the point cloud are still waiting to be rendered
+  void* AcquirePointCloudBuffer(mesh_handle handle, unsigned long numPoints, PointCloudDataType type);
+
+  // Replaces the points of a point cloud with the buffer returned by the last <AcquirePointCloudBuffer> call.
+  // The buffer must not be written to anymore.
+  // @handle <mesh_handle> for the point cloud to be updated
+  // @color  Constant color for the cloud
+  //
+  // @return False if no buffer was acquired, or if the update was rejected (see <QueuePolicy::Reject>)
+  bool PublishPointCloudBuffer(mesh_handle handle, Color color = Color());
 
   // Updates an existing object's position and/or orientation
   // @handle    <mesh_handle> for the object to be updated
   // @transform <Transform> to apply to the object
   // @absolute  If true, object will be transformed to match the given values.
   //            If false, the transform will be added to the object's current transform.
-  void Update(mesh_handle handle, ar::Transform transform, bool absolute);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool Update(mesh_handle handle, ar::Transform transform, bool absolute);
 
   // Set an objects visibility
   // @handle <mesh_handle> for the object
   // @visible True if the object should be visible
-  void SetVisibility(mesh_handle handle, bool visible);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool SetVisibility(mesh_handle handle, bool visible);
 
   // Removes an object from the scene
   // @handle <mesh_handle> for the object to be removed
@@ -240,7 +312,53 @@ public:
   void RemoveAllMeshes();
   void RemoveAllVoxels();
 
-  void DrawVoxels(const Voxel* voxels, unsigned long numVoxels);
+  // Replaces all voxels in the scene
+  // @voxels    Array of <Voxel>s to draw
+  // @numVoxels Number of elements in <voxels>
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool DrawVoxels(const Voxel* voxels, unsigned long numVoxels);
+
+  // Starts a batch of changes on the calling thread.
+  // All following Add/Update/Remove calls from this thread are collected until <CommitBatch> is called,
+  // so the render thread never shows a scene in which only part of them were applied.
+  // Batches can be nested; only the outermost <CommitBatch> publishes the changes.
+  void BeginBatch();
+
+  // Sends all changes made since <BeginBatch> to the render thread at once.
+  // They are applied together, within a single frame.
+  void CommitBatch();
+
+  // Limits how many updates may wait for the render thread, and what happens to updates beyond that limit.
+  // Can be called at any time, the budget is kept across Stop() and Start().
+  // @budget The new <QueueBudget>
+  void SetQueueBudget(const QueueBudget& budget);
+
+  // @return The <QueueBudget> currently in use
+  QueueBudget GetQueueBudget() const;
+
+  // Limits how many points of LOD point clouds (see <PointCloudOptions::lod>) are drawn per frame, for all of them together.
+  // The parts of the clouds closest to the camera get the most detail.
+  // Can be called at any time, the budget is kept across Stop() and Start().
+  // @numPoints Maximum number of points
+  void SetPointBudget(unsigned long numPoints);
+
+  // @return The point budget currently in use
+  unsigned long GetPointBudget() const;
+
+  // Sets the screen sizes at which spheres, capsules and ellipsoids switch between their levels of detail.
+  // Can be called at any time, the thresholds are kept across Stop() and Start().
+  // @thresholds The new <LodThresholds>
+  void SetLodThresholds(const LodThresholds& thresholds);
+
+  // @return The <LodThresholds> currently in use
+  LodThresholds GetLodThresholds() const;
+
+  // @return Number of commands waiting for the render thread
+  size_t NumQueuedCommands() const;
+
+  // @return Size, in bytes, of the data held by commands waiting for the render thread
+  size_t NumQueuedBytes() const;
 
   // Adds a GUI window to the current window
   // @name Name of the GUI window
@@ -290,6 +408,10 @@ private:
   Renderer* _renderer;
   UserInterface* _ui;
 
+  QueueBudget _queueBudget;
+  unsigned long _pointBudget;
+  LodThresholds _lodThresholds;
+
   // Renders GUI elements provided by the host application
   void renderExternGUI();
 };
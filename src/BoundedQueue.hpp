@@ -0,0 +1,147 @@
+#ifndef _AR_BOUNDEDQUEUE_HPP
+#define _AR_BOUNDEDQUEUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace ar
+{
+
+/*
+ * A fixed-capacity, lock-free queue which can be used from any number of producer and consumer threads.
+ * Every slot carries a sequence number which tells producers and consumers whether the slot is free to be
+ * written or ready to be read, so neither side ever needs to take a lock (see Dmitry Vyukov's bounded MPMC queue).
+ * The capacity must be a power of two. TryEnqueue fails instead of growing the buffer once the queue is full.
+ */
+template <typename T>
+class BoundedQueue
+{
+private:
+
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  // padding keeps the producer and consumer positions on separate cache lines so they don't contend with each other
+  // (alignas would be cleaner, but over-aligned types aren't honored by operator new before C++17)
+  static constexpr size_t CacheLineSize = 64;
+
+  // @return <capacity>, after checking that it is a power of two, so no slots are allocated for an invalid capacity
+  static size_t validCapacity(size_t capacity)
+  {
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+      throw std::invalid_argument("BoundedQueue capacity must be a power of two");
+    return capacity;
+  }
+
+  std::unique_ptr<Cell[]> _buffer;
+  size_t _mask;
+
+  char _pad0[CacheLineSize];
+  std::atomic<size_t> _enqueuePos;
+  char _pad1[CacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> _dequeuePos;
+  char _pad2[CacheLineSize - sizeof(std::atomic<size_t>)];
+
+public:
+
+  explicit BoundedQueue(size_t capacity)
+    : _buffer(new Cell[validCapacity(capacity)]), _mask(capacity - 1)
+  {
+    for (size_t i = 0; i < capacity; i++)
+      _buffer[i].sequence.store(i, std::memory_order_relaxed);
+
+    _enqueuePos.store(0, std::memory_order_relaxed);
+    _dequeuePos.store(0, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  // Adds value to the end of the queue
+  // @return False if the queue is full, True otherwise
+  bool TryEnqueue(const T& value)
+  {
+    Cell* cell;
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &_buffer[pos & _mask];
+      const size_t seq = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+      if (diff == 0)
+      {
+        // the slot is free, try to claim it
+        if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        // the slot still holds an element which wasn't dequeued yet
+        return false;
+      }
+      else
+      {
+        // another producer claimed this slot first
+        pos = _enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Removes the first element of the queue and stores it in value
+  // @return False if the queue is empty, True otherwise
+  bool TryDequeue(T& value)
+  {
+    Cell* cell;
+    size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &_buffer[pos & _mask];
+      const size_t seq = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+      if (diff == 0)
+      {
+        if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        // nothing was written to this slot yet
+        return false;
+      }
+      else
+      {
+        pos = _dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    value = cell->data;
+    // mark the slot as free for the producer one lap ahead of us
+    cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Number of elements in the queue. Only a snapshot if other threads are using the queue concurrently.
+  size_t SizeApprox() const
+  {
+    const size_t enqueuePos = _enqueuePos.load(std::memory_order_relaxed);
+    const size_t dequeuePos = _dequeuePos.load(std::memory_order_relaxed);
+    return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+  }
+
+  size_t Capacity() const { return _mask + 1; }
+};
+
+} // namespace ar
+
+#endif // _AR_BOUNDEDQUEUE_HPP
@@ -0,0 +1,124 @@
+#ifndef _AR_COMMANDPOOL_HPP
+#define _AR_COMMANDPOOL_HPP
+
+#include <atomic>
+#include "BoundedQueue.hpp"
+#include "CommandQueue.hpp"
+
+namespace ar
+{
+
+template <typename CommandT>
+class RenderCommandPool;
+
+/*
+ * Base class for commands which are recycled through a <RenderCommandPool> instead of being deleted.
+ * Derived commands keep their payload containers around, so refilling them with data of a similar size
+ * doesn't allocate either.
+ */
+template <typename CommandT>
+class PooledRenderCommand : public RenderCommand
+{
+public:
+
+  explicit PooledRenderCommand(RenderCommandPool<CommandT>* pool)
+    : _pool(pool)
+  { }
+
+  virtual void release() override
+  {
+    _pool->Release(static_cast<CommandT*>(this));
+  }
+
+protected:
+
+  // Call before refilling a payload container
+  // Counts the allocation if <container> has to grow to hold <size> elements
+  template <typename ContainerT>
+  void reservePayload(ContainerT& container, size_t size)
+  {
+    if (container.capacity() < size)
+    {
+      _pool->_numPayloadAllocations.fetch_add(1, std::memory_order_relaxed);
+      container.reserve(size);
+    }
+  }
+
+private:
+
+  RenderCommandPool<CommandT>* _pool;
+};
+
+/*
+ * Thread-safe free list of commands of a single type.
+ * Any thread may acquire commands, they are returned by the render thread once they were executed.
+ * Commands are only allocated while the pool is empty, so in steady state the free list
+ * always has a command ready for the next update.
+ */
+template <typename CommandT>
+class RenderCommandPool
+{
+public:
+
+  // Maximum number of idle commands kept in the pool
+  static constexpr size_t DefaultCapacity = 256;
+
+  explicit RenderCommandPool(size_t capacity = DefaultCapacity)
+    : _freeList(capacity)
+  { }
+
+  ~RenderCommandPool()
+  {
+    CommandT* command;
+    while (_freeList.TryDequeue(command))
+      delete command;
+  }
+
+  RenderCommandPool(const RenderCommandPool&) = delete;
+  RenderCommandPool& operator=(const RenderCommandPool&) = delete;
+
+  // Takes an idle command from the pool, or allocates a new one if there is none
+  // The command is returned to the pool when the render thread calls release() on it
+  CommandT* Acquire()
+  {
+    CommandT* command;
+    if (_freeList.TryDequeue(command))
+    {
+      _numReused.fetch_add(1, std::memory_order_relaxed);
+      return command;
+    }
+
+    _numAllocated.fetch_add(1, std::memory_order_relaxed);
+    return new CommandT(this);
+  }
+
+  void Release(CommandT* command)
+  {
+    // the pool is bounded, so a burst of updates doesn't keep its payloads alive forever
+    if (!_freeList.TryEnqueue(command))
+      delete command;
+  }
+
+  // Number of commands which had to be allocated
+  size_t NumAllocated() const { return _numAllocated.load(std::memory_order_relaxed); }
+
+  // Number of commands which were served from the pool without allocating
+  size_t NumReused() const { return _numReused.load(std::memory_order_relaxed); }
+
+  // Number of times the payload of a command had to grow
+  size_t NumPayloadAllocations() const { return _numPayloadAllocations.load(std::memory_order_relaxed); }
+
+private:
+
+  friend class PooledRenderCommand<CommandT>;
+
+  BoundedQueue<CommandT*> _freeList;
+
+  std::atomic<size_t> _numAllocated {0};
+  std::atomic<size_t> _numReused {0};
+  std::atomic<size_t> _numPayloadAllocations {0};
+};
+
+} // namespace ar
+
+#endif // _AR_COMMANDPOOL_HPP
@@ -0,0 +1,480 @@
+#ifndef _AR_COMMANDQUEUE_HPP
+#define _AR_COMMANDQUEUE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "BoundedQueue.hpp"
+#include "QueueBudget.hpp"
+#include "common.hpp"
+
+namespace ar
+{
+
+class RenderCommand
+{
+public:
+
+  // The kind of object state a command replaces
+  enum class CoalesceType
+  {
+    None,       // always executed
+    Geometry,
+    PointCloud,
+    Transform,
+    Visibility,
+    VideoFrame, // handle is always 0
+    DepthFrame, // handle is always 0
+    Voxels      // handle is always 0
+  };
+
+  virtual ~RenderCommand() { }
+
+  // this executes on the rendering thread
+  virtual void execute() = 0;
+
+  // Called once the command was executed or dropped, the command must not be used afterwards
+  virtual void release() { delete this; }
+
+  // Appends the commands which should actually be executed to <commands>.
+  // Commands which group other commands (batches) hand over their content and release themselves.
+  virtual void flatten(Vector<RenderCommand*>& commands) { commands.push_back(this); }
+
+  // Commands with the same type & handle overwrite each other's state, so only the newest of them needs to run
+  virtual CoalesceType coalesceType() const { return CoalesceType::None; }
+  virtual unsigned int coalesceHandle() const { return 0; }
+
+  // False if this command builds on the result of earlier commands of the same type (e.g. relative transforms).
+  // Such commands can still be dropped in favor of a later command, but never make earlier commands redundant.
+  virtual bool supersedes() const { return true; }
+
+  // Size in bytes of the data held by this command, counted against the queue's byte budget
+  virtual size_t payloadSize() const { return 0; }
+
+  // Frees the data held by a command which is never going to be executed
+  virtual void discardPayload() { }
+
+  // Only commands which replace earlier state can be dropped or rejected when the queue is over budget
+  bool droppable() const { return coalesceType() != CoalesceType::None && supersedes(); }
+
+private:
+
+  friend class CommandQueue;
+
+  size_t _queuedBytes = 0; // payloadSize() at the time the command was enqueued
+  size_t _admittedBytes = 0; // payloadSize() at the time the command was admitted, see <CommandQueue::Admit>
+  bool _pending = false;   // registered as the newest command of its handle, only used by QueuePolicy::DropOldestPerHandle
+  bool _cancelled = false; // set by the queue if a newer command replaced this one before it was dequeued
+};
+
+/*
+ * Implements last-writer-wins for a batch of commands taken from a <CommandQueue>:
+ * a command is dropped if a later command in the batch replaces the same state of the same object.
+ * Everything else is kept in its original order.
+ */
+class CommandCoalescer
+{
+public:
+
+  // Removes and releases all redundant commands from <commands>
+  // @return Number of commands which were dropped
+  size_t Coalesce(Vector<RenderCommand*>& commands)
+  {
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+      const RenderCommand* command = commands[i];
+      if (command->coalesceType() == RenderCommand::CoalesceType::None)
+        continue;
+
+      _keyedCommands.push_back(KeyedCommand{ coalesceKey(command), i });
+    }
+
+    // group the commands by key, newest first within every group, so the first command we see for every key is the one which wins
+    // (sorting a vector instead of using a set keeps this free of allocations once the vector has grown)
+    std::sort(_keyedCommands.begin(), _keyedCommands.end(), [](const KeyedCommand& a, const KeyedCommand& b)
+    {
+      return a.key < b.key || (a.key == b.key && a.index > b.index);
+    });
+
+    size_t numDropped = 0;
+    for (size_t i = 0; i < _keyedCommands.size(); )
+    {
+      const uint64_t key = _keyedCommands[i].key;
+      bool superseded = false;
+      for (; i < _keyedCommands.size() && _keyedCommands[i].key == key; i++)
+      {
+        RenderCommand*& command = commands[_keyedCommands[i].index];
+        if (superseded)
+        {
+          command->release();
+          command = nullptr;
+          numDropped++;
+        }
+        else if (command->supersedes())
+        {
+          superseded = true;
+        }
+      }
+    }
+
+    if (numDropped > 0)
+      commands.erase(std::remove(commands.begin(), commands.end(), nullptr), commands.end());
+
+    _keyedCommands.clear();
+    return numDropped;
+  }
+
+  // Identifies the state a command replaces
+  static uint64_t coalesceKey(const RenderCommand* command)
+  {
+    return (uint64_t)command->coalesceType() << 32 | command->coalesceHandle();
+  }
+
+private:
+
+  struct KeyedCommand
+  {
+    uint64_t key;
+    size_t index;
+  };
+
+  Vector<KeyedCommand> _keyedCommands;
+};
+
+/*
+ * Queue of commands sent from any number of threads to the rendering thread.
+ * Producers don't take a lock as long as the queue stays within its <QueueBudget>.
+ * Once it is over budget the budget's policy decides whether producers wait, replace their older updates
+ * or have their updates rejected. If the queue is completely full, producers yield until the render thread caught up.
+ * Under QueuePolicy::DropOldestPerHandle the newest update of every handle is tracked in a small table of spinlocked slots,
+ * which producers and the render thread only lock for a single command.
+ */
+class CommandQueue
+{
+public:
+
+  // Maximum number of commands which can be waiting for the render thread
+  static constexpr size_t DefaultCapacity = 1 << 14;
+
+  explicit CommandQueue(size_t capacity = DefaultCapacity)
+    : _renderCommands(capacity)
+  {
+    SetBudget(QueueBudget());
+  }
+
+  ~CommandQueue()
+  {
+    // free everything the render thread didn't get to anymore
+    RenderCommand* command;
+    while (_renderCommands.TryDequeue(command))
+      command->release();
+  }
+
+  // Can be changed at any time, from any thread.
+  // Producers waiting for the queue to drain re-check the new budget.
+  void SetBudget(const QueueBudget& budget)
+  {
+    _maxCommands = budget.maxCommands;
+    _maxBytes = budget.maxBytes;
+    _policy = budget.policy;
+
+    MutexLockGuard guard(_budgetMutex);
+    _budgetCondition.notify_all();
+  }
+
+  QueueBudget GetBudget() const
+  {
+    return QueueBudget(_maxCommands, _maxBytes, _policy);
+  }
+
+  // @return False if the command was rejected because the queue is over budget or closed, it is released in that case
+  bool Enqueue(RenderCommand* renderCommand)
+  {
+    if (!applyPolicy(renderCommand, renderCommand->payloadSize()))
+      return false;
+
+    return enqueue(renderCommand);
+  }
+
+  // Applies the budget's policy to a command whose payload is prepared on another thread before it is enqueued,
+  // the command counts against the budget with its current payloadSize() until it is passed to <EnqueueAdmitted>.
+  // @return False if the command was rejected because the queue is over budget or closed, it is released in that case
+  bool Admit(RenderCommand* renderCommand)
+  {
+    const size_t bytes = renderCommand->payloadSize();
+    if (!applyPolicy(renderCommand, bytes))
+      return false;
+
+    renderCommand->_admittedBytes = bytes;
+    _numAdmittedBytes += bytes;
+    _numAdmittedCommands++;
+    return true;
+  }
+
+  // Enqueues a command accepted by <Admit>, charged with its final payload size.
+  // The policy was applied already, so this never waits for the budget or rejects the command.
+  // @return False if the queue was closed meanwhile, the command is released in that case
+  bool EnqueueAdmitted(RenderCommand* renderCommand)
+  {
+    unadmit(renderCommand);
+    return enqueue(renderCommand);
+  }
+
+  // Releases a command accepted by <Admit> which is not going to be enqueued
+  void CancelAdmitted(RenderCommand* renderCommand)
+  {
+    unadmit(renderCommand);
+    renderCommand->release();
+    notifyBlockedProducers();
+  }
+
+  // Call once the consumer stopped, commands enqueued afterwards are released right away
+  // and producers waiting for the budget or for room in the queue give up
+  void Close()
+  {
+    _closed = true;
+    notifyBlockedProducers();
+  }
+
+  // ! Call from the consuming thread only
+  // Moves all commands which are in the queue right now to the end of <commands>, batches are flattened.
+  // Commands enqueued while draining are left for the next call, so a busy producer can't stall the consumer.
+  // @return Number of queue entries which were dequeued
+  size_t DequeueAll(Vector<RenderCommand*>& commands)
+  {
+    const size_t numCommands = _renderCommands.SizeApprox();
+    RenderCommand* command;
+    size_t i = 0;
+    for (; i < numCommands && _renderCommands.TryDequeue(command); i++)
+    {
+      bool cancelled = false;
+      if (command->_pending)
+      {
+        // only the slot of this command's handle is locked, and only while it is unregistered
+        PendingSlot& slot = pendingSlot(CommandCoalescer::coalesceKey(command));
+        slot.lock();
+        if (slot.command == command)
+          slot.command = nullptr;
+        command->_pending = false;
+        cancelled = command->_cancelled;
+        slot.unlock();
+      }
+
+      _numBytes -= command->_queuedBytes;
+      if (cancelled)
+        command->release();
+      else
+        command->flatten(commands);
+    }
+
+    if (i > 0)
+      notifyBlockedProducers();
+
+    return i;
+  }
+
+  size_t NumEnqueuedCommands() const
+  {
+    return _renderCommands.SizeApprox();
+  }
+
+  // Size of the data held by all enqueued commands, see <RenderCommand::payloadSize>
+  size_t NumEnqueuedBytes() const
+  {
+    return _numBytes;
+  }
+
+  // Number of commands discarded by QueuePolicy::Reject
+  size_t NumRejectedCommands() const
+  {
+    return _numRejectedCommands;
+  }
+
+  // Number of commands discarded by QueuePolicy::DropOldestPerHandle
+  size_t NumDroppedCommands() const
+  {
+    return _numDroppedCommands;
+  }
+
+private:
+
+  // @return False if the command was rejected, it is released in that case
+  bool applyPolicy(RenderCommand* renderCommand, size_t bytes)
+  {
+    if (_closed)
+    {
+      renderCommand->release();
+      return false;
+    }
+
+    if (!withinBudget(bytes))
+    {
+      if (_policy == QueuePolicy::Block)
+      {
+        waitForBudget(bytes);
+      }
+      else if (_policy == QueuePolicy::Reject && renderCommand->droppable())
+      {
+        renderCommand->release();
+        _numRejectedCommands++;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unadmit(RenderCommand* renderCommand)
+  {
+    _numAdmittedBytes -= renderCommand->_admittedBytes;
+    _numAdmittedCommands--;
+    renderCommand->_admittedBytes = 0;
+  }
+
+  bool enqueue(RenderCommand* renderCommand)
+  {
+    if (_closed)
+    {
+      renderCommand->release();
+      return false;
+    }
+
+    const size_t bytes = renderCommand->payloadSize();
+    renderCommand->_queuedBytes = bytes;
+    renderCommand->_cancelled = false;
+
+    const QueuePolicy policy = _policy;
+    const bool droppable = renderCommand->droppable();
+
+    if (policy == QueuePolicy::DropOldestPerHandle && droppable)
+    {
+      // register before the consumer can see the command, the consumer unregisters it under the same lock
+      const uint64_t key = CommandCoalescer::coalesceKey(renderCommand);
+      PendingSlot& slot = pendingSlot(key);
+      slot.lock();
+      RenderCommand* pending = slot.command;
+      if (pending != nullptr && CommandCoalescer::coalesceKey(pending) == key && !withinBudget(bytes))
+      {
+        _numBytes -= pending->_queuedBytes;
+        pending->_queuedBytes = 0;
+        pending->_cancelled = true;
+        pending->discardPayload();
+        _numDroppedCommands++;
+      }
+      // a command of another handle which shares the slot just can't be dropped anymore
+      slot.command = renderCommand;
+      renderCommand->_pending = true;
+      slot.unlock();
+    }
+
+    _numBytes += bytes;
+    while (!_renderCommands.TryEnqueue(renderCommand))
+    {
+      if (_closed)
+      {
+        unregister(renderCommand);
+        _numBytes -= bytes;
+        renderCommand->release();
+        return false;
+      }
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+
+  // Newest command of the handles which map to this slot, see <pendingSlot>.
+  // Locked only while a command is registered or unregistered, so producers and the consumer rarely wait for each other.
+  struct PendingSlot
+  {
+    std::atomic_flag locked = ATOMIC_FLAG_INIT;
+    RenderCommand* command = nullptr;
+
+    void lock()
+    {
+      while (locked.test_and_set(std::memory_order_acquire))
+        std::this_thread::yield();
+    }
+
+    void unlock() { locked.clear(std::memory_order_release); }
+  };
+
+  static const size_t NumPendingSlots = 256;
+
+  PendingSlot& pendingSlot(uint64_t key)
+  {
+    // the handle's slot index is in the low bits, the type in the high ones
+    return _pendingSlots[(key ^ (key >> 29)) & (NumPendingSlots - 1)];
+  }
+
+  void unregister(RenderCommand* renderCommand)
+  {
+    if (!renderCommand->_pending)
+      return;
+
+    PendingSlot& slot = pendingSlot(CommandCoalescer::coalesceKey(renderCommand));
+    slot.lock();
+    if (slot.command == renderCommand)
+      slot.command = nullptr;
+    renderCommand->_pending = false;
+    slot.unlock();
+  }
+
+  // The budget is checked without synchronizing with other producers, so it can be exceeded slightly
+  // Admitted commands count as if they were in the queue already.
+  bool withinBudget(size_t bytes) const
+  {
+    const size_t numCommands = _renderCommands.SizeApprox() + _numAdmittedCommands;
+    if (numCommands == 0)
+      return true; // always accept a single command, however large it is
+
+    const size_t maxCommands = _maxCommands;
+    const size_t maxBytes = _maxBytes;
+    return (maxCommands == 0 || numCommands < maxCommands) &&
+           (maxBytes == 0 || _numBytes + _numAdmittedBytes + bytes <= maxBytes);
+  }
+
+  void waitForBudget(size_t bytes)
+  {
+    std::unique_lock<std::mutex> lock(_budgetMutex);
+    _numBlockedProducers++;
+    // the timeout covers wakeups which happen between checking the budget and starting to wait
+    while (!_closed && _policy == QueuePolicy::Block && !withinBudget(bytes))
+      _budgetCondition.wait_for(lock, std::chrono::milliseconds(10));
+    _numBlockedProducers--;
+  }
+
+  void notifyBlockedProducers()
+  {
+    if (_numBlockedProducers > 0)
+    {
+      MutexLockGuard guard(_budgetMutex);
+      _budgetCondition.notify_all();
+    }
+  }
+
+  BoundedQueue<RenderCommand*> _renderCommands;
+
+  std::atomic<size_t> _maxCommands;
+  std::atomic<size_t> _maxBytes;
+  std::atomic<QueuePolicy> _policy;
+
+  std::atomic<size_t> _numBytes {0};
+  std::atomic<size_t> _numAdmittedBytes {0};
+  std::atomic<size_t> _numAdmittedCommands {0};
+  std::atomic<bool> _closed {false};
+  std::atomic<size_t> _numRejectedCommands {0};
+  std::atomic<size_t> _numDroppedCommands {0};
+
+  std::mutex _budgetMutex;
+  std::condition_variable _budgetCondition;
+  std::atomic<int> _numBlockedProducers {0};
+
+  // newest enqueued command per handle, only used by QueuePolicy::DropOldestPerHandle
+  PendingSlot _pendingSlots[NumPendingSlots];
+};
+
+} // namespace ar
+
+#endif // _AR_COMMANDQUEUE_HPP
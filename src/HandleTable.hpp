@@ -0,0 +1,236 @@
+#ifndef _AR_HANDLETABLE_HPP
+#define _AR_HANDLETABLE_HPP
+
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include "common.hpp"
+
+namespace ar
+{
+
+// The kind of object a handle refers to, decides which render component owns it
+enum class HandleType : unsigned int
+{
+  None = 0, // handle 0 is never handed out
+  Mesh,
+  Line,
+  PointCloud,
+  Primitive, // sphere, box, capsule or ellipsoid drawn by the <PrimitiveRenderer>
+
+  Count
+};
+
+/*
+ * Hands out handles for scene objects.
+ * A handle packs the object's type, a slot index and the slot's generation:
+ *
+ *   | type (3 bits) | generation (12 bits) | slot (17 bits) |
+ *
+ * Slots are reused once their object was removed, with a new generation, so handles of removed objects
+ * never match the handle of the object which took over the slot. <HandleMap> uses the slot as an array index.
+ * Freed slots are reused oldest first, and only once enough of them piled up, so a slot which is freed and
+ * allocated again in a loop doesn't run through its generations and hand out the same handle again.
+ */
+class HandleTable
+{
+public:
+
+  static const unsigned int SlotBits = 17;
+  static const unsigned int GenerationBits = 12;
+  static const unsigned int TypeBits = 3;
+
+  static const unsigned int MaxSlots = 1u << SlotBits;
+  static const unsigned int MaxGeneration = (1u << GenerationBits) - 1;
+
+  // Number of freed slots of a type which are kept before they are reused
+  static const size_t MinFreeSlots = 1024;
+
+  static HandleType Type(unsigned int handle) { return static_cast<HandleType>(handle >> (SlotBits + GenerationBits)); }
+  static size_t Slot(unsigned int handle) { return handle & (MaxSlots - 1); }
+  static unsigned int Generation(unsigned int handle) { return (handle >> SlotBits) & MaxGeneration; }
+  static unsigned int NextGeneration(unsigned int generation) { return (generation + 1) & MaxGeneration; }
+
+  // @return True if <generation> is <other> or was handed out after it, taking the wrap-around into account
+  static bool NotOlder(unsigned int generation, unsigned int other)
+  {
+    return ((generation - other) & MaxGeneration) <= MaxGeneration / 2;
+  }
+
+  // Reserves a slot for a new object, can be called from any thread
+  // @return The handle of the new object
+  unsigned int Allocate(HandleType type)
+  {
+    MutexLockGuard guard(_mutex);
+    Slots& slots = _slots[static_cast<size_t>(type)];
+
+    size_t slot;
+    if (slots.freeSlots.size() > MinFreeSlots || (!slots.freeSlots.empty() && slots.generations.size() == MaxSlots))
+    {
+      slot = slots.freeSlots.front();
+      slots.freeSlots.pop_front();
+    }
+    else
+    {
+      if (slots.generations.size() == MaxSlots)
+        throw std::runtime_error("Too many objects in the scene");
+
+      slot = slots.generations.size();
+      slots.generations.push_back(0);
+    }
+
+    return makeHandle(type, slots.generations[slot], slot);
+  }
+
+  // Makes the slot of <handle> available again, can be called from any thread
+  // Call this once the object is gone, <handle> is stale afterwards.
+  void Free(unsigned int handle)
+  {
+    const HandleType type = Type(handle);
+    if (type == HandleType::None)
+      return;
+
+    MutexLockGuard guard(_mutex);
+    Slots& slots = _slots[static_cast<size_t>(type)];
+
+    const size_t slot = Slot(handle);
+    if (slot >= slots.generations.size() || slots.generations[slot] != Generation(handle))
+      return; // freed already
+
+    slots.generations[slot] = NextGeneration(slots.generations[slot]);
+    slots.freeSlots.push_back(slot);
+  }
+
+private:
+
+  static unsigned int makeHandle(HandleType type, unsigned int generation, size_t slot)
+  {
+    return static_cast<unsigned int>(type) << (SlotBits + GenerationBits) | generation << SlotBits | static_cast<unsigned int>(slot);
+  }
+
+  struct Slots
+  {
+    Vector<unsigned int> generations; // current generation of every slot
+    std::deque<size_t> freeSlots; // oldest first
+  };
+
+  std::mutex _mutex;
+  Slots _slots[static_cast<size_t>(HandleType::Count)];
+};
+
+/*
+ * Maps handles to values with plain array lookups, indexed by the handle's slot.
+ * Looking up a handle whose slot now belongs to a newer object finds nothing, and every slot remembers the
+ * generations it has seen, so setting a value for the handle of an erased object doesn't overwrite anything.
+ * Not thread-safe, only used on the render thread.
+ */
+template <typename T>
+class HandleMap
+{
+public:
+
+  // @return Pointer to the value stored for <handle>, or nullptr if there is none
+  T* Find(unsigned int handle)
+  {
+    Entry* entry = findEntry(handle);
+    return entry != nullptr ? &entry->value : nullptr;
+  }
+
+  const T* Find(unsigned int handle) const
+  {
+    return const_cast<HandleMap*>(this)->Find(handle);
+  }
+
+  // @return False if <handle> is older than the slot's current object or was erased already, nothing is set then
+  bool Set(unsigned int handle, const T& value)
+  {
+    Entry* entry = slotEntry(handle);
+    if (entry == nullptr || stale(*entry, handle))
+      return false;
+
+    entry->handle = handle;
+    entry->generation = HandleTable::Generation(handle);
+    entry->value = value;
+    return true;
+  }
+
+  // Call when the object of <handle> is gone, values set for it later on are refused
+  // @return False if there was no value for <handle>
+  bool Erase(unsigned int handle)
+  {
+    Entry* entry = slotEntry(handle);
+    if (entry == nullptr || stale(*entry, handle))
+      return false;
+
+    entry->generation = HandleTable::NextGeneration(HandleTable::Generation(handle));
+    if (entry->handle != handle)
+      return false;
+
+    entry->handle = 0;
+    entry->value = T();
+    return true;
+  }
+
+  // Erases the values of all handles
+  void Clear()
+  {
+    for (auto& entries : _entries)
+    {
+      for (auto& entry : entries)
+      {
+        if (entry.handle != 0)
+          Erase(entry.handle);
+      }
+    }
+  }
+
+private:
+
+  struct Entry
+  {
+    unsigned int handle = 0;                  // 0 while the slot has no value
+    unsigned int generation = UnknownGeneration; // oldest generation which may still set a value
+    T value = T();
+  };
+
+  static const unsigned int UnknownGeneration = ~0u;
+
+  static bool stale(const Entry& entry, unsigned int handle)
+  {
+    return entry.generation != UnknownGeneration && !HandleTable::NotOlder(HandleTable::Generation(handle), entry.generation);
+  }
+
+  // @return The entry for the slot of <handle>, which is added if needed, nullptr for invalid handles
+  Entry* slotEntry(unsigned int handle)
+  {
+    const HandleType type = HandleTable::Type(handle);
+    if (type == HandleType::None || type >= HandleType::Count)
+      return nullptr;
+
+    Vector<Entry>& entries = _entries[static_cast<size_t>(type)];
+    const size_t slot = HandleTable::Slot(handle);
+    if (slot >= entries.size())
+      entries.resize(slot + 1);
+    return &entries[slot];
+  }
+
+  Entry* findEntry(unsigned int handle)
+  {
+    const HandleType type = HandleTable::Type(handle);
+    if (type == HandleType::None || type >= HandleType::Count)
+      return nullptr;
+
+    Vector<Entry>& entries = _entries[static_cast<size_t>(type)];
+    const size_t slot = HandleTable::Slot(handle);
+    if (slot >= entries.size() || entries[slot].handle != handle)
+      return nullptr;
+
+    return &entries[slot];
+  }
+
+  Vector<Entry> _entries[static_cast<size_t>(HandleType::Count)];
+};
+
+} // namespace ar
+
+#endif // _AR_HANDLETABLE_HPP
@@ -3,6 +3,7 @@
 
 #include "ImguiRenderer.hpp"
 #include "common.hpp"
+#include "rendering/GLStateCache.hpp"
 #include <mutex>
 
 #include <imgui.h>
@@ -154,6 +155,9 @@ void ImguiRenderer::RenderDrawLists(ImDrawData* draw_data)
   if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
   if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
   glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
+
+  // the state was changed and restored behind the cache's back
+  GLStateCache::Get().Invalidate();
 }
 
 void ImguiRenderer::NewFrame()
@@ -207,9 +211,10 @@ void ImguiRenderer::NewFrame()
 
 void ImguiRenderer::InvalidateDeviceObjects()
 {
-  if (_vaoHandle) glDeleteVertexArrays(1, &_vaoHandle);
-  if (_vboHandle) glDeleteBuffers(1, &_vboHandle);
-  if (_elementsHandle) glDeleteBuffers(1, &_elementsHandle);
+  // the names may be handed out again, so the cache must not think they are still bound
+  if (_vaoHandle) GLStateCache::Get().DeleteVertexArray(_vaoHandle);
+  if (_vboHandle) GLStateCache::Get().DeleteBuffer(_vboHandle);
+  if (_elementsHandle) GLStateCache::Get().DeleteBuffer(_elementsHandle);
   _vaoHandle = _vboHandle = _elementsHandle = 0;
 
   glDetachShader(_shaderHandle, _vertHandle);
@@ -220,7 +225,7 @@ void ImguiRenderer::InvalidateDeviceObjects()
   glDeleteShader(_fragHandle);
   _fragHandle = 0;
 
-  glDeleteProgram(_shaderHandle);
+  GLStateCache::Get().DeleteProgram(_shaderHandle);
   _shaderHandle = 0;
 
   if (_fontTexture)
@@ -304,6 +309,7 @@ void ImguiRenderer::CreateDeviceObjects()
   glBindTexture(GL_TEXTURE_2D, last_texture);
   glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
   glBindVertexArray(last_vertex_array);
+  GLStateCache::Get().Invalidate();
 }
 
 void ImguiRenderer::CreateFontsTexture()
@@ -0,0 +1,22 @@
+#ifndef _ARLODTHRESHOLDS_H
+#define _ARLODTHRESHOLDS_H
+
+namespace ar
+{
+  // Decides how many triangles spheres, capsules and ellipsoids are drawn with, from their radius on screen.
+  // Each shape has four levels of detail; an object uses the finest level whose threshold its projected radius reaches,
+  // objects smaller than <low> use the coarsest one.
+  struct LodThresholds
+  {
+    float high;   // projected radius, in pixels, from which the finest level is used
+    float medium; // projected radius, in pixels, from which the second level is used
+    float low;    // projected radius, in pixels, from which the third level is used
+
+    LodThresholds(float high = 100.0f, float medium = 30.0f, float low = 8.0f)
+      : high(high), medium(medium), low(low)
+    {
+    }
+  };
+}
+
+#endif // _ARLODTHRESHOLDS_H
@@ -53,19 +53,20 @@ namespace ar
   {
   public:
     FlatColorMaterial (Color color) {
-      _color = color;
       _uniformNames = {"color"};
-
-      if (_color.a < 1.0)
-        _opaque = false;
-      else
-        _opaque = true;
+      SetColor(color);
     }
 
     virtual void Apply() {
       glUniform4f(_shader->getUniform("color"), _color.r, _color.g, _color.b, _color.a);
     }
 
+    const Color& GetColor() const { return _color; }
+    void SetColor(Color color) {
+      _color = color;
+      _opaque = _color.a >= 1.0;
+    }
+
   private:
     Color _color;
   };
@@ -0,0 +1,33 @@
+#ifndef _ARQUEUEBUDGET_H
+#define _ARQUEUEBUDGET_H
+
+#include <cstddef>
+
+namespace ar
+{
+  // What happens to an update which arrives while the render queue is over its budget
+  enum class QueuePolicy
+  {
+    Block,               // the calling thread waits until the render thread caught up
+    DropOldestPerHandle, // the oldest pending update of the same object (or video / voxel stream) is discarded
+    Reject               // the new update is discarded and the update call returns false
+  };
+
+  // Limits how much work may wait for the render thread.
+  // Adding and removing objects is never dropped or rejected; those calls only block under QueuePolicy::Block.
+  struct QueueBudget
+  {
+    static const size_t DefaultMaxBytes = 256 * 1024 * 1024;
+
+    size_t maxCommands; // maximum number of pending commands, 0 for no limit
+    size_t maxBytes;    // maximum size of the data (points, meshes, video frames...) held by pending commands, 0 for no limit
+    QueuePolicy policy;
+
+    QueueBudget(size_t maxCommands = 0, size_t maxBytes = DefaultMaxBytes, QueuePolicy policy = QueuePolicy::Block)
+      : maxCommands(maxCommands), maxBytes(maxBytes), policy(policy)
+    {
+    }
+  };
+}
+
+#endif // _ARQUEUEBUDGET_H
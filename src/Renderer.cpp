@@ -1,6 +1,7 @@
 #include "Renderer.hpp"
 #include "rendering/SceneInfo.hpp"
 #include "mesh/MeshFactory.hpp"
+#include <algorithm>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
@@ -8,25 +9,34 @@
 namespace ar
 {
 
+// size of the data held by a mesh, for the command queue's byte budget
+template <typename VertexT>
+static size_t meshPayloadSize(const Mesh<VertexT>& mesh)
+{
+  return mesh.VertexCount() * sizeof(VertexT) + mesh.IndexCount() * sizeof(GLuint);
+}
+
 template <typename T>
 class Renderer::RenderCommandAddMesh : public RenderCommand
 {
 public:
 
-  RenderCommandAddMesh(Renderer* renderer, unsigned int handle, const Mesh<T>& _mesh, SharedPtr<Material> _material)
-    : _renderer(renderer), _handle(handle), _mesh(new Mesh<T>(_mesh)), _material(_material)
+  RenderCommandAddMesh(Renderer* renderer, unsigned int handle, Mesh<T>&& _mesh, SharedPtr<Material> _material)
+    : _renderer(renderer), _handle(handle), _mesh(new Mesh<T>(std::move(_mesh))), _material(_material)
   { }
 
   virtual void execute() override
   {
     _mesh->SetMaterial(_material);
     _mesh->SetID(_handle);
-    _renderer->_meshRenderer.AddMesh(_mesh);
+    _renderer->_meshRenderer.AddMesh(_mesh.release());
   }
 
+  virtual size_t payloadSize() const override { return meshPayloadSize(*_mesh); }
+
   Renderer* _renderer;
   unsigned int _handle;
-  Mesh<T>* _mesh;
+  UniquePtr<Mesh<T>> _mesh; // only owned until the command is executed
   SharedPtr<Material> _material;
 };
 
@@ -34,36 +44,55 @@ class Renderer::RenderCommandAddLineMesh : public RenderCommand
 {
 public:
 
-  RenderCommandAddLineMesh(Renderer* renderer, unsigned int handle, const LineMesh& _mesh, SharedPtr<Material> _material)
-    : _renderer(renderer), _handle(handle), _mesh(new LineMesh(_mesh)), _material(_material)
+  RenderCommandAddLineMesh(Renderer* renderer, unsigned int handle, LineMesh&& _mesh, SharedPtr<Material> _material)
+    : _renderer(renderer), _handle(handle), _mesh(new LineMesh(std::move(_mesh))), _material(_material)
   { }
 
   virtual void execute() override
   {
     _mesh->SetMaterial(_material);
     _mesh->SetID(_handle);
-    _renderer->_lineRenderer.AddMesh(_mesh);
+    _renderer->_lineRenderer.AddMesh(_mesh.release());
   }
 
+  virtual size_t payloadSize() const override { return meshPayloadSize(*_mesh); }
+
   Renderer* _renderer;
   unsigned int _handle;
-  LineMesh* _mesh;
+  UniquePtr<LineMesh> _mesh; // only owned until the command is executed
   SharedPtr<Material> _material;
 };
 
-class Renderer::RenderCommandUpdateTransform : public RenderCommand
+class Renderer::RenderCommandUpdateTransform : public PooledRenderCommand<RenderCommandUpdateTransform>
 {
 public:
-  RenderCommandUpdateTransform(Renderer* renderer, unsigned int handle, const glm::mat4& transform, bool absolute)
-    : _renderer(renderer), _handle(handle), _transform(transform), _absolute(absolute)
-  { }
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(Renderer* renderer, unsigned int handle, const glm::mat4& transform, bool absolute)
+  {
+    _renderer = renderer;
+    _handle = handle;
+    _transform = transform;
+    _absolute = absolute;
+  }
 
   virtual void execute() override
   {
-    _renderer->_meshRenderer.SetMeshTransform(_handle, _transform, _absolute);
-    _renderer->_pointCloudRenderer.SetPointCloudTransform(_handle, _transform, _absolute);
+    switch (HandleTable::Type(_handle))
+    {
+      case HandleType::Mesh:       _renderer->_meshRenderer.SetMeshTransform(_handle, _transform, _absolute); break;
+      case HandleType::Line:       _renderer->_lineRenderer.SetMeshTransform(_handle, _transform, _absolute); break;
+      case HandleType::Primitive:  _renderer->_primitiveRenderer.SetPrimitiveTransform(_handle, _transform, _absolute); break;
+      case HandleType::PointCloud: _renderer->_pointCloudRenderer.SetPointCloudTransform(_handle, _transform, _absolute); break;
+      default: break;
+    }
   }
 
+  virtual CoalesceType coalesceType() const override { return CoalesceType::Transform; }
+  virtual unsigned int coalesceHandle() const override { return _handle; }
+  // relative transforms are applied on top of the previous ones
+  virtual bool supersedes() const override { return _absolute; }
+
   Renderer* _renderer;
   unsigned int _handle;
   glm::mat4 _transform;
@@ -73,40 +102,81 @@ public:
 class Renderer::RenderCommandUpdateMesh : public RenderCommand
 {
 public:
-  RenderCommandUpdateMesh(Renderer* renderer, unsigned int handle, const Mesh3D& mesh, SharedPtr<Material> material)
-    : _renderer(renderer), _handle(handle), _mesh(new Mesh3D(mesh)), _material(material)
+  RenderCommandUpdateMesh(Renderer* renderer, unsigned int handle, Mesh3D&& mesh, SharedPtr<Material> material)
+    : _renderer(renderer), _handle(handle), _mesh(new Mesh3D(std::move(mesh))), _material(material)
   { }
 
   virtual void execute() override
   {
     _mesh->SetMaterial(_material);
     _mesh->SetID(_handle);
-    _renderer->_meshRenderer.UpdateMesh(_handle, _mesh);
+    _renderer->_meshRenderer.UpdateMesh(_handle, _mesh.release());
   }
 
+  virtual CoalesceType coalesceType() const override { return CoalesceType::Geometry; }
+  virtual unsigned int coalesceHandle() const override { return _handle; }
+  virtual size_t payloadSize() const override { return meshPayloadSize(*_mesh); }
+  virtual void discardPayload() override { _mesh.reset(); }
+
   Renderer* _renderer;
   unsigned int _handle;
-  Mesh3D* _mesh;
+  UniquePtr<Mesh3D> _mesh; // only owned until the command is executed
   SharedPtr<Material> _material;
 };
 
+class Renderer::RenderCommandSetPrimitive : public PooledRenderCommand<RenderCommandSetPrimitive>
+{
+public:
+  using PooledRenderCommand::PooledRenderCommand;
+
+  // @add Set to add a new primitive, otherwise the existing one is replaced
+  void init(Renderer* renderer, unsigned int handle, const Primitive& primitive, bool add)
+  {
+    _renderer = renderer;
+    _handle = handle;
+    _primitive = primitive;
+    _add = add;
+  }
+
+  virtual void execute() override
+  {
+    if (_add)
+      _renderer->_primitiveRenderer.AddPrimitive(_handle, _primitive);
+    else
+      _renderer->_primitiveRenderer.UpdatePrimitive(_handle, _primitive);
+  }
+
+  virtual CoalesceType coalesceType() const override { return _add ? CoalesceType::None : CoalesceType::Geometry; }
+  virtual unsigned int coalesceHandle() const override { return _handle; }
+
+  Renderer* _renderer;
+  unsigned int _handle;
+  Primitive _primitive;
+  bool _add;
+};
+
 class Renderer::RenderCommandUpdateLineMesh : public RenderCommand
 {
 public:
-  RenderCommandUpdateLineMesh(Renderer* renderer, unsigned int handle, const LineMesh& mesh, SharedPtr<Material> material)
-    : _renderer(renderer), _handle(handle), _mesh(new LineMesh(mesh)), _material(material)
+  RenderCommandUpdateLineMesh(Renderer* renderer, unsigned int handle, LineMesh&& mesh, SharedPtr<Material> material)
+    : _renderer(renderer), _handle(handle), _mesh(new LineMesh(std::move(mesh))), _material(material)
   { }
 
   virtual void execute() override
   {
     _mesh->SetMaterial(_material);
     _mesh->SetID(_handle);
-    _renderer->_lineRenderer.UpdateMesh(_handle, _mesh);
+    _renderer->_lineRenderer.UpdateMesh(_handle, _mesh.release());
   }
 
+  virtual CoalesceType coalesceType() const override { return CoalesceType::Geometry; }
+  virtual unsigned int coalesceHandle() const override { return _handle; }
+  virtual size_t payloadSize() const override { return meshPayloadSize(*_mesh); }
+  virtual void discardPayload() override { _mesh.reset(); }
+
   Renderer* _renderer;
   unsigned int _handle;
-  LineMesh* _mesh;
+  UniquePtr<LineMesh> _mesh; // only owned until the command is executed
   SharedPtr<Material> _material;
 };
 
@@ -119,13 +189,28 @@ public:
 
   virtual void execute() override
   {
-    auto it = _renderer->_visibilityMap.find(_handle);
-    if (it != _renderer->_visibilityMap.end())
-      _renderer->_visibilityMap.erase(it);
+    _renderer->_visibilityMap.Erase(_handle);
 
-    _renderer->_meshRenderer.RemoveMesh(_handle);
-    _renderer->_lineRenderer.RemoveMesh(_handle);
-    _renderer->_pointCloudRenderer.RemovePointCloud(_handle);
+    bool removed = false;
+    switch (HandleTable::Type(_handle))
+    {
+      case HandleType::Mesh:       removed = _renderer->_meshRenderer.RemoveMesh(_handle); break;
+      case HandleType::Line:       removed = _renderer->_lineRenderer.RemoveMesh(_handle); break;
+      case HandleType::Primitive:  removed = _renderer->_primitiveRenderer.RemovePrimitive(_handle); break;
+      case HandleType::PointCloud: removed = _renderer->_pointCloudRenderer.RemovePointCloud(_handle); break;
+      default: break;
+    }
+
+    if (removed && HandleTable::Type(_handle) == HandleType::PointCloud)
+    {
+      // buffers still in flight keep the staging object alive until they are released
+      MutexLockGuard guard(_renderer->_pointCloudStateLock);
+      _renderer->_pointCloudStates.erase(_handle);
+    }
+
+    // only recycle the handle once the object is actually gone, so pending commands for it can't hit a new object
+    if (removed)
+      _renderer->_handles.Free(_handle);
   }
 
   Renderer* _renderer;
@@ -143,9 +228,17 @@ public:
   {
     if (_removeMeshes)
     {
-      _renderer->_visibilityMap.clear();
+      // point clouds aren't removed, so only the visibility of the removed objects is erased
+      for (auto handle : _renderer->_meshRenderer.Handles())
+        freeHandle(handle);
+      for (auto handle : _renderer->_lineRenderer.Handles())
+        freeHandle(handle);
+      for (auto handle : _renderer->_primitiveRenderer.Handles())
+        freeHandle(handle);
+
       _renderer->_meshRenderer.RemoveAllMeshes();
       _renderer->_lineRenderer.RemoveAllMeshes();
+      _renderer->_primitiveRenderer.RemoveAllPrimitives();
       //_renderer->_pointCloudRenderer.RemoveAllPointClouds();
     }
     if (_removeVoxels)
@@ -154,84 +247,143 @@ public:
     }
   }
 
+  void freeHandle(unsigned int handle)
+  {
+    _renderer->_visibilityMap.Erase(handle);
+    _renderer->_handles.Free(handle);
+  }
+
   Renderer* _renderer;
   bool _removeMeshes;
   bool _removeVoxels;
 };
 
-class Renderer::RenderCommandNotifyNewVideoFrame : public RenderCommand
+class Renderer::RenderCommandNotifyNewVideoFrame : public PooledRenderCommand<RenderCommandNotifyNewVideoFrame>
 {
 public:
+  using PooledRenderCommand::PooledRenderCommand;
 
-  RenderCommandNotifyNewVideoFrame(Renderer* renderer, unsigned int width, unsigned int height, const unsigned char* pixels)
-    : _renderer(renderer), _width(width), _height(height)
+  // <largefactor> > 1 pads the frame with gray rows above and below
+  void init(Renderer* renderer, unsigned int width, unsigned int height, const unsigned char* pixels, float largefactor = 1)
   {
-    _pixels = UniquePtr<unsigned char[]>(new unsigned char[width * height * 3]);
+    _renderer = renderer;
+    _width = width;
+    _height = height;
+    _largefactor = largefactor;
+
+    const size_t frameSize = width * height * 3;
+    const size_t paddedSize = static_cast<size_t>(width * largefactor * height * 3);
+    const size_t padding = static_cast<size_t>(frameSize * (largefactor - 1) / 2);
+
+    reservePayload(_pixels, paddedSize);
+    _pixels.resize(paddedSize);
+    std::fill(_pixels.begin(), _pixels.begin() + padding, 50);
+    std::copy(pixels, pixels + frameSize, _pixels.begin() + padding);
+    std::fill(_pixels.begin() + padding + frameSize, _pixels.end(), 50);
+  }
 
-    // TODO: Memcpy
-    for (size_t i = 0; i < width * height * 3; i++)
-    {
-      _pixels[i] = pixels[i];
-    }
+  virtual void execute() override
+  {
+    _renderer->_videoRenderer.SetNewFrame(_width, static_cast<unsigned int>(_largefactor * _height), _pixels.data());
   }
 
-  RenderCommandNotifyNewVideoFrame(Renderer* renderer, unsigned int width, unsigned int height, const unsigned char* pixels, float largefactor)
-    : _renderer(renderer), _width(width), _height(height), _largefactor(largefactor)
+  virtual CoalesceType coalesceType() const override { return CoalesceType::VideoFrame; }
+  virtual size_t payloadSize() const override { return _pixels.size(); }
+  virtual void discardPayload() override { Vector<unsigned char>().swap(_pixels); }
+
+  Renderer* _renderer;
+  unsigned int _width;
+  unsigned int _height;
+  float _largefactor = 1;
+
+  Vector<unsigned char> _pixels;
+};
+
+class Renderer::RenderCommandNotifyNewDepthFrame : public PooledRenderCommand<RenderCommandNotifyNewDepthFrame>
+{
+public:
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(Renderer* renderer, unsigned int width, unsigned int height, const uint16_t* depth, const unsigned char* rgb, const DepthIntrinsics& intrinsics)
   {
-    _pixels = UniquePtr<unsigned char[]>(new unsigned char[static_cast<unsigned int>(width * largefactor * height * 3)]);
+    _renderer = renderer;
+    _width = width;
+    _height = height;
+    _intrinsics = intrinsics;
 
-    // TODO: Memcpy
-    for (size_t i = 0; i < static_cast<size_t>(width * height * 3 * (_largefactor - 1) / 2); i++)
-    {
-      _pixels[i] = 50;
-    }
-    size_t start = static_cast<size_t>(width * height * 3 * (_largefactor - 1) / 2);
-    for (size_t i = start; i < start + width * height * 3; i++)
+    const size_t numPixels = static_cast<size_t>(width) * height;
+    reservePayload(_depth, numPixels);
+    _depth.assign(depth, depth + numPixels);
+
+    if (rgb != nullptr)
     {
-      _pixels[i] = pixels[i-start];
+      reservePayload(_color, numPixels * 3);
+      _color.assign(rgb, rgb + numPixels * 3);
     }
-    start = start + width * height * 3;
-    for (size_t i = start; i < static_cast<size_t>(start + width * height * 3 * (_largefactor - 1) / 2); i++)
+    else
     {
-      _pixels[i] = 50;
+      _color.clear();
     }
   }
 
   virtual void execute() override
   {
-    _renderer->_videoRenderer.SetNewFrame(_width, static_cast<unsigned int>(_largefactor * _height), _pixels.get());
+    _renderer->_depthFrameRenderer.SetNewFrame(_width, _height, _depth, _color, _intrinsics);
+  }
+
+  virtual CoalesceType coalesceType() const override { return CoalesceType::DepthFrame; }
+  virtual size_t payloadSize() const override { return _depth.size() * sizeof(uint16_t) + _color.size(); }
+
+  virtual void discardPayload() override
+  {
+    Vector<uint16_t>().swap(_depth);
+    Vector<unsigned char>().swap(_color);
   }
 
   Renderer* _renderer;
   unsigned int _width;
   unsigned int _height;
-  float _largefactor = 1;
+  DepthIntrinsics _intrinsics;
 
-  UniquePtr<unsigned char[]> _pixels;
+  Vector<uint16_t> _depth;
+  Vector<unsigned char> _color;
 };
 
 class Renderer::RenderCommandAddPointCloud : public RenderCommand
 {
 public:
-  RenderCommandAddPointCloud(Renderer* renderer, unsigned int handle, const void* pointData, size_t numPoints, bool colored, Color color)
+  RenderCommandAddPointCloud(Renderer* renderer, unsigned int handle, const void* pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options)
+    : _renderer(renderer), _handle(handle), _colored(colored), _color(color), _options(options)
+  {
+    if (options.quantized)
+      createQuantized();
+    else if (!colored)
+      create<VertexP4>()->SetPoints(reinterpret_cast<const VertexP4*>(pointData), numPoints);
+    else
+      create<VertexP3RGBA>();
+  }
+
+  // Zero-copy version, the point cloud keeps a reference to <pointData> until it was uploaded
+  RenderCommandAddPointCloud(Renderer* renderer, unsigned int handle, SharedPtr<const void> pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options)
+    : _renderer(renderer), _handle(handle), _colored(colored), _color(color), _options(options)
+  {
+    if (options.quantized)
+      createQuantized();
+    else if (!colored)
+      create<VertexP4>()->SetSharedPoints(std::move(pointData), numPoints);
+    else
+      create<VertexP3RGBA>();
+  }
+
+  // Empty rolling cloud, see <RollingPointCloud>
+  RenderCommandAddPointCloud(Renderer* renderer, unsigned int handle, size_t capacity, bool colored, Color color)
     : _renderer(renderer), _handle(handle), _colored(colored), _color(color)
   {
     if (!colored)
-    {
-      const auto verts = reinterpret_cast<const VertexP4*>(pointData);
-      auto pc = new PointCloud<VertexP4>;
-      pc->SetPoints(verts, numPoints);
-      pc->SetID(handle);
-      _pointCloud.reset(pc);
-    }
+      _pointCloud.reset(new RollingPointCloud<VertexP4>(capacity));
     else
-    {
-      const auto verts = reinterpret_cast<const Vertex_PCL_PointXYZRGBA*>(pointData);
-      auto pc = new PointCloud<Vertex_PCL_PointXYZRGBA>;
-      pc->SetPoints(verts, numPoints);
-      pc->SetID(handle);
-      _pointCloud.reset(pc);
-    }
+      _pointCloud.reset(new RollingPointCloud<VertexP3RGBA>(capacity));
+    _pointCloud->SetID(handle);
   }
 
   virtual void execute() override
@@ -239,54 +391,344 @@ public:
     _renderer->_pointCloudRenderer.AddPointCloud(std::move(_pointCloud), _colored, _color);
   }
 
+  virtual size_t payloadSize() const override
+  {
+    return _pointCloud->NumPoints() * _pointCloud->VertexSize();
+  }
+
+  // clouds with history keep their last uploads, see <HistoryPointCloud>
+  template <typename VertexT>
+  PointCloud<VertexT>* create()
+  {
+    PointCloud<VertexT>* pc;
+    if (_options.historyFrames > 0)
+      pc = new HistoryPointCloud<VertexT>(_options.historyFrames, _options.historyDuration);
+    else
+      pc = new PointCloud<VertexT>;
+    pc->SetID(_handle);
+    pc->SetStreaming(_options.streaming);
+    pc->SetLod(_options.lod);
+    _pointCloud.reset(pc);
+    return pc;
+  }
+
+  // colored and quantized clouds start out empty, their points are converted off the calling thread by the first update
+  void createQuantized()
+  {
+    if (!_colored)
+      create<VertexP3Q>();
+    else
+      create<VertexP3QC4>();
+  }
+
   Renderer* _renderer;
   unsigned int _handle;
   UniquePtr<BasePointCloud> _pointCloud;
   bool _colored;
   Color _color;
+  PointCloudOptions _options;
 };
 
-// TODO: If we get multiple of these in the command queue we only want to take the last one
-class Renderer::RenderCommandUpdatePointCloud : public RenderCommand
+class Renderer::RenderCommandUpdatePointCloud : public PooledRenderCommand<RenderCommandUpdatePointCloud>
 {
 public:
-  RenderCommandUpdatePointCloud(Renderer* renderer, unsigned int handle, const void* pointData, size_t numPoints, bool colored, Color color)
-    : _renderer(renderer), _handle(handle), _colored(colored), _color(color)
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(Renderer* renderer, unsigned int handle, const void* pointData, size_t numPoints, bool colored, bool quantized, float voxelSize, Color color, bool keepsHistory)
   {
-    if (!colored)
+    setup(renderer, handle, numPoints, colored, quantized, voxelSize, color, keepsHistory);
+    convert(pointData);
+  }
+
+  // Deferred version, only copies the points, <convert> converts them later on the conversion thread
+  void initDeferred(Renderer* renderer, unsigned int handle, const void* pointData, size_t numPoints, bool colored, bool quantized, float voxelSize, Color color, bool keepsHistory)
+  {
+    setup(renderer, handle, numPoints, colored, quantized, voxelSize, color, keepsHistory);
+    const size_t numBytes = numPoints * (colored ? sizeof(Vertex_PCL_PointXYZRGBA) : sizeof(VertexP4));
+    reservePayload(_input, numBytes);
+    _input.assign(static_cast<const unsigned char*>(pointData), static_cast<const unsigned char*>(pointData) + numBytes);
+  }
+
+  // Deferred zero-copy version, keeps the reference to <pointData> until <convert> is done with it
+  void initDeferred(Renderer* renderer, unsigned int handle, SharedPtr<const void> pointData, size_t numPoints, bool colored, bool quantized, float voxelSize, Color color, bool keepsHistory)
+  {
+    setup(renderer, handle, numPoints, colored, quantized, voxelSize, color, keepsHistory);
+    _sharedInput = std::move(pointData);
+  }
+
+  // Converts the points kept by <initDeferred>
+  void convert()
+  {
+    convert(_sharedInput != nullptr ? _sharedInput.get() : _input.data());
+    _sharedInput.reset();
+    _input.clear();
+  }
+
+  void setup(Renderer* renderer, unsigned int handle, size_t numPoints, bool colored, bool quantized, float voxelSize, Color color, bool keepsHistory)
+  {
+    _renderer = renderer;
+    _handle = handle;
+    _keepsHistory = keepsHistory;
+    _colored = colored;
+    _quantized = quantized;
+    _voxelSize = voxelSize;
+    _numInputPoints = numPoints;
+    _color = color;
+  }
+
+  // large clouds are split over the renderer's conversion pool
+  void convert(const void* pointData)
+  {
+    const size_t numPoints = _numInputPoints;
+    WorkerPool* pool = &_renderer->_conversionPool;
+
+    // downsampled into _points or _pointsColored, quantized clouds convert them from there
+    if (_voxelSize > 0.0f)
+    {
+      if (!_colored)
+        VoxelGridFilter(reinterpret_cast<const VertexP4*>(pointData), numPoints, _voxelSize, _points, pool);
+      else
+        VoxelGridFilter(reinterpret_cast<const Vertex_PCL_PointXYZRGBA*>(pointData), numPoints, _voxelSize, _pointsColored, pool);
+    }
+
+    // the point cloud renderer swaps its previous points into these vectors, so they are refilled in place
+    if (_quantized && !_colored)
+    {
+      reservePayload(_pointsQuantized, numPoints);
+      if (_voxelSize > 0.0f)
+        _bounds = QuantizePoints(_points.data(), _points.size(), _pointsQuantized, pool);
+      else
+        _bounds = QuantizePoints(reinterpret_cast<const VertexP4*>(pointData), numPoints, _pointsQuantized, pool);
+    }
+    else if (_quantized)
+    {
+      reservePayload(_pointsQuantizedColored, numPoints);
+      if (_voxelSize > 0.0f)
+        _bounds = QuantizePoints(_pointsColored.data(), _pointsColored.size(), _pointsQuantizedColored, pool);
+      else
+        _bounds = QuantizePoints(reinterpret_cast<const Vertex_PCL_PointXYZRGBA*>(pointData), numPoints, _pointsQuantizedColored, pool);
+    }
+    else if (_voxelSize > 0.0f)
+    {
+      // already filtered
+    }
+    else if (!_colored)
     {
       const auto* verts = reinterpret_cast<const VertexP4*>(pointData);
+      reservePayload(_points, numPoints);
       _points.assign(verts, verts + numPoints);
     }
     else
     {
-      const auto* verts = reinterpret_cast<const Vertex_PCL_PointXYZRGBA*>(pointData);
-      _pointsColored.assign(verts, verts + numPoints);
+      // repacked right away, so the render thread uploads 16 instead of 32 bytes per point
+      reservePayload(_pointsColored, numPoints);
+      IngestPoints(reinterpret_cast<const Vertex_PCL_PointXYZRGBA*>(pointData), numPoints, _pointsColored, pool);
     }
   }
 
+  // Zero-copy version, only passes the reference to <pointData> on to the point cloud.
+  // Only for clouds without colors, colored points are always converted first.
+  void init(Renderer* renderer, unsigned int handle, SharedPtr<const void> pointData, size_t numPoints, Color color, bool keepsHistory)
+  {
+    _renderer = renderer;
+    _handle = handle;
+    _keepsHistory = keepsHistory;
+    _colored = false;
+    _quantized = false;
+    _voxelSize = 0.0f;
+    _color = color;
+    _sharedPoints = std::move(pointData);
+    _numSharedPoints = numPoints;
+  }
+
   virtual void execute() override
   {
-    if (!_colored)
+    if (_voxelSize > 0.0f)
+      _renderer->_pointCloudRenderer.SetVoxelFilterStats(_handle, _voxelSize, _numInputPoints, numOutputPoints());
+
+    if (_sharedPoints != nullptr)
+      _renderer->_pointCloudRenderer.UpdatePointCloud(_handle, std::move(_sharedPoints), _numSharedPoints, _color);
+    else if (_quantized && !_colored)
+      _renderer->_pointCloudRenderer.UpdatePointCloud(_handle, _pointsQuantized, _bounds, _color);
+    else if (_quantized)
+      _renderer->_pointCloudRenderer.UpdatePointCloud(_handle, _pointsQuantizedColored, _bounds);
+    else if (!_colored)
       _renderer->_pointCloudRenderer.UpdatePointCloud(_handle, _points, _color);
     else
       _renderer->_pointCloudRenderer.UpdatePointCloud(_handle, _pointsColored);
   }
 
+  virtual void release() override
+  {
+    // don't keep caller-owned points alive while the command waits in the pool
+    _sharedPoints.reset();
+    _sharedInput.reset();
+    PooledRenderCommand::release();
+  }
+
+  virtual CoalesceType coalesceType() const override { return CoalesceType::PointCloud; }
+  virtual unsigned int coalesceHandle() const override { return _handle; }
+  // every update of a cloud with history is drawn as a frame of its own, see <HistoryPointCloud>
+  virtual bool supersedes() const override { return !_keepsHistory; }
+
+  virtual size_t payloadSize() const override
+  {
+    if (_sharedPoints != nullptr)
+      return _numSharedPoints * sizeof(VertexP4);
+
+    // not converted yet, see <initDeferred>
+    if (_sharedInput != nullptr)
+      return _numInputPoints * (_colored ? sizeof(Vertex_PCL_PointXYZRGBA) : sizeof(VertexP4));
+    if (!_input.empty())
+      return _input.size();
+
+    // the vectors which aren't used may still hold points from an earlier use of this command
+    if (_quantized)
+      return _colored ? _pointsQuantizedColored.size() * sizeof(VertexP3QC4) : _pointsQuantized.size() * sizeof(VertexP3Q);
+    return _colored ? _pointsColored.size() * sizeof(VertexP3RGBA) : _points.size() * sizeof(VertexP4);
+  }
+
+  size_t numOutputPoints() const
+  {
+    if (_quantized)
+      return _colored ? _pointsQuantizedColored.size() : _pointsQuantized.size();
+    return _colored ? _pointsColored.size() : _points.size();
+  }
+
+  virtual void discardPayload() override
+  {
+    Vector<VertexP4>().swap(_points);
+    Vector<VertexP3RGBA>().swap(_pointsColored);
+    Vector<VertexP3Q>().swap(_pointsQuantized);
+    Vector<VertexP3QC4>().swap(_pointsQuantizedColored);
+    Vector<unsigned char>().swap(_input);
+    _sharedPoints.reset();
+  }
+
   Renderer* _renderer;
   unsigned int _handle;
   Vector<VertexP4> _points;
-  Vector<Vertex_PCL_PointXYZRGBA> _pointsColored;
+  Vector<VertexP3RGBA> _pointsColored;
+  Vector<VertexP3Q> _pointsQuantized;
+  Vector<VertexP3QC4> _pointsQuantizedColored;
+  QuantizationBounds _bounds;
+  SharedPtr<const void> _sharedPoints; // used instead of the vectors if set
+  size_t _numSharedPoints = 0;
+  Vector<unsigned char> _input; // copy of the points to convert, see <initDeferred>
+  SharedPtr<const void> _sharedInput; // used instead of _input if set
   bool _colored;
+  bool _quantized;
+  float _voxelSize = 0.0f; // see <VoxelGridFilter>
+  size_t _numInputPoints = 0;
   Color _color;
+  bool _keepsHistory = false;
+};
+
+// Appends are never coalesced, every one of them adds points
+class Renderer::RenderCommandAppendPoints : public PooledRenderCommand<RenderCommandAppendPoints>
+{
+public:
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(Renderer* renderer, unsigned int handle, const void* pointData, size_t numPoints, bool colored, float voxelSize)
+  {
+    setup(renderer, handle, numPoints, colored, voxelSize);
+    convert(pointData);
+  }
+
+  // Deferred version, only copies the points, <convert> converts them later on the conversion thread
+  void initDeferred(Renderer* renderer, unsigned int handle, const void* pointData, size_t numPoints, bool colored, float voxelSize)
+  {
+    setup(renderer, handle, numPoints, colored, voxelSize);
+    const size_t numBytes = numPoints * (colored ? sizeof(Vertex_PCL_PointXYZRGBA) : sizeof(VertexP4));
+    reservePayload(_input, numBytes);
+    _input.assign(static_cast<const unsigned char*>(pointData), static_cast<const unsigned char*>(pointData) + numBytes);
+  }
+
+  // Converts the points kept by <initDeferred>
+  void convert()
+  {
+    convert(_input.data());
+    _input.clear();
+  }
+
+  void setup(Renderer* renderer, unsigned int handle, size_t numPoints, bool colored, float voxelSize)
+  {
+    _renderer = renderer;
+    _handle = handle;
+    _colored = colored;
+    _voxelSize = voxelSize;
+    _numInputPoints = numPoints;
+  }
+
+  void convert(const void* pointData)
+  {
+    const size_t numPoints = _numInputPoints;
+    WorkerPool* pool = &_renderer->_conversionPool;
+
+    // the rolling cloud swaps its drained queue into these vectors, so they are refilled in place
+    if (_voxelSize > 0.0f && !_colored)
+      VoxelGridFilter(reinterpret_cast<const VertexP4*>(pointData), numPoints, _voxelSize, _points, pool);
+    else if (_voxelSize > 0.0f)
+      VoxelGridFilter(reinterpret_cast<const Vertex_PCL_PointXYZRGBA*>(pointData), numPoints, _voxelSize, _pointsColored, pool);
+    else if (!_colored)
+    {
+      const auto* verts = reinterpret_cast<const VertexP4*>(pointData);
+      reservePayload(_points, numPoints);
+      _points.assign(verts, verts + numPoints);
+    }
+    else
+    {
+      reservePayload(_pointsColored, numPoints);
+      IngestPoints(reinterpret_cast<const Vertex_PCL_PointXYZRGBA*>(pointData), numPoints, _pointsColored, pool);
+    }
+  }
+
+  virtual void execute() override
+  {
+    if (_voxelSize > 0.0f)
+      _renderer->_pointCloudRenderer.SetVoxelFilterStats(_handle, _voxelSize, _numInputPoints, _colored ? _pointsColored.size() : _points.size());
+
+    if (!_colored)
+      _renderer->_pointCloudRenderer.AppendPoints(_handle, _points);
+    else
+      _renderer->_pointCloudRenderer.AppendPoints(_handle, _pointsColored);
+  }
+
+  virtual size_t payloadSize() const override
+  {
+    // not converted yet, see <initDeferred>
+    if (!_input.empty())
+      return _input.size();
+    return _colored ? _pointsColored.size() * sizeof(VertexP3RGBA) : _points.size() * sizeof(VertexP4);
+  }
+
+  virtual void discardPayload() override
+  {
+    Vector<VertexP4>().swap(_points);
+    Vector<VertexP3RGBA>().swap(_pointsColored);
+    Vector<unsigned char>().swap(_input);
+  }
+
+  Renderer* _renderer;
+  unsigned int _handle;
+  Vector<VertexP4> _points;
+  Vector<VertexP3RGBA> _pointsColored;
+  Vector<unsigned char> _input; // copy of the points to convert, see <initDeferred>
+  bool _colored;
+  float _voxelSize = 0.0f;
+  size_t _numInputPoints = 0;
 };
 
-class Renderer::RenderCommandDrawVoxels : public RenderCommand
+class Renderer::RenderCommandDrawVoxels : public PooledRenderCommand<RenderCommandDrawVoxels>
 {
 public:
-  RenderCommandDrawVoxels(Renderer* renderer, const Voxel* voxels, size_t numVoxels)
-    : _renderer(renderer)
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(Renderer* renderer, const Voxel* voxels, size_t numVoxels)
   {
+    _renderer = renderer;
+    reservePayload(_voxels, numVoxels);
     _voxels.assign(voxels, voxels + numVoxels);
   }
 
@@ -295,34 +737,114 @@ public:
     _renderer->_voxelRenderer.SetVoxels(_voxels);
   }
 
+  virtual CoalesceType coalesceType() const override { return CoalesceType::Voxels; }
+  virtual size_t payloadSize() const override { return _voxels.size() * sizeof(Voxel); }
+  virtual void discardPayload() override { Vector<Voxel>().swap(_voxels); }
+
   Renderer* _renderer;
   Vector<Voxel> _voxels;
 };
 
-class Renderer::RenderCommandSetVisibility : public RenderCommand
+class Renderer::RenderCommandSetVisibility : public PooledRenderCommand<RenderCommandSetVisibility>
 {
 public:
-  RenderCommandSetVisibility(Renderer* renderer, unsigned int handle, bool visible)
-    : _renderer(renderer), _handle(handle), _visible(visible)
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(Renderer* renderer, unsigned int handle, bool visible)
   {
+    _renderer = renderer;
+    _handle = handle;
+    _visible = visible;
   }
 
   virtual void execute() override
   {
-    _renderer->_visibilityMap[_handle] = _visible;
+    _renderer->_visibilityMap.Set(_handle, _visible);
+
+    // primitives are drawn all at once, so hidden ones are taken out of their instances
+    if (HandleTable::Type(_handle) == HandleType::Primitive)
+      _renderer->_primitiveRenderer.SetVisible(_handle, _visible);
   }
 
+  virtual CoalesceType coalesceType() const override { return CoalesceType::Visibility; }
+  virtual unsigned int coalesceHandle() const override { return _handle; }
+
   Renderer* _renderer;
   unsigned int _handle;
   bool _visible;
 };
 
+class Renderer::RenderCommandBatch : public PooledRenderCommand<RenderCommandBatch>
+{
+public:
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(Renderer* renderer)
+  {
+    _rendererId = renderer->_id;
+    _depth = 1;
+  }
+
+  virtual void execute() override
+  {
+    // the command queue normally flattens batches, so this only runs if a batch is executed directly
+    for (auto command : _commands)
+    {
+      command->execute();
+      command->release();
+    }
+    _commands.clear();
+  }
+
+  virtual size_t payloadSize() const override
+  {
+    size_t size = 0;
+    for (auto command : _commands)
+      size += command->payloadSize();
+    return size;
+  }
+
+  virtual void flatten(Vector<RenderCommand*>& commands) override
+  {
+    for (auto command : _commands)
+      command->flatten(commands);
+    _commands.clear();
+    release();
+  }
+
+  virtual void release() override
+  {
+    // only non-empty if the batch is discarded without being flattened
+    for (auto command : _commands)
+      command->release();
+    _commands.clear();
+    PooledRenderCommand::release();
+  }
+
+  uint64_t _rendererId;
+  int _depth;
+  Vector<RenderCommand*> _commands;
+};
+
 // used to synchronize between all active rendering threads to work around IMGUI not playing nice with threads
 std::mutex Renderer::_renderGUILock;
 
+std::atomic<uint64_t> Renderer::_nextId {1};
+
+thread_local Vector<Renderer::RenderCommandBatch*> Renderer::_openBatches;
+thread_local size_t Renderer::_openBatchesGeneration = 0;
+std::atomic<size_t> Renderer::_numDestroyedRenderers {0};
+std::mutex Renderer::_liveRenderersLock;
+std::unordered_set<uint64_t> Renderer::_liveRenderers;
+
 Renderer::Renderer(GLFWwindow* window)
-  : _running(false), _windowEvents(window), _imguiRenderer(window), _camera(_windowEvents)
+  : _id(_nextId++), _running(false), _windowEvents(window), _imguiRenderer(window), _camera(_windowEvents)
 {
+  {
+    MutexLockGuard guard(_liveRenderersLock);
+    _liveRenderers.insert(_id);
+  }
+
   _window = window;
   glfwGetWindowSize(window, &_windowWidth, &_windowHeight);
 
@@ -390,6 +912,22 @@ Renderer::~Renderer()
   {
     Stop();
   }
+
+  // discard the batch this thread never committed while its pool is still there,
+  // other threads drop theirs the next time they look at their open batches
+  Vector<RenderCommandBatch*>& batches = openBatches();
+  auto it = std::find_if(batches.begin(), batches.end(), [this](RenderCommandBatch* batch) { return batch->_rendererId == _id; });
+  if (it != batches.end())
+  {
+    (*it)->release();
+    batches.erase(it);
+  }
+
+  {
+    MutexLockGuard guard(_liveRenderersLock);
+    _liveRenderers.erase(_id);
+  }
+  _numDestroyedRenderers++;
 }
 
 void Renderer::Start()
@@ -399,6 +937,10 @@ void Renderer::Start()
     return;
   }
 
+  _abortConversions = false;
+  _conversionPool.Start();
+  _conversionThread.Start();
+
   _renderThread = std::thread([this]()
   {
     this->Init();
@@ -416,6 +958,15 @@ void Renderer::Stop()
   }
   _running = false;
   _renderThread.join();
+
+  // nobody is going to drain the queue anymore, so neither producers nor the conversion thread may wait for it,
+  // and conversions which are still pending are dropped
+  _renderCommandQueue.Close();
+  _abortConversions = true;
+  waitForConversions();
+  _conversionThread.Stop();
+  _conversionPool.Stop();
+
   WindowManager::Instance().DeleteRenderer(this, _window);
 }
 
@@ -424,16 +975,106 @@ bool Renderer::IsRunning()
   return _running;
 }
 
-void Renderer::NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels)
+bool Renderer::NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels)
 {
-  RenderCommandNotifyNewVideoFrame* command = new RenderCommandNotifyNewVideoFrame(this, width, height, pixels);
-  EnqueueRenderCommand(command);
+  RenderCommandNotifyNewVideoFrame* command = _videoFrameCommandPool.Acquire();
+  command->init(this, width, height, pixels);
+  return EnqueueRenderCommand(command);
 }
 
-void Renderer::NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels, float largefactor)
+bool Renderer::NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels, float largefactor)
 {
-  RenderCommandNotifyNewVideoFrame* command = new RenderCommandNotifyNewVideoFrame(this, width, height, pixels, largefactor);
-  EnqueueRenderCommand(command);
+  RenderCommandNotifyNewVideoFrame* command = _videoFrameCommandPool.Acquire();
+  command->init(this, width, height, pixels, largefactor);
+  return EnqueueRenderCommand(command);
+}
+
+bool Renderer::NotifyNewDepthFrame(unsigned int width, unsigned int height, const uint16_t* depth, const double camera_matrix[3][3], const unsigned char* rgb, float depthScale)
+{
+  RenderCommandNotifyNewDepthFrame* command = _depthFrameCommandPool.Acquire();
+  command->init(this, width, height, depth, rgb, DepthIntrinsics(camera_matrix, depthScale));
+  return EnqueueRenderCommand(command);
+}
+
+Vector<Renderer::RenderCommandBatch*>& Renderer::openBatches()
+{
+  // only look for batches of destroyed renderers if a renderer was destroyed since the last time
+  const size_t numDestroyedRenderers = _numDestroyedRenderers.load();
+  if (_openBatchesGeneration != numDestroyedRenderers && !_openBatches.empty())
+  {
+    MutexLockGuard guard(_liveRenderersLock);
+    for (size_t i = _openBatches.size(); i-- > 0; )
+    {
+      RenderCommandBatch* batch = _openBatches[i];
+      if (_liveRenderers.count(batch->_rendererId) > 0)
+        continue;
+
+      // the pools of the renderer are gone, so the batch and its commands can't be returned to them
+      for (auto command : batch->_commands)
+        delete command;
+      delete batch;
+      _openBatches.erase(_openBatches.begin() + i);
+    }
+  }
+  _openBatchesGeneration = numDestroyedRenderers;
+  return _openBatches;
+}
+
+Renderer::RenderCommandBatch* Renderer::openBatch()
+{
+  for (auto batch : openBatches())
+  {
+    if (batch->_rendererId == _id)
+      return batch;
+  }
+  return nullptr;
+}
+
+bool Renderer::EnqueueRenderCommand(RenderCommand* command)
+{
+  if (RenderCommandBatch* batch = openBatch())
+  {
+    batch->_commands.push_back(command);
+    return true;
+  }
+
+  return _renderCommandQueue.Enqueue(command);
+}
+
+void Renderer::BeginBatch()
+{
+  if (RenderCommandBatch* batch = openBatch())
+  {
+    batch->_depth++;
+    return;
+  }
+
+  RenderCommandBatch* batch = _batchCommandPool.Acquire();
+  batch->init(this);
+  openBatches().push_back(batch);
+}
+
+void Renderer::CommitBatch()
+{
+  Vector<RenderCommandBatch*>& batches = openBatches();
+  for (auto it = batches.begin(); it != batches.end(); ++it)
+  {
+    RenderCommandBatch* batch = *it;
+    if (batch->_rendererId != _id)
+      continue;
+
+    if (--batch->_depth > 0)
+      return;
+
+    batches.erase(it);
+    if (batch->_commands.empty())
+      batch->release();
+    else
+      _renderCommandQueue.Enqueue(batch);
+    return;
+  }
+
+  throw std::runtime_error("CommitBatch called without a matching BeginBatch");
 }
 
 void Renderer::SetCameraPose(glm::vec3 position, glm::vec3 forward, glm::vec3 up)
@@ -442,66 +1083,332 @@ void Renderer::SetCameraPose(glm::vec3 position, glm::vec3 forward, glm::vec3 up
   _camera.SetForwardAndUp(glm::normalize(forward), glm::normalize(up));
 }
 
-unsigned int Renderer::Add3DMesh(const Mesh3D& mesh, SharedPtr<Material> material)
+unsigned int Renderer::Add3DMesh(Mesh3D mesh, SharedPtr<Material> material)
 {
-  const unsigned int handle = GenerateMeshHandle();
+  const unsigned int handle = _handles.Allocate(HandleType::Mesh);
 
-  RenderCommandAddMesh<Vertex3D>* command = new RenderCommandAddMesh<Vertex3D>(this, handle, mesh, material);
+  RenderCommandAddMesh<Vertex3D>* command = new RenderCommandAddMesh<Vertex3D>(this, handle, std::move(mesh), material);
   EnqueueRenderCommand(command);
 
   return handle;
 }
 
-unsigned int Renderer::AddPointCloud(const void* pointData, size_t numPoints, bool colored, Color color)
+unsigned int Renderer::AddPrimitive(const Primitive& primitive)
 {
-  const unsigned int handle = GenerateMeshHandle();
-  RenderCommandAddPointCloud* command = new RenderCommandAddPointCloud(this, handle, pointData, numPoints, colored, color);
+  const unsigned int handle = _handles.Allocate(HandleType::Primitive);
+
+  RenderCommandSetPrimitive* command = _setPrimitiveCommandPool.Acquire();
+  command->init(this, handle, primitive, true);
   EnqueueRenderCommand(command);
+
   return handle;
 }
 
-unsigned int Renderer::AddLineMesh(const LineMesh& mesh, SharedPtr<Material> material)
+unsigned int Renderer::AddPointCloud(const void* pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options)
+{
+  return addPointCloud(pointData, numPoints, colored, color, options);
+}
+
+unsigned int Renderer::AddPointCloud(SharedPtr<const void> pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options)
 {
-  const unsigned int handle = GenerateMeshHandle();
+  // the update keeps the reference to <pointData> until its points were converted
+  return addPointCloud(std::move(pointData), numPoints, colored, color, options);
+}
 
-  RenderCommandAddLineMesh* command = new RenderCommandAddLineMesh(this, handle, mesh, material);
+template <typename PointsT>
+unsigned int Renderer::addPointCloud(PointsT pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options)
+{
+  PointCloudOptions cloudOptions = options;
+  cloudOptions.quantized = options.quantized && !options.lod;
+  if (cloudOptions.lod || cloudOptions.quantized)
+    cloudOptions.historyFrames = 0;
+  cloudOptions.capacity = 0;
+
+  PointCloudState state;
+  state.quantized = cloudOptions.quantized;
+  state.colored = colored;
+  state.voxelSize = cloudOptions.voxelSize;
+  state.historyFrames = cloudOptions.historyFrames;
+  const unsigned int handle = addPointCloudState(state);
+
+  // colored, filtered and quantized clouds start out empty, their points go through the update path which converts them
+  const bool converted = convertsPoints(state);
+  RenderCommandAddPointCloud* command = new RenderCommandAddPointCloud(this, handle, converted ? PointsT() : pointData, converted ? 0 : numPoints,
+                                                                       colored, color, cloudOptions);
   EnqueueRenderCommand(command);
 
+  if (converted)
+    UpdatePointCloud(handle, std::move(pointData), numPoints, colored, color);
   return handle;
 }
 
-void Renderer::UpdatePointCloud(unsigned int handle, const void* pointData, size_t numPoints, bool colored, Color color)
+unsigned int Renderer::AddRollingPointCloud(bool colored, Color color, const PointCloudOptions& options)
 {
-  RenderCommandUpdatePointCloud* command = new RenderCommandUpdatePointCloud(this, handle, pointData, numPoints, colored, color);
+  PointCloudState state;
+  state.colored = colored;
+  state.capacity = options.capacity;
+  state.voxelSize = options.voxelSize;
+  const unsigned int handle = addPointCloudState(state);
+
+  RenderCommandAddPointCloud* command = new RenderCommandAddPointCloud(this, handle, options.capacity, colored, color);
   EnqueueRenderCommand(command);
+  return handle;
 }
 
-void Renderer::UpdateMesh(unsigned int handle, const Mesh3D& mesh, SharedPtr<Material> material)
+unsigned int Renderer::addPointCloudState(const PointCloudState& state)
 {
-  if (handle == 0) { return; }
-  RenderCommandUpdateMesh* command = new RenderCommandUpdateMesh(this, handle, mesh, material);
-  EnqueueRenderCommand(command);
+  const unsigned int handle = _handles.Allocate(HandleType::PointCloud);
+
+  MutexLockGuard guard(_pointCloudStateLock);
+  _pointCloudStates[handle] = state;
+  return handle;
 }
 
-void Renderer::UpdateLineMesh(unsigned int handle, const LineMesh& mesh, SharedPtr<Material> material)
+Renderer::PointCloudState Renderer::pointCloudState(unsigned int handle)
 {
-  if (handle == 0) { return; }
-  RenderCommandUpdateLineMesh* command = new RenderCommandUpdateLineMesh(this, handle, mesh, material);
-  EnqueueRenderCommand(command);
+  MutexLockGuard guard(_pointCloudStateLock);
+  auto it = _pointCloudStates.find(handle);
+  return it != _pointCloudStates.end() ? it->second : PointCloudState();
 }
 
-void Renderer::UpdateTransform(unsigned int handle, const glm::mat4& transform, bool absolute)
+bool Renderer::convertsPoints(const PointCloudState& state)
 {
-  if (handle == 0) { return; }
-  RenderCommandUpdateTransform* command = new RenderCommandUpdateTransform(this, handle, transform, absolute);
-  EnqueueRenderCommand(command);
+  return state.colored || state.quantized || state.voxelSize > 0.0f;
+}
+
+bool Renderer::deferConversion(unsigned int handle, const PointCloudState& state)
+{
+  if (!convertsPoints(state))
+    return false;
+
+  if (openBatch())
+  {
+    // batched commands are converted right away to stay in their batch,
+    // they must not overtake the updates of the same cloud which are still being converted though
+    waitForConversions(handle);
+    return false;
+  }
+  return true;
 }
 
-void Renderer::SetVisibility(unsigned int handle, bool visible)
+template <typename CommandT>
+bool Renderer::submitConversion(CommandT* command, unsigned int handle, bool supersedes)
 {
-  if (handle == 0) { return; }
-  RenderCommandSetVisibility* command = new RenderCommandSetVisibility(this, handle, visible);
+  // the queue's policy applies to conversions as if they were queued already, so they can't pile up
+  if (!_renderCommandQueue.Admit(command))
+    return false;
+
+  {
+    MutexLockGuard guard(_conversionLock);
+    _numPendingConversions++;
+    _numPendingConversionsPerCloud[handle]++;
+  }
+
+  uint64_t serial = 0;
+  if (supersedes)
+  {
+    MutexLockGuard guard(_pointCloudStateLock);
+    auto it = _pointCloudStates.find(handle);
+    if (it != _pointCloudStates.end())
+      serial = ++it->second.latestConversion;
+  }
+
+  // one conversion after another on a single thread, so the commands of a cloud reach the queue in order
+  _conversionThread.Submit([this, command, handle, serial]()
+  {
+    bool superseded = false;
+    if (serial != 0)
+    {
+      // a newer update of the cloud is waiting already, or the cloud is gone
+      MutexLockGuard guard(_pointCloudStateLock);
+      auto it = _pointCloudStates.find(handle);
+      superseded = it == _pointCloudStates.end() || it->second.latestConversion != serial;
+    }
+
+    if (_abortConversions)
+    {
+      _renderCommandQueue.CancelAdmitted(command);
+    }
+    else if (superseded)
+    {
+      _renderCommandQueue.CancelAdmitted(command);
+      _numDroppedCommands++;
+    }
+    else
+    {
+      command->convert();
+      _renderCommandQueue.EnqueueAdmitted(command);
+    }
+
+    {
+      MutexLockGuard guard(_conversionLock);
+      _numPendingConversions--;
+      if (--_numPendingConversionsPerCloud[handle] == 0)
+        _numPendingConversionsPerCloud.erase(handle);
+    }
+    _conversionDone.notify_all();
+  });
+  return true;
+}
+
+void Renderer::waitForConversions()
+{
+  std::unique_lock<std::mutex> lock(_conversionLock);
+  _conversionDone.wait(lock, [this]() { return _numPendingConversions == 0; });
+}
+
+void Renderer::waitForConversions(unsigned int handle)
+{
+  std::unique_lock<std::mutex> lock(_conversionLock);
+  _conversionDone.wait(lock, [this, handle]() { return _numPendingConversionsPerCloud.count(handle) == 0; });
+}
+
+unsigned int Renderer::AddLineMesh(LineMesh mesh, SharedPtr<Material> material)
+{
+  const unsigned int handle = _handles.Allocate(HandleType::Line);
+
+  RenderCommandAddLineMesh* command = new RenderCommandAddLineMesh(this, handle, std::move(mesh), material);
   EnqueueRenderCommand(command);
+
+  return handle;
+}
+
+bool Renderer::UpdatePointCloud(unsigned int handle, const void* pointData, size_t numPoints, bool colored, Color color)
+{
+  // rolling clouds only take appended points, the render thread couldn't replace them
+  const PointCloudState state = pointCloudState(handle);
+  if (state.capacity > 0)
+    return false;
+
+  RenderCommandUpdatePointCloud* command = _updatePointCloudCommandPool.Acquire();
+  if (deferConversion(handle, state))
+  {
+    // the caller only waits for a copy of the points
+    command->initDeferred(this, handle, pointData, numPoints, colored, state.quantized, state.voxelSize, color, state.historyFrames > 0);
+    return submitConversion(command, handle, state.historyFrames == 0);
+  }
+
+  command->init(this, handle, pointData, numPoints, colored, state.quantized, state.voxelSize, color, state.historyFrames > 0);
+  return EnqueueRenderCommand(command);
+}
+
+bool Renderer::UpdatePointCloud(unsigned int handle, SharedPtr<const void> pointData, size_t numPoints, bool colored, Color color)
+{
+  const PointCloudState state = pointCloudState(handle);
+  if (state.capacity > 0)
+    return false;
+
+  // colored, quantized and filtered clouds need their points converted, which is a copy anyway
+  if (deferConversion(handle, state))
+  {
+    RenderCommandUpdatePointCloud* command = _updatePointCloudCommandPool.Acquire();
+    command->initDeferred(this, handle, std::move(pointData), numPoints, colored, state.quantized, state.voxelSize, color, state.historyFrames > 0);
+    return submitConversion(command, handle, state.historyFrames == 0);
+  }
+  else if (colored || convertsPoints(state))
+  {
+    return UpdatePointCloud(handle, pointData.get(), numPoints, colored, color);
+  }
+
+  RenderCommandUpdatePointCloud* command = _updatePointCloudCommandPool.Acquire();
+  command->init(this, handle, std::move(pointData), numPoints, color, state.historyFrames > 0);
+  return EnqueueRenderCommand(command);
+}
+
+bool Renderer::AppendPoints(unsigned int handle, const void* pointData, size_t numPoints)
+{
+  const PointCloudState state = pointCloudState(handle);
+  if (state.capacity == 0)
+    return false;
+
+  RenderCommandAppendPoints* command = _appendPointsCommandPool.Acquire();
+  if (deferConversion(handle, state))
+  {
+    // every append adds points, so none of them are skipped
+    command->initDeferred(this, handle, pointData, numPoints, state.colored, state.voxelSize);
+    return submitConversion(command, handle, false);
+  }
+
+  command->init(this, handle, pointData, numPoints, state.colored, state.voxelSize);
+  return EnqueueRenderCommand(command);
+}
+
+void* Renderer::AcquirePointCloudBuffer(unsigned int handle, size_t numPoints, bool colored)
+{
+  if (HandleTable::Type(handle) != HandleType::PointCloud) { return nullptr; }
+
+  SharedPtr<PointCloudStaging> staging;
+  {
+    MutexLockGuard guard(_pointCloudStateLock);
+    auto it = _pointCloudStates.find(handle);
+    if (it == _pointCloudStates.end())
+      return nullptr;
+
+    if (it->second.staging == nullptr)
+      it->second.staging = std::make_shared<PointCloudStaging>();
+    staging = it->second.staging;
+  }
+
+  const size_t vertexSize = colored ? sizeof(Vertex_PCL_PointXYZRGBA) : sizeof(VertexP4);
+  return staging->Acquire(numPoints * vertexSize, numPoints, colored);
+}
+
+bool Renderer::PublishPointCloudBuffer(unsigned int handle, Color color)
+{
+  SharedPtr<PointCloudStaging> staging;
+  {
+    MutexLockGuard guard(_pointCloudStateLock);
+    auto it = _pointCloudStates.find(handle);
+    if (it == _pointCloudStates.end() || it->second.staging == nullptr)
+      return false;
+    staging = it->second.staging;
+  }
+
+  size_t numPoints;
+  bool colored;
+  SharedPtr<const void> points = staging->Publish(numPoints, colored);
+  if (points == nullptr)
+    return false;
+
+  return UpdatePointCloud(handle, std::move(points), numPoints, colored, color);
+}
+
+bool Renderer::UpdateMesh(unsigned int handle, Mesh3D mesh, SharedPtr<Material> material)
+{
+  if (handle == 0) { return false; }
+  RenderCommandUpdateMesh* command = new RenderCommandUpdateMesh(this, handle, std::move(mesh), material);
+  return EnqueueRenderCommand(command);
+}
+
+bool Renderer::UpdatePrimitive(unsigned int handle, const Primitive& primitive)
+{
+  if (handle == 0) { return false; }
+  RenderCommandSetPrimitive* command = _setPrimitiveCommandPool.Acquire();
+  command->init(this, handle, primitive, false);
+  return EnqueueRenderCommand(command);
+}
+
+bool Renderer::UpdateLineMesh(unsigned int handle, LineMesh mesh, SharedPtr<Material> material)
+{
+  if (handle == 0) { return false; }
+  RenderCommandUpdateLineMesh* command = new RenderCommandUpdateLineMesh(this, handle, std::move(mesh), material);
+  return EnqueueRenderCommand(command);
+}
+
+bool Renderer::UpdateTransform(unsigned int handle, const glm::mat4& transform, bool absolute)
+{
+  if (handle == 0) { return false; }
+  RenderCommandUpdateTransform* command = _updateTransformCommandPool.Acquire();
+  command->init(this, handle, transform, absolute);
+  return EnqueueRenderCommand(command);
+}
+
+bool Renderer::SetVisibility(unsigned int handle, bool visible)
+{
+  if (handle == 0) { return false; }
+  RenderCommandSetVisibility* command = _setVisibilityCommandPool.Acquire();
+  command->init(this, handle, visible);
+  return EnqueueRenderCommand(command);
 }
 
 void Renderer::RemoveMesh(unsigned int handle)
@@ -523,15 +1430,6 @@ void Renderer::RemoveAllVoxels()
   EnqueueRenderCommand(command);
 }
 
-/// TODO: make this more robust
-/// Each mesh should get a unique ID we can use later to find it, even if
-/// the renderer has resorted the vector containing it.
-unsigned int Renderer::GenerateMeshHandle()
-{
-  static unsigned int nextID = 0;
-  return ++nextID;
-}
-
 void Renderer::Init()
 {
   // setup OpenGL context and open a window for rendering
@@ -546,8 +1444,10 @@ void Renderer::Init()
   _meshRenderer.SetDefaultShader(&_defaultShader);
   _videoRenderer.Init();
   _pointCloudRenderer.Init();
+  _depthFrameRenderer.Init();
   _voxelRenderer.Init();
   _lineRenderer.Init();
+  _primitiveRenderer.Init();
 
   _imguiRenderer.Init();
 
@@ -564,7 +1464,7 @@ void Renderer::Init_GL()
   glEnable(GL_CULL_FACE);
   glBlendEquation(GL_FUNC_ADD);
   glClearColor(0, 0, 0, 0);
-  glPointSize(5.0f);
+  GLStateCache::Get().SetPointSize(5.0f);
 }
 
 void Renderer::InitGUI()
@@ -646,36 +1546,30 @@ void Renderer::OnFramebufferResized(int newWidth, int newHeight)
 void Renderer::EnableRenderPass(RenderPassParams pass)
 {
   // Enable Depth if set, otherwise ensure it's disabled
-  if (pass & EnableDepth)
-  {
-    glEnable(GL_DEPTH_TEST);
-  }
-  else
-  {
-    glDisable(GL_DEPTH_TEST);
-  }
+  GLStateCache& state = GLStateCache::Get();
+  state.SetDepthTest((pass & EnableDepth) != 0);
 
   if (pass & Blend_Add)
   {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    state.SetBlend(true);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE);
   }
 
   if (pass & Blend_Mul)
   {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_DST_COLOR, GL_ZERO);
+    state.SetBlend(true);
+    state.BlendFunc(GL_DST_COLOR, GL_ZERO);
   }
 
   if (pass & Blend_Alpha)
   {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.SetBlend(true);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   }
 
   if (pass & Blend_None)
   {
-    glDisable(GL_BLEND);
+    state.SetBlend(false);
   }
 }
 
@@ -716,8 +1610,7 @@ void Renderer::HandleScreenshot()
 {
   if (_doScreenshot && (!_screenshotHideGUI || !_guiIsVisible))
   {
-    int vp[4];
-    glGetIntegerv(GL_VIEWPORT, vp);
+    const GLint* vp = GLStateCache::Get().Viewport();
     const int width = vp[2];
     const int height = vp[3];
 
@@ -765,14 +1658,15 @@ void Renderer::Update()
 
   _camera.Update(deltaTime);
 
-  // Execute all available render commands
-  const size_t numCommands = _renderCommandQueue.NumEnqueuedCommands();
-  for (size_t i = 0; i < numCommands; i++)
+  // Execute all available render commands, skipping updates which are overwritten later in the same frame
+  _renderCommandQueue.DequeueAll(_frameCommands);
+  _numDroppedCommands += _commandCoalescer.Coalesce(_frameCommands);
+  for (auto command : _frameCommands)
   {
-    auto command = _renderCommandQueue.Dequeue();
     command->execute();
-    delete command;
+    command->release();
   }
+  _frameCommands.clear();
 
   if (_newBackgroundColor)
   {
@@ -784,9 +1678,11 @@ void Renderer::Update()
   }
   _videoRenderer.Update();
   _pointCloudRenderer.Update();
+  _depthFrameRenderer.Update();
   _meshRenderer.Update();
   _voxelRenderer.Update();
   _lineRenderer.Update();
+  _primitiveRenderer.Update();
 }
 
 void Renderer::RenderOneFrame()
@@ -799,13 +1695,19 @@ void Renderer::RenderOneFrame()
   sceneInfo.nearClip = _camera._nearClip;
   sceneInfo.farClip = _camera._farClip;
   sceneInfo.aspect = _camera._aspect;
+  sceneInfo.viewportHeight = (float)_windowHeight;
   sceneInfo.visibilityMap = &_visibilityMap;
   sceneInfo.lightAlpha = _lightAlpha;
   sceneInfo.onlyOpaque = true;
 
-  glViewport(0, 0, _windowWidth, _windowHeight);
+  GLStateCache::Get().SetViewport(0, 0, _windowWidth, _windowHeight);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+  // every object is culled and sorted into the opaque or the transparent pass once, the passes only walk the results
+  _pointCloudRenderer.BuildRenderQueue(sceneInfo);
+  _meshRenderer.BuildRenderQueue(sceneInfo);
+  _lineRenderer.BuildRenderQueue(sceneInfo);
+
   // --- OPAQUE-Only Pass
 
   /*************
@@ -821,6 +1723,7 @@ void Renderer::RenderOneFrame()
   *************/
   EnableRenderPass(Blend_None | EnableDepth);
   _pointCloudRenderer.RenderPass(sceneInfo);
+  _depthFrameRenderer.RenderPass(sceneInfo);
 
   // Render voxels
   EnableRenderPass(Blend_None | EnableDepth);
@@ -832,6 +1735,7 @@ void Renderer::RenderOneFrame()
   *************/
   EnableRenderPass(_meshRenderPassParams);
   _meshRenderer.RenderPass(sceneInfo);
+  _primitiveRenderer.RenderPass(sceneInfo);
 
   EnableRenderPass(Blend_None | EnableDepth);
   _lineRenderer.RenderPass(sceneInfo);
@@ -851,6 +1755,7 @@ void Renderer::RenderOneFrame()
   *************/
   EnableRenderPass(Blend_None | EnableDepth);
   _pointCloudRenderer.RenderPass(sceneInfo);
+  _depthFrameRenderer.RenderPass(sceneInfo);
 
   // Render voxels
   EnableRenderPass(Blend_None | EnableDepth);
@@ -862,14 +1767,17 @@ void Renderer::RenderOneFrame()
   *************/
   EnableRenderPass(_meshRenderPassParams);
   _meshRenderer.RenderPass(sceneInfo);
+  _primitiveRenderer.RenderPass(sceneInfo);
 
   EnableRenderPass(Blend_None | EnableDepth);
   _lineRenderer.RenderPass(sceneInfo);
 
   // cleanup
   glBindTexture(GL_TEXTURE_2D, 0);
-  glUseProgram(0);
+  GLStateCache::Get().UseProgram(0);
+  GLStateCache::Get().EndFrame();
 
+  // the GUI restores the state it changes
   if (!_hideGUI)
   {
     // Render GUI last
@@ -897,6 +1805,7 @@ void Renderer::RenderGUI()
   _camera.RenderGUI();
 
   _pointCloudRenderer.RenderGUI();
+  _depthFrameRenderer.RenderGUI();
   _meshRenderer.RenderGUI();
   _videoRenderer.RenderGUI();
   _voxelRenderer.RenderGUI();
@@ -1038,6 +1947,20 @@ void Renderer::RenderStatsGUI(bool& opened)
     {
       ImGui::PushItemWidth(-100);
       ImGui::PlotLines("Frame time", values, bufferSize, offset, nullptr, 0.0f, 0.1f, ImVec2(0, 60));
+      ImGui::Text("Queued commands: %lu (%.1f MB)", (unsigned long)NumQueuedCommands(), NumQueuedBytes() / (1024.0 * 1024.0));
+      ImGui::Text("Dropped stale updates: %lu", (unsigned long)NumDroppedUpdates());
+      ImGui::Text("Rejected updates: %lu", (unsigned long)NumRejectedUpdates());
+      ImGui::Text("Command allocations: %lu (reused %lu)", (unsigned long)NumCommandAllocations(), (unsigned long)NumRecycledCommands());
+      ImGui::Text("Payload allocations: %lu", (unsigned long)NumPayloadAllocations());
+      ImGui::Text("GL state changes: %lu (skipped %lu)", (unsigned long)GLStateCache::Get().NumIssuedCalls(), (unsigned long)GLStateCache::Get().NumSkippedCalls());
+      ImGui::Text("Mesh draw calls: %lu (%lu meshes)", (unsigned long)_meshRenderer.NumDrawCalls(), (unsigned long)_meshRenderer.NumDrawnMeshes());
+      ImGui::Text("Primitive draw calls: %lu (%lu triangles)", (unsigned long)_primitiveRenderer.NumDrawCalls(), (unsigned long)_primitiveRenderer.NumTriangles());
+      ImGui::Text("Culled meshes: %lu (%lu drawn)", (unsigned long)_meshRenderer.NumCulledMeshes(),
+                  (unsigned long)(_meshRenderer.NumMeshes() - _meshRenderer.NumCulledMeshes()));
+      ImGui::Text("Culled lines: %lu (%lu drawn)", (unsigned long)_lineRenderer.NumCulledMeshes(),
+                  (unsigned long)(_lineRenderer.NumMeshes() - _lineRenderer.NumCulledMeshes()));
+      ImGui::Text("Culled point clouds: %lu (%lu drawn)", (unsigned long)_pointCloudRenderer.NumCulledPointClouds(),
+                  (unsigned long)(_pointCloudRenderer.NumPointClouds() - _pointCloudRenderer.NumCulledPointClouds()));
     }
     ImGui::End();
   }
@@ -1049,7 +1972,9 @@ void Renderer::Shutdown()
   _voxelRenderer.Release();
   _meshRenderer.Release();
   _pointCloudRenderer.Release();
+  _depthFrameRenderer.Release();
   _lineRenderer.Release();
+  _primitiveRenderer.Release();
 
   _imguiRenderer.Shutdown();
 
@@ -1058,10 +1983,36 @@ void Renderer::Shutdown()
   glfwMakeContextCurrent(nullptr); // unbind OpenGL context from this thread
 }
 
-void Renderer::DrawVoxels(const Voxel* voxels, size_t numVoxels)
+bool Renderer::DrawVoxels(const Voxel* voxels, size_t numVoxels)
 {
-  RenderCommandDrawVoxels* command = new RenderCommandDrawVoxels(this, voxels, numVoxels);
-  EnqueueRenderCommand(command);
+  RenderCommandDrawVoxels* command = _drawVoxelsCommandPool.Acquire();
+  command->init(this, voxels, numVoxels);
+  return EnqueueRenderCommand(command);
+}
+
+size_t Renderer::NumCommandAllocations() const
+{
+  return _updateTransformCommandPool.NumAllocated() + _updatePointCloudCommandPool.NumAllocated() +
+         _appendPointsCommandPool.NumAllocated() + _setVisibilityCommandPool.NumAllocated() +
+         _setPrimitiveCommandPool.NumAllocated() +
+         _drawVoxelsCommandPool.NumAllocated() + _videoFrameCommandPool.NumAllocated() +
+         _depthFrameCommandPool.NumAllocated() + _batchCommandPool.NumAllocated();
+}
+
+size_t Renderer::NumRecycledCommands() const
+{
+  return _updateTransformCommandPool.NumReused() + _updatePointCloudCommandPool.NumReused() +
+         _appendPointsCommandPool.NumReused() + _setVisibilityCommandPool.NumReused() +
+         _setPrimitiveCommandPool.NumReused() +
+         _drawVoxelsCommandPool.NumReused() + _videoFrameCommandPool.NumReused() +
+         _depthFrameCommandPool.NumReused() + _batchCommandPool.NumReused();
+}
+
+size_t Renderer::NumPayloadAllocations() const
+{
+  return _updatePointCloudCommandPool.NumPayloadAllocations() + _appendPointsCommandPool.NumPayloadAllocations() +
+         _drawVoxelsCommandPool.NumPayloadAllocations() + _videoFrameCommandPool.NumPayloadAllocations() +
+         _depthFrameCommandPool.NumPayloadAllocations();
 }
 
 bool Renderer::ProjectPointToNDC(const glm::vec3& point, glm::vec4& outProjected) const
@@ -1079,8 +2030,7 @@ bool Renderer::ProjectPointToPixel(const glm::vec3& point, glm::vec2& outPixel)
   if (!ProjectPointToNDC(point, pointNDC))
     return false;
 
-  int vp[4];
-  glGetIntegerv(GL_VIEWPORT, vp);
+  const GLint* vp = GLStateCache::Get().Viewport();
   const int width = vp[2];
   const int height = vp[3];
 
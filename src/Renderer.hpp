@@ -13,12 +13,16 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include <vector>
-#include <queue>
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
 #include <unordered_map>
+#include <unordered_set>
 #include "RenderPassParams.hpp"
+#include "CommandQueue.hpp"
+#include "CommandPool.hpp"
+#include "HandleTable.hpp"
 #include "ShaderSources.g.hpp"
 #include "ShaderProgram.hpp"
 #include "Material.hpp"
@@ -28,56 +32,25 @@
 #include "ImguiRenderer.hpp"
 #include "Camera.hpp"
 #include "geometry/Voxel.hpp"
+#include "geometry/PointCloudData.hpp"
 #include "common.hpp"
 
 #include "rendering/MeshRendering.hpp"
+#include "rendering/BatchedMeshRendering.hpp"
+#include "rendering/PrimitiveRendering.hpp"
 #include "rendering/VideoRendering.hpp"
+#include "rendering/DepthFrameRendering.hpp"
 #include "rendering/PointCloudRendering.hpp"
+#include "pointcloud/PointCloudStaging.hpp"
+#include "pointcloud/VoxelGridFilter.hpp"
+#include "WorkerPool.hpp"
+#include "WorkerThread.hpp"
 #include "rendering/VoxelRendering.hpp"
 #include "rendering/LineRendering.hpp"
 
 namespace ar
 {
 
-class RenderCommand
-{
-public:
-  virtual ~RenderCommand() { }
-
-  // this executes on the rendering thread
-  virtual void execute() = 0;
-};
-
-class CommandQueue
-{
-public:
-
-  void Enqueue(RenderCommand* renderCommand)
-  {
-    MutexLockGuard guard(_mutex);
-    _renderCommands.push(renderCommand);
-  }
-
-  RenderCommand* Dequeue()
-  {
-    MutexLockGuard guard(_mutex);
-    RenderCommand* last = _renderCommands.front();
-    _renderCommands.pop();
-    return last;
-  }
-
-  size_t NumEnqueuedCommands()
-  {
-    MutexLockGuard guard(_mutex);
-    return _renderCommands.size();
-  }
-
-private:
-
-  std::mutex _mutex;
-  std::queue<RenderCommand*> _renderCommands;
-};
-
 class Renderer
 {
 private:
@@ -87,14 +60,18 @@ private:
   class RenderCommandAddLineMesh;
   class RenderCommandUpdateTransform;
   class RenderCommandUpdateMesh;
+  class RenderCommandSetPrimitive;
   class RenderCommandUpdateLineMesh;
   class RenderCommandRemoveMesh;
   class RenderCommandRemoveAll;
   class RenderCommandNotifyNewVideoFrame;
+  class RenderCommandNotifyNewDepthFrame;
   class RenderCommandAddPointCloud;
   class RenderCommandUpdatePointCloud;
+  class RenderCommandAppendPoints;
   class RenderCommandDrawVoxels;
   class RenderCommandSetVisibility;
+  class RenderCommandBatch;
 
 public:
   // Constructor
@@ -119,14 +96,29 @@ public:
   // @width  Width, in pixels, of the image
   // @height Height, in pixels, of the image
   // @pixels Image data, ordered [r,g,b,r,g,b,...]
-  void NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels); // TODO: determine if any other pixel formats need to be supported
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels); // TODO: determine if any other pixel formats need to be supported
 
   // Updates video texture with (RGB24) data in pixels, but starts a larger screen
   // @width  width, in pixels, of the image
   // @height height, in pixles, of the image
   // @pixels image data
   // @largefactor how much bigger should the width be
-  void NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels, float largefactor); // TODO: determine if any other pixel formats need to be supported
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool NotifyNewVideoFrame(unsigned int width, unsigned int height, const unsigned char* pixels, float largefactor); // TODO: determine if any other pixel formats need to be supported
+
+  // Replaces the depth frame drawn as a point cloud, see <DepthFrameRenderer>
+  // @width         Width, in pixels, of the image
+  // @height        Height, in pixels, of the image
+  // @depth         Depth values, 0 where there is no measurement
+  // @camera_matrix 3x3 Camera Intrinsic matrix of the depth sensor
+  // @rgb           RGB24 image registered to the depth image, may be nullptr
+  // @depthScale    Meters per depth unit
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool NotifyNewDepthFrame(unsigned int width, unsigned int height, const uint16_t* depth, const double camera_matrix[3][3], const unsigned char* rgb, float depthScale);
 
   // Updates camera parameters with the given values
   // @position New camera position
@@ -135,55 +127,131 @@ public:
   void SetCameraPose(glm::vec3 position, glm::vec3 forward, glm::vec3 up);
 
   // Adds a new mesh to the scene
-  // @mesh     The mesh to add
+  // @mesh     The mesh to add, moved into the render command when passed as a temporary
   // @material The material to apply to the mesh
   //
   // @return   An <ar::mesh_handle> for <mesh>
-  unsigned int Add3DMesh(const Mesh3D& mesh, SharedPtr<Material> material);
+  unsigned int Add3DMesh(Mesh3D mesh, SharedPtr<Material> material);
+
+  // Adds a sphere, box, capsule or ellipsoid to the scene, see <PrimitiveRenderer>
+  // @primitive The shape, transform and color of the new object
+  //
+  // @return    An <ar::mesh_handle> for the new object
+  unsigned int AddPrimitive(const Primitive& primitive);
 
   // Adds a new pointcloud to the scene
   // @pointData Pointcloud vertex data
   // @numPoints Number of points in <pointData>
   // @color     A constant color to apply to the cloud
+  // @options   How the cloud is stored and drawn, <PointCloudOptions::capacity> is ignored, see <AddRollingPointCloud>
   //
   // @return    An <ar::mesh_handle> for the new <PointCloud>
-  unsigned int AddPointCloud(const void* pointData, size_t numPoints, bool colored,  Color color);
+  unsigned int AddPointCloud(const void* pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options = PointCloudOptions());
+
+  // Adds a new pointcloud to the scene without copying its points
+  // @pointData Pointcloud vertex data, read on the render thread and released once it was uploaded to the GPU
+  //           Filtered clouds copy the points right away.
+  //
+  // @return    An <ar::mesh_handle> for the new <PointCloud>
+  unsigned int AddPointCloud(SharedPtr<const void> pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options = PointCloudOptions());
+
+  // Adds a new, empty <RollingPointCloud> to the scene, its points are added with <AppendPoints>
+  // @color    A constant color to apply to the cloud
+  // @options  <PointCloudOptions::capacity> is the maximum number of points in the cloud, the oldest points are replaced
+  //           once it is full. <PointCloudOptions::voxelSize> downsamples every batch of appended points, the other options are ignored.
+  //
+  // @return   An <ar::mesh_handle> for the new <RollingPointCloud>
+  unsigned int AddRollingPointCloud(bool colored, Color color, const PointCloudOptions& options);
 
   // Updates an existing <LineMesh>
   // @handle   Handle referencing the mesh to update
   // @mesh     New mesh data to replace the old mesh with
   // @material <Material> to apply to the new mesh
-  unsigned int AddLineMesh(const LineMesh& mesh, SharedPtr<Material> material);
+  unsigned int AddLineMesh(LineMesh mesh, SharedPtr<Material> material);
 
   // Updates an existing <PointCloud>
   // @handle    Handle referencing the cloud to update
   // @pointData New vertex data to replace the existing points with
   // @numPoints Number of points in <pointData>
   // @color     New color to apply to the cloud
-  void UpdatePointCloud(unsigned int handle, const void* pointData, size_t numPoints, bool colored, Color color);
+  //
+  // Colored, filtered and quantized clouds only copy <pointData> here, their points are converted on the conversion thread
+  // which then sends the update to the render thread. An update is skipped if a newer one arrives before its conversion started.
+  // The queue's budget counts updates from the moment they are handed to the conversion thread.
+  //
+  // @return False if <handle> is a <RollingPointCloud>, use <AppendPoints> for those,
+  //         or if the update was rejected, see <QueuePolicy::Reject>
+  bool UpdatePointCloud(unsigned int handle, const void* pointData, size_t numPoints, bool colored, Color color);
+
+  // Updates an existing <PointCloud> without copying the points
+  // @pointData Pointcloud vertex data, read on the render thread and released once it was uploaded to the GPU.
+  //            Colored, filtered and quantized clouds read it on the conversion thread and release it once it was converted.
+  //
+  // @return False if <handle> is a <RollingPointCloud>, or if the update was rejected, see <QueuePolicy::Reject>
+  //         and the first overload for converted updates.
+  bool UpdatePointCloud(unsigned int handle, SharedPtr<const void> pointData, size_t numPoints, bool colored, Color color);
+
+  // Adds points to an existing <RollingPointCloud>, only these points are uploaded to the GPU
+  // @handle    Handle referencing the cloud to add the points to
+  // @pointData Vertex data of the new points, in the format the cloud was added with
+  // @numPoints Number of points in <pointData>
+  //
+  // Colored and filtered clouds convert the points on the conversion thread, see <UpdatePointCloud>. Appends are never skipped.
+  //
+  // @return False if <handle> is not a rolling cloud, or if the update was rejected
+  bool AppendPoints(unsigned int handle, const void* pointData, size_t numPoints);
+
+  // Gets a buffer the next points of an existing <PointCloud> can be written into, see <PointCloudStaging>
+  // @handle    Handle referencing the cloud to update
+  // @numPoints Number of points which will be written to the buffer
+  //
+  // @return    nullptr if all of the cloud's buffers are in use
+  void* AcquirePointCloudBuffer(unsigned int handle, size_t numPoints, bool colored);
+
+  // Replaces the points of an existing <PointCloud> with the buffer returned by <AcquirePointCloudBuffer>
+  // @handle Handle referencing the cloud to update
+  // @color  New color to apply to the cloud
+  //
+  // @return False if no buffer was acquired, or if the update was rejected
+  bool PublishPointCloudBuffer(unsigned int handle, Color color);
 
   // Updates an existing <Mesh3D>
   // @handle   Handle referencing the mesh to update
   // @mesh     New mesh data to replace the old mesh with
   // @material <Material> to apply to the new mesh
-  void UpdateMesh(unsigned int handle, const Mesh3D& mesh, SharedPtr<Material> material);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool UpdateMesh(unsigned int handle, Mesh3D mesh, SharedPtr<Material> material);
+
+  // Replaces an existing primitive, which may change its shape
+  // @handle    Handle returned by <AddPrimitive>
+  // @primitive The new shape, transform and color of the object
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool UpdatePrimitive(unsigned int handle, const Primitive& primitive);
 
   // Updates an existing <LineMesh>
   // @handle   Handle referencing the mesh to update
   // @mesh     New mesh data to replace the old mesh with
   // @material <Material> to apply to the new mesh
-  void UpdateLineMesh(unsigned int handle, const LineMesh& mesh, SharedPtr<Material> material);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool UpdateLineMesh(unsigned int handle, LineMesh mesh, SharedPtr<Material> material);
 
   // Transforms an existing mesh object
   // @handle    Handle referencing the object to transform
   // @transform Transformation matrix to apply to the object
   // @absolute  If False, transformation is applied relative to the object's current transformation.
   //            If True, transformation replaces the object's current transformation.
-  void UpdateTransform(unsigned int handle, const glm::mat4& transform, bool absolute);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool UpdateTransform(unsigned int handle, const glm::mat4& transform, bool absolute);
 
   // Sets the visibility of an object
   // @visible True if the object should be visible
-  void SetVisibility(unsigned int handle, bool visible);
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool SetVisibility(unsigned int handle, bool visible);
 
   // Removes an existing mesh from the scene
   // @handle Handle referencing the mesh to remove
@@ -194,7 +262,10 @@ public:
 
   void RemoveAllVoxels();
 
-  void DrawVoxels(const Voxel* voxels, size_t numVoxels);
+  // Replaces all voxels in the scene
+  //
+  // @return False if the update was rejected, see <QueuePolicy::Reject>
+  bool DrawVoxels(const Voxel* voxels, size_t numVoxels);
 
   // Gets the View matrix
   glm::mat4 GetViewMatrix() const
@@ -217,10 +288,44 @@ public:
 
   Delegate<void()> _renderGUIDelegate;
 
-  inline void EnqueueRenderCommand(RenderCommand* command)
-  {
-    _renderCommandQueue.Enqueue(command);
-  }
+  // Sends a command to the render thread, or adds it to the calling thread's open batch
+  // @return False if the queue rejected the command
+  bool EnqueueRenderCommand(RenderCommand* command);
+
+  // Starts collecting all commands issued by the calling thread into a batch instead of sending them right away.
+  // Batches can be nested, only the outermost CommitBatch publishes the commands.
+  void BeginBatch();
+
+  // Sends all commands collected since BeginBatch to the render thread at once.
+  // The render thread executes all of them within the same frame.
+  void CommitBatch();
+
+  // Limits the commands waiting for the render thread, see <QueueBudget>
+  void SetQueueBudget(const QueueBudget& budget) { _renderCommandQueue.SetBudget(budget); }
+
+  // Limits the points drawn from LOD clouds per frame
+  void SetPointCloudLodBudget(size_t numPoints) { _pointCloudRenderer.SetLodPointBudget(numPoints); }
+
+  // Sets when spheres, capsules and ellipsoids switch between their levels of detail
+  void SetPrimitiveLodThresholds(const LodThresholds& thresholds) { _primitiveRenderer.SetLodThresholds(thresholds); }
+
+  size_t NumQueuedCommands() const { return _renderCommandQueue.NumEnqueuedCommands(); }
+  size_t NumQueuedBytes() const { return _renderCommandQueue.NumEnqueuedBytes(); }
+
+  // Number of updates which were discarded without being executed because a newer update
+  // for the same object arrived before the render thread (or the conversion thread) got to them
+  size_t NumDroppedUpdates() const { return _numDroppedCommands + _renderCommandQueue.NumDroppedCommands(); }
+
+  // Number of updates which were rejected because the queue was over budget
+  size_t NumRejectedUpdates() const { return _renderCommandQueue.NumRejectedCommands(); }
+
+  // Number of commands allocated on the heap, and number of commands which were recycled instead.
+  // Once streaming reaches a steady state only the latter should grow.
+  size_t NumCommandAllocations() const;
+  size_t NumRecycledCommands() const;
+
+  // Number of times the payload (points, voxels, video frame) of a recycled command had to grow
+  size_t NumPayloadAllocations() const;
 
   // Project a point into NDC.
   // @return false if the point is behind the near plane, true otherwise.
@@ -234,7 +339,42 @@ private:
 
   friend class ARVisualizer;
 
+  // streaming updates are recycled through these pools instead of allocating every command
+  // (declared before _renderCommandQueue, which releases leftover commands when it is destroyed)
+  RenderCommandPool<RenderCommandUpdateTransform> _updateTransformCommandPool;
+  RenderCommandPool<RenderCommandUpdatePointCloud> _updatePointCloudCommandPool {16};
+  RenderCommandPool<RenderCommandAppendPoints> _appendPointsCommandPool {16};
+  RenderCommandPool<RenderCommandSetVisibility> _setVisibilityCommandPool;
+  RenderCommandPool<RenderCommandSetPrimitive> _setPrimitiveCommandPool;
+  RenderCommandPool<RenderCommandDrawVoxels> _drawVoxelsCommandPool {16};
+  RenderCommandPool<RenderCommandNotifyNewVideoFrame> _videoFrameCommandPool {16};
+  RenderCommandPool<RenderCommandNotifyNewDepthFrame> _depthFrameCommandPool {16};
+  RenderCommandPool<RenderCommandBatch> _batchCommandPool {16};
+
+  // identifies this renderer's batches, unlike its address it is never reused by another renderer
+  const uint64_t _id;
+  static std::atomic<uint64_t> _nextId;
+
+  // batches which were started but not committed yet on the current thread (at most one per renderer)
+  // use <openBatches>, it drops the batches of renderers which were destroyed in the meantime
+  static thread_local Vector<RenderCommandBatch*> _openBatches;
+  // value of _numDestroyedRenderers when the current thread last looked for batches of destroyed renderers
+  static thread_local size_t _openBatchesGeneration;
+  static std::atomic<size_t> _numDestroyedRenderers;
+  static std::mutex _liveRenderersLock;
+  static std::unordered_set<uint64_t> _liveRenderers;
+
+  // @return The open batches of the current thread, without the ones of destroyed renderers
+  static Vector<RenderCommandBatch*>& openBatches();
+  // @return This renderer's open batch on the current thread, nullptr if there is none
+  RenderCommandBatch* openBatch();
+
   CommandQueue _renderCommandQueue;
+  // commands taken from _renderCommandQueue during the current frame
+  Vector<RenderCommand*> _frameCommands;
+  CommandCoalescer _commandCoalescer;
+  // number of commands which were never executed because a newer command replaced them
+  std::atomic<size_t> _numDroppedCommands {0};
 
   std::atomic_bool _running;
   double _lastFrameTime = 0;
@@ -246,11 +386,64 @@ private:
   GLFWwindow* _window;
   int _windowWidth, _windowHeight;
 
-  std::unordered_map<unsigned int, bool> _visibilityMap;
+  // hands out the handles for all objects added to this renderer
+  HandleTable _handles;
+
+  HandleMap<bool> _visibilityMap;
 
-  MeshRenderer<Vertex3D> _meshRenderer;
+  // what the calling threads need to know about every point cloud, added with the cloud
+  struct PointCloudState
+  {
+    bool quantized = false;
+    bool colored = false;
+    size_t capacity = 0; // set for rolling clouds
+    float voxelSize = 0.0f; // set for clouds which are downsampled before they are sent to the render thread
+    unsigned int historyFrames = 0; // set for clouds which keep their updates, none of them may be skipped
+    SharedPtr<PointCloudStaging> staging; // created by the first AcquirePointCloudBuffer
+    uint64_t latestConversion = 0; // newest update handed to the conversion thread, see <submitConversion>
+  };
+
+  std::mutex _pointCloudStateLock;
+  std::unordered_map<unsigned int, PointCloudState> _pointCloudStates;
+
+  // Adds a cloud for both kinds of <pointData>, the points are converted by the first update if the cloud needs that
+  template <typename PointsT>
+  unsigned int addPointCloud(PointsT pointData, size_t numPoints, bool colored, Color color, const PointCloudOptions& options);
+  // Allocates the handle of a new point cloud and registers its state
+  unsigned int addPointCloudState(const PointCloudState& state);
+  // @return The state of the cloud for <handle>, a default state if there is none
+  PointCloudState pointCloudState(unsigned int handle);
+
+  // @return True for clouds whose points are repacked, filtered or quantized in Add and Update
+  static bool convertsPoints(const PointCloudState& state);
+  // @return True if the points of an update should be converted on the conversion thread instead of the calling one
+  // Inside a batch the conversion runs on the calling thread, after the pending conversions of the same cloud.
+  bool deferConversion(unsigned int handle, const PointCloudState& state);
+  // Converts the points of <command> on the conversion thread, then hands the command to the render queue.
+  // @supersedes Set for commands which replace all points of the cloud, they are skipped if a newer one is submitted meanwhile
+  // @return False if the queue's policy rejected the command, see <CommandQueue::Admit>
+  template <typename CommandT>
+  bool submitConversion(CommandT* command, unsigned int handle, bool supersedes);
+  // Blocks until all submitted conversions are done
+  void waitForConversions();
+  // Blocks until the submitted conversions of the cloud for <handle> are done
+  void waitForConversions(unsigned int handle);
+
+  // splits up conversions of large clouds, like <VoxelGridFilter>
+  WorkerPool _conversionPool;
+  // converts the points of colored, filtered and quantized clouds, so the calling threads only hand them over
+  WorkerThread _conversionThread;
+  std::mutex _conversionLock;
+  std::condition_variable _conversionDone;
+  size_t _numPendingConversions = 0;
+  std::unordered_map<unsigned int, size_t> _numPendingConversionsPerCloud;
+  std::atomic<bool> _abortConversions {false}; // set by <Stop>, pending conversions are dropped
+
+  BatchedMeshRenderer _meshRenderer;
   LineRenderer _lineRenderer;
+  PrimitiveRenderer _primitiveRenderer;
   VideoRenderer _videoRenderer;
+  DepthFrameRenderer _depthFrameRenderer;
   PointCloudRenderer _pointCloudRenderer;
   VoxelRenderer _voxelRenderer;
   ImguiRenderer _imguiRenderer;
@@ -303,9 +496,6 @@ private:
   bool _guiIsVisible = true;
 
 
-  // Generates a unique ID used to reference meshes from external components
-  unsigned int GenerateMeshHandle();
-
   // ! Call from _renderThread only
   // Updates projection as needed when the window changes size
   void OnWindowResized(int newWidth, int newHeight);
@@ -9,6 +9,7 @@
 #include <vector>
 #include "common.hpp"
 #include "LoadShaders.hpp"
+#include "rendering/GLStateCache.hpp"
 
 namespace ar
 {
@@ -81,7 +82,7 @@ class ShaderProgram
     // free all the resources it's been using
     void destroy()
     {
-      glDeleteProgram(programId);
+      GLStateCache::Get().DeleteProgram(programId);
 
       programId = 0;
       shaderCount = 0;
@@ -95,7 +96,7 @@ class ShaderProgram
       // delete old shader program if we have one
       if (shaderCount > 0 && programId > 0)
       {
-        glDeleteProgram(programId);
+        GLStateCache::Get().DeleteProgram(programId);
       }
 
       // load new shaders
@@ -112,14 +113,14 @@ class ShaderProgram
     // Method to enable the shader program
     void enable()
     {
-      glUseProgram(programId);
+      GLStateCache::Get().UseProgram(programId);
     }
 
 
     // Method to disable the shader program
     void disable()
     {
-      glUseProgram(0);
+      GLStateCache::Get().UseProgram(0);
     }
 
 
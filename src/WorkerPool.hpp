@@ -0,0 +1,196 @@
+#ifndef _AR_WORKERPOOL_HPP
+#define _AR_WORKERPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include "common.hpp"
+
+namespace ar
+{
+
+/*
+ * Threads which split up work of the calling threads, for conversions of large point clouds.
+ * <ParallelFor> hands out ranges of a job to the pool and works on them on the calling thread as well,
+ * so a job finishes even if the pool is busy or wasn't started.
+ * Jobs must not touch OpenGL.
+ */
+class WorkerPool
+{
+public:
+
+  WorkerPool() = default;
+
+  ~WorkerPool()
+  {
+    Stop();
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // One thread less than the CPU has cores, the calling thread works on its jobs as well
+  static unsigned int DefaultNumThreads()
+  {
+    const unsigned int numCores = std::thread::hardware_concurrency();
+    return numCores > 1 ? numCores - 1 : 1;
+  }
+
+  void Start(unsigned int numThreads = DefaultNumThreads())
+  {
+    MutexLockGuard guard(_mutex);
+    if (_running)
+      return;
+
+    _running = true;
+    for (unsigned int i = 0; i < numThreads; i++)
+      _threads.emplace_back(&WorkerPool::run, this);
+    _numThreads = numThreads;
+  }
+
+  // Waits for the threads to finish the ranges they are working on, callers of <ParallelFor> do the rest
+  void Stop()
+  {
+    {
+      MutexLockGuard guard(_mutex);
+      if (!_running)
+        return;
+
+      _running = false;
+      _jobs.clear();
+    }
+
+    _jobAvailable.notify_all();
+    for (auto& thread : _threads)
+      thread.join();
+    _threads.clear();
+    _numThreads = 0;
+  }
+
+  // Number of threads besides the calling one which can work on a job
+  unsigned int NumThreads() const { return _numThreads; }
+
+  // Calls <fn> for every index in [0, numRanges), spread over the pool and the calling thread.
+  // Returns once all ranges are done. Can be called from any thread, also from several at once.
+  void ParallelFor(size_t numRanges, const std::function<void(size_t)>& fn)
+  {
+    if (numRanges == 0)
+      return;
+
+    SharedPtr<Job> job = std::make_shared<Job>(fn, numRanges);
+    if (numRanges > 1)
+    {
+      {
+        MutexLockGuard guard(_mutex);
+        if (_running)
+          _jobs.push_back(job);
+      }
+      _jobAvailable.notify_all();
+    }
+
+    job->Work();
+
+    {
+      // all ranges are taken, don't let the threads pick up the job anymore
+      MutexLockGuard guard(_mutex);
+      auto it = std::find(_jobs.begin(), _jobs.end(), job);
+      if (it != _jobs.end())
+        _jobs.erase(it);
+    }
+
+    // ranges taken by the threads may still be running
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() { return job->numDone == job->numRanges; });
+  }
+
+private:
+
+  struct Job
+  {
+    Job(const std::function<void(size_t)>& fn, size_t numRanges)
+      : fn(fn), numRanges(numRanges)
+    { }
+
+    // Runs ranges until all of them are taken
+    void Work()
+    {
+      size_t range;
+      while ((range = nextRange++) < numRanges)
+      {
+        fn(range);
+
+        MutexLockGuard guard(mutex);
+        if (++numDone == numRanges)
+          finished.notify_all();
+      }
+    }
+
+    bool Exhausted() const { return nextRange >= numRanges; }
+
+    const std::function<void(size_t)>& fn; // owned by the caller, which waits until all ranges are done
+    const size_t numRanges;
+    std::atomic<size_t> nextRange {0};
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t numDone = 0;
+  };
+
+  void run()
+  {
+    for (;;)
+    {
+      SharedPtr<Job> job;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _jobAvailable.wait(lock, [this]() { return !_running || !_jobs.empty(); });
+        if (!_running)
+          return;
+
+        job = _jobs.front();
+        if (job->Exhausted())
+        {
+          _jobs.pop_front();
+          continue;
+        }
+      }
+
+      job->Work();
+    }
+  }
+
+  Vector<std::thread> _threads;
+  std::atomic<unsigned int> _numThreads {0};
+  std::mutex _mutex;
+  std::condition_variable _jobAvailable;
+  std::deque<SharedPtr<Job>> _jobs;
+  bool _running = false;
+};
+
+// Splits [0, numItems) into ranges of <rangeSize> items and calls <fn>(range, begin, end) for each of them,
+// spread over <pool> and the calling thread, or on the calling thread alone if <pool> is nullptr
+inline void ParallelForRanges(WorkerPool* pool, size_t numItems, size_t rangeSize, const std::function<void(size_t, size_t, size_t)>& fn)
+{
+  const size_t numRanges = (numItems + rangeSize - 1) / rangeSize;
+  auto runRange = [&](size_t range)
+  {
+    fn(range, range * rangeSize, std::min((range + 1) * rangeSize, numItems));
+  };
+
+  if (pool != nullptr)
+  {
+    pool->ParallelFor(numRanges, runRange);
+  }
+  else
+  {
+    for (size_t range = 0; range < numRanges; range++)
+      runRange(range);
+  }
+}
+
+} // namespace ar
+
+#endif // _AR_WORKERPOOL_HPP
@@ -0,0 +1,99 @@
+#ifndef _AR_WORKERTHREAD_HPP
+#define _AR_WORKERTHREAD_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include "common.hpp"
+
+namespace ar
+{
+
+/*
+ * Runs jobs one after another on a background thread, for work which would stall the render thread.
+ * Jobs must not touch OpenGL; they hand their results to the render thread themselves.
+ */
+class WorkerThread
+{
+public:
+
+  typedef std::function<void()> Job;
+
+  WorkerThread() = default;
+
+  ~WorkerThread()
+  {
+    Stop();
+  }
+
+  WorkerThread(const WorkerThread&) = delete;
+  WorkerThread& operator=(const WorkerThread&) = delete;
+
+  void Start()
+  {
+    MutexLockGuard guard(_mutex);
+    if (_running)
+      return;
+
+    _running = true;
+    _thread = std::thread(&WorkerThread::run, this);
+  }
+
+  // Waits for the running job to finish, pending jobs are discarded
+  void Stop()
+  {
+    {
+      MutexLockGuard guard(_mutex);
+      if (!_running)
+        return;
+
+      _running = false;
+      _jobs.clear();
+    }
+
+    _jobAvailable.notify_one();
+    _thread.join();
+  }
+
+  // Queues <job> to run after all previously submitted jobs, can be called from any thread
+  void Submit(Job job)
+  {
+    {
+      MutexLockGuard guard(_mutex);
+      _jobs.push_back(std::move(job));
+    }
+    _jobAvailable.notify_one();
+  }
+
+private:
+
+  void run()
+  {
+    for (;;)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _jobAvailable.wait(lock, [this]() { return !_running || !_jobs.empty(); });
+        if (!_running)
+          return;
+
+        job = std::move(_jobs.front());
+        _jobs.pop_front();
+      }
+
+      job();
+    }
+  }
+
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _jobAvailable;
+  std::deque<Job> _jobs;
+  bool _running = false;
+};
+
+} // namespace ar
+
+#endif // _AR_WORKERTHREAD_HPP
@@ -2,6 +2,7 @@
 #define _ARPOINTCLOUDDATA_H
 
 #include "Color.hpp"
+#include <memory>
 
 namespace ar
 {
@@ -11,12 +12,56 @@ namespace ar
     PCL_PointXYZRGBA
   };
 
+  // How a point cloud is stored and drawn, passed to <ARVisualizer::Add> and fixed for the lifetime of the cloud
+  struct PointCloudOptions
+  {
+    // Set for clouds which are replaced (nearly) every frame. Their points are then uploaded into a ring of
+    // GPU buffers instead of reallocating the cloud's buffer on every update.
+    bool streaming = false;
+
+    // Set for very large clouds, like accumulated maps. They are drawn from an octree which is built in the background,
+    // only showing as much detail as needed from the current view and <ARVisualizer::SetPointBudget> allows.
+    bool lod = false;
+
+    // Set to store the points in a compact format: positions are quantized to 16 bits per axis within the bounding box
+    // of the cloud, and the padding of the PCL formats is dropped. This takes 2-4 times less GPU memory and upload
+    // bandwidth, the conversion happens on a conversion thread after Add and Update. Points with invalid (NaN) positions
+    // are dropped. Ignored for LOD clouds.
+    bool quantized = false;
+
+    // Set to make a rolling cloud holding at most this many points, like a sliding window of a map.
+    // Its points are added with <ARVisualizer::AppendPoints>, only the new points are uploaded and the oldest
+    // ones are replaced once the cloud is full. The points given to Add are its first points.
+    // <streaming>, <lod> and <quantized> are ignored for rolling clouds, which also can't be replaced with <ARVisualizer::Update>.
+    unsigned long capacity = 0;
+
+    // Set to downsample the points to one point per cube of this edge length, at the average position and color
+    // of the points in the cube. Use it for dense clouds which have far more points than can be seen.
+    // The filter runs on a conversion thread (split over worker threads) after Add, Update and AppendPoints,
+    // the cloud's GUI panel shows how many points it removed.
+    float voxelSize = 0.0f;
+
+    // Set to keep the last this many updates of the cloud on the GPU and draw them together, as a trail which fades out
+    // over <historyDuration> seconds. Each update is uploaded once into its own buffer, replacing the oldest one once
+    // all are in use. The trail is always drawn transparently. Ignored for LOD, quantized and rolling clouds.
+    unsigned int historyFrames = 0;
+
+    // Seconds after which an update of a cloud with <historyFrames> is faded out, counted from when it was uploaded
+    float historyDuration = 1.0f;
+  };
+
   struct PointCloudData
   {
     // For PCL_PointXYZ: Points xyzw floats (w is ignored, easier because pcl::PointXYZ is aligned to 4 floats)
     // For PCL_PointXYZRGBA: Points xyzw floats + 4 uint8 bgra + 12 bytes padding
     const void* pointData;
 
+    // Set if the visualizer should use the points without copying them, pointData points into this buffer then.
+    // The visualizer keeps a reference until the points were uploaded to the GPU, and reads them from
+    // its render thread until then, so they must not be modified anymore.
+    // Use a custom deleter to find out when the visualizer is done with the buffer.
+    std::shared_ptr<const void> sharedPointData;
+
     // Number of points in the array.
     unsigned long numPoints;
 
@@ -54,6 +99,15 @@ namespace ar
       pointData = data;
       numPoints = count;
     }
+
+    PointCloudData(std::shared_ptr<const void> data, unsigned long count, PointCloudDataType dataType, Color color = Color()) :
+      sharedPointData(data),
+      type(dataType),
+      color(color)
+    {
+      pointData = data.get();
+      numPoints = count;
+    }
   };
 
 } // namespace ar
@@ -5,7 +5,9 @@
 #include "Material.hpp"
 #include "Vertex.hpp"
 #include "common.hpp"
+#include "rendering/Culling.hpp"
 #include <glm/glm.hpp>
+#include <utility>
 
 namespace ar
 {
@@ -16,10 +18,11 @@ class Mesh
 public:
   Mesh() : _id(0) {};
   Mesh(ShaderProgram* s) : _id(0), _shader(s) {};
-  Mesh(Vector<VertexT> v) : _id(0), _dirty(true), _vertices(v) {};
-  Mesh(Vector<VertexT> v, Vector<GLuint> i) : _id(0), _dirty(true), _vertices(v), _indices(i) {};
-  Mesh(Vector<VertexT> v, ShaderProgram* s) : _id(0), _dirty(true), _vertices(v), _shader(s) {};
-  Mesh(Vector<VertexT> v, Vector<GLuint> i, ShaderProgram* s) : _id(0), _dirty(true), _vertices(v), _indices(i), _shader(s) {};
+  // vertex & index data is taken over, pass temporaries or std::move to avoid copying it
+  Mesh(Vector<VertexT> v) : _id(0), _dirty(true), _vertices(std::move(v)) {};
+  Mesh(Vector<VertexT> v, Vector<GLuint> i) : _id(0), _dirty(true), _vertices(std::move(v)), _indices(std::move(i)) {};
+  Mesh(Vector<VertexT> v, ShaderProgram* s) : _id(0), _dirty(true), _vertices(std::move(v)), _shader(s) {};
+  Mesh(Vector<VertexT> v, Vector<GLuint> i, ShaderProgram* s) : _id(0), _dirty(true), _vertices(std::move(v)), _indices(std::move(i)), _shader(s) {};
 
   unsigned int ID() const { return _id; };
   void SetID(unsigned int id) { _id = id; };
@@ -28,12 +31,12 @@ public:
   void ClearDirty() { _dirty = false; };
 
   unsigned int VertexCount() const { return _vertices.size(); };
-  Vector<VertexT> GetVertices() const { return _vertices; };
-  void SetVertices(Vector<VertexT> v) { _vertices = v; _dirty = true; };
+  const Vector<VertexT>& GetVertices() const { return _vertices; };
+  void SetVertices(Vector<VertexT> v) { _vertices = std::move(v); _dirty = true; };
 
   unsigned int IndexCount() const { return _indices.size(); };
-  Vector<GLuint> GetIndices() const { return _indices; };
-  void SetIndices(Vector<GLuint> v) { _indices = v; _dirty = true; };
+  const Vector<GLuint>& GetIndices() const { return _indices; };
+  void SetIndices(Vector<GLuint> v) { _indices = std::move(v); _dirty = true; };
 
   ShaderProgram* GetShader() const { return _shader; };
   void SetShader(ShaderProgram* s) {
@@ -42,7 +45,7 @@ public:
       _material->SetShader(s);
   };
 
-  SharedPtr<Material> GetMaterial() const { return _material; };
+  const SharedPtr<Material>& GetMaterial() const { return _material; };
   void SetMaterial(SharedPtr<Material> m) {
     _material = m;
     if (_shader != nullptr)
@@ -58,6 +61,10 @@ public:
   glm::mat4 GetTransform() const { return _transform; };
   void SetTransform(glm::mat4 t) { _transform = t; };
 
+  // Box around the vertices, without the transform
+  const Bounds& GetBounds() const { return _bounds; };
+  void SetBounds(const Bounds& b) { _bounds = b; };
+
 private:
   unsigned int _id = 0;
   bool _dirty = false; // marked True if we have vertex data the renderer doesn't know about, yet
@@ -68,6 +75,7 @@ private:
   ShaderProgram* _shader = nullptr;
   SharedPtr<Material> _material;
   glm::mat4 _transform = glm::mat4(1.0); // transformation of this object from the origin
+  Bounds _bounds;
 };
 
 template <typename VertexT>
@@ -3,13 +3,14 @@
 #include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 
 namespace ar
 {
 
 template <>
-Mesh<VertexP2> MeshFactory::MakeTriangle<Mesh<VertexP2>>(Vector<glm::vec2> vertexPositions)
+Mesh<VertexP2> MeshFactory::MakeTriangle<Mesh<VertexP2>>(const Vector<glm::vec2>& vertexPositions)
 {
   Vector<VertexP2> verts;
   Vector<GLuint> indices = {0, 1, 2};
@@ -18,11 +19,11 @@ Mesh<VertexP2> MeshFactory::MakeTriangle<Mesh<VertexP2>>(Vector<glm::vec2> verte
     verts.push_back({vertexPositions[i].x, vertexPositions[i].y});
   }
 
-  return Mesh<VertexP2>(verts, indices);
+  return Mesh<VertexP2>(std::move(verts), std::move(indices));
 }
 
 template <>
-Mesh<VertexP3> MeshFactory::MakeTriangle<Mesh<VertexP3>>(Vector<glm::vec3> vertexPositions)
+Mesh<VertexP3> MeshFactory::MakeTriangle<Mesh<VertexP3>>(const Vector<glm::vec3>& vertexPositions)
 {
   Vector<VertexP3> verts;
   Vector<GLuint> indices = {0, 1, 2};
@@ -31,11 +32,11 @@ Mesh<VertexP3> MeshFactory::MakeTriangle<Mesh<VertexP3>>(Vector<glm::vec3> verte
     verts.push_back({vertexPositions[i].x, vertexPositions[i].y, vertexPositions[i].z});
   }
 
-  return Mesh<VertexP3>(verts, indices);
+  return Mesh<VertexP3>(std::move(verts), std::move(indices));
 }
 
 template <>
-Mesh<VertexP3C4> MeshFactory::MakeTriangle<Mesh<VertexP3C4>>(Vector<glm::vec3> vertexPositions, Vector<Color> vertexColors)
+Mesh<VertexP3C4> MeshFactory::MakeTriangle<Mesh<VertexP3C4>>(const Vector<glm::vec3>& vertexPositions, const Vector<Color>& vertexColors)
 {
   Vector<VertexP3C4> verts;
   Vector<GLuint> indices = {0, 1, 2};
@@ -44,18 +45,18 @@ Mesh<VertexP3C4> MeshFactory::MakeTriangle<Mesh<VertexP3C4>>(Vector<glm::vec3> v
                      vertexColors[i].r,    vertexColors[i].g,    vertexColors[i].b, vertexColors[i].a});
   }
 
-  return Mesh<VertexP3C4>(verts, indices);
+  return Mesh<VertexP3C4>(std::move(verts), std::move(indices));
 }
 
 template <>
-Mesh<VertexP3C4> MeshFactory::MakeTriangle<Mesh<VertexP3C4>>(Vector<glm::vec3> vertexPositions, Color color)
+Mesh<VertexP3C4> MeshFactory::MakeTriangle<Mesh<VertexP3C4>>(const Vector<glm::vec3>& vertexPositions, Color color)
 {
   Vector<Color> vertexColors = { color, color, color };
   return MakeTriangle<Mesh<VertexP3C4>>(vertexPositions, vertexColors);
 }
 
 template <>
-Mesh<VertexP3N3> MeshFactory::MakeTriangle<Mesh<VertexP3N3>>(Vector<glm::vec3> vertexPositions)
+Mesh<VertexP3N3> MeshFactory::MakeTriangle<Mesh<VertexP3N3>>(const Vector<glm::vec3>& vertexPositions)
 {
   Vector<VertexP3N3> verts;
   Vector<GLuint> indices = {0, 1, 2};
@@ -71,7 +72,7 @@ Mesh<VertexP3N3> MeshFactory::MakeTriangle<Mesh<VertexP3N3>>(Vector<glm::vec3> v
     });
   }
 
-  return Mesh<VertexP3N3>(verts, indices);
+  return Mesh<VertexP3N3>(std::move(verts), std::move(indices));
 }
 
 template <>
@@ -88,7 +89,7 @@ Mesh<VertexP2> MeshFactory::MakeQuad<Mesh<VertexP2>>(glm::vec2 center, double wi
     verts.push_back( {v.x, v.y} );
   }
 
-  return Mesh<VertexP2>(verts, indices);
+  return Mesh<VertexP2>(std::move(verts), std::move(indices));
 }
 
 template <>
@@ -114,7 +115,7 @@ TexturedMesh<VertexP2T2> MeshFactory::MakeQuad<TexturedMesh<VertexP2T2>>(glm::ve
     });
   }
 
-  return TexturedMesh<VertexP2T2>(verts, indices);
+  return TexturedMesh<VertexP2T2>(std::move(verts), std::move(indices));
 }
 
 template <>
@@ -134,11 +135,11 @@ Mesh<VertexP3> MeshFactory::MakeQuad<Mesh<VertexP3>>(glm::vec3 center, glm::vec3
   Mesh<VertexP3> m = Mesh<VertexP3>(verts, indices);
   m.SetTransform(MakeTransform(center, glm::vec3(0.0f, 0.0f, 1.0f), normal));
 
-  return Mesh<VertexP3>(verts, indices);
+  return Mesh<VertexP3>(std::move(verts), std::move(indices));
 }
 
 template <>
-Mesh<VertexP3C4> MeshFactory::MakeQuad<Mesh<VertexP3C4>>(glm::vec3 center, glm::vec3 normal, double width, double height, Vector<Color> vertexColors)
+Mesh<VertexP3C4> MeshFactory::MakeQuad<Mesh<VertexP3C4>>(glm::vec3 center, glm::vec3 normal, double width, double height, const Vector<Color>& vertexColors)
 {
   Vector<glm::vec3> vertex_positions;
   Vector<GLuint> indices;
@@ -154,7 +155,7 @@ Mesh<VertexP3C4> MeshFactory::MakeQuad<Mesh<VertexP3C4>>(glm::vec3 center, glm::
     });
   }
 
-  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(verts, indices);
+  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(std::move(verts), std::move(indices));
   m.SetTransform(MakeTransform(center, glm::vec3(0.0f, 0.0f, 1.0f), normal));
 
   return m;
@@ -185,7 +186,7 @@ Mesh<VertexP3N3> MeshFactory::MakeQuad<Mesh<VertexP3N3>>(glm::vec3 center, glm::
     });
   }
 
-  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(verts, indices);
+  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(std::move(verts), std::move(indices));
   m.SetTransform(MakeTransform(center, glm::vec3(0.0f, 0.0f, 1.0f), n_normal));
 
   return m;
@@ -220,7 +221,7 @@ Mesh<VertexP3N3> MeshFactory::MakeBox(glm::vec3 center, double xLength, double y
     }
   }
 
-  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(verts, indices);
+  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(std::move(verts), std::move(indices));
 
   // assign it a transform translating it to center
   m.SetTransform(glm::translate(glm::mat4(1.0f), center));
@@ -253,7 +254,7 @@ Mesh<VertexP3C4> MeshFactory::MakeIcosphere<Mesh<VertexP3C4>>(glm::vec3 center,
     });
   }
 
-  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(vertices, indices);
+  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(std::move(vertices), std::move(indices));
 
   // assign it a transform translating it to center
   m.SetTransform(glm::translate(glm::mat4(1.0f), center));
@@ -282,7 +283,7 @@ Mesh<VertexP3N3> MeshFactory::MakeIcosphere<Mesh<VertexP3N3>>(glm::vec3 center,
     });
   }
 
-  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(vertices, indices);
+  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(std::move(vertices), std::move(indices));
 
   // assign it a transform translating it to center
   m.SetTransform(glm::translate(glm::mat4(1.0f), center));
@@ -309,7 +310,7 @@ Mesh<VertexP3C4> MeshFactory::MakeUVSphere<Mesh<VertexP3C4>>(glm::vec3 center, d
     });
   }
 
-  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(vertices, indices);
+  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(std::move(vertices), std::move(indices));
   m.SetTransform(glm::translate(glm::mat4(1.0f), center));
   return m;
 }
@@ -335,11 +336,24 @@ Mesh<VertexP3N3> MeshFactory::MakeUVSphere<Mesh<VertexP3N3>>(glm::vec3 center, d
     });
   }
 
-  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(vertices, indices);
+  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(std::move(vertices), std::move(indices));
   m.SetTransform(glm::translate(glm::mat4(1.0f), center));
   return m;
 }
 
+template <>
+Vector<Mesh<VertexP3N3>> MeshFactory::MakeUVSphereLods<Mesh<VertexP3N3>>()
+{
+  // about 1900, 450, 160 and 50 triangles
+  const int resolutions[NumLodLevels] = { 32, 16, 10, 6 };
+
+  Vector<Mesh<VertexP3N3>> lods;
+  lods.reserve(NumLodLevels);
+  for (int resolution : resolutions)
+    lods.push_back(MakeUVSphere<Mesh<VertexP3N3>>(glm::vec3(0, 0, 0), 1.0, resolution));
+  return lods;
+}
+
 template <>
 Mesh<VertexP3C4> MeshFactory::MakeCapsule<Mesh<VertexP3C4>>(glm::vec3 center1, glm::vec3 center2, double radius, Color color, int resolution)
 {
@@ -368,7 +382,7 @@ Mesh<VertexP3C4> MeshFactory::MakeCapsule<Mesh<VertexP3C4>>(glm::vec3 center1, g
     });
   }
 
-  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(vertices, indices);
+  Mesh<VertexP3C4> m = Mesh<VertexP3C4>(std::move(vertices), std::move(indices));
   m.SetTransform(MakeTransform(center, glm::vec3(1,0,0), axis)); // from_rotation is (1,0,0) because our capsule is generated along the x-axis
   return m;
 }
@@ -404,54 +418,74 @@ Mesh<VertexP3N3> MeshFactory::MakeCapsule<Mesh<VertexP3N3>>(glm::vec3 center1, g
     });
   }
 
-  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(vertices, indices);
+  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(std::move(vertices), std::move(indices));
   m.SetTransform(MakeTransform(center, glm::vec3(1,0,0), axis)); // from_rotation is (1,0,0) because our capsule is generated along the x-axis
   return m;
 }
 
 template <>
-Mesh<VertexP3N3> MeshFactory::MakeTriangleMesh<Mesh<VertexP3N3>>(Vector<glm::vec3> vertexPositions, Vector<GLuint> indices, Vector<glm::vec3> normals)
+Mesh<VertexP3N3> MeshFactory::MakeTriangleMesh<Mesh<VertexP3N3>>(const Vector<glm::vec3>& vertexPositions, const Vector<GLuint>& indices, const Vector<glm::vec3>& normals)
 {
-  Vector<VertexP3N3> vertices;
-
   // if we have the right number of normals, use them; if not generate some
-  if (vertexPositions.size() == normals.size())
+  const bool hasNormals = vertexPositions.size() == normals.size();
+  return MakeTriangleMesh<Mesh<VertexP3N3>>(reinterpret_cast<const float*>(vertexPositions.data()), vertexPositions.size(),
+                                            indices.data(), indices.size(),
+                                            hasNormals ? reinterpret_cast<const float*>(normals.data()) : nullptr);
+}
+
+template <>
+Mesh<VertexP3N3> MeshFactory::MakeTriangleMesh<Mesh<VertexP3N3>>(const float* vertexPositions, size_t numVertices,
+                                                                 const GLuint* indices, size_t numIndices,
+                                                                 const float* normals)
+{
+  Vector<VertexP3N3> vertices(numVertices);
+  Vector<GLuint> meshIndices;
+
+  // if indices were provided, use them, otherwise all vertices are used in order
+  if (numIndices > 0)
   {
-    for (size_t i = 0; i < vertexPositions.size(); i++)
-    {
-      vertices.push_back({
-        { vertexPositions[i].x, vertexPositions[i].y, vertexPositions[i].z },
-        { normals[i].x, normals[i].y, normals[i].z }
-      });
-    }
+    meshIndices.assign(indices, indices + numIndices);
   }
   else
   {
-    for (size_t i = 0; i < vertexPositions.size(); i++)
-    {
-      vertices.push_back({
-        { vertexPositions[i].x, vertexPositions[i].y, vertexPositions[i].z },
-        { 0, 0, 0 }
-      });
-    }
+    meshIndices.resize(numVertices);
+    for (size_t i = 0; i < numVertices; i++)
+      meshIndices[i] = i;
+  }
 
+  for (size_t i = 0; i < numVertices; i++)
+  {
+    VertexP3N3& vertex = vertices[i];
+    std::copy(vertexPositions + 3*i, vertexPositions + 3*i + 3, vertex.position);
+    if (normals != nullptr)
+      std::copy(normals + 3*i, normals + 3*i + 3, vertex.normal);
+    else
+      std::fill(vertex.normal, vertex.normal + 3, 0.0f);
+  }
+
+  if (normals == nullptr)
+  {
     // generate flat normals for each triangle in the mesh according to their vertex ordering
-    for (size_t i = 0; i < indices.size(); i+=3)
+    for (size_t i = 0; i + 2 < meshIndices.size(); i+=3)
     {
-      glm::vec3 normal = glm::cross(glm::normalize(vertexPositions[indices[i+1]] - vertexPositions[indices[i]]),
-                                    glm::normalize(vertexPositions[indices[i+2]] - vertexPositions[indices[i]]));
-      vertices[indices[i]].normal[0] = normal.x; vertices[indices[i]].normal[1] = normal.y; vertices[indices[i]].normal[2] = normal.z;
-      vertices[indices[i+1]].normal[0] = normal.x; vertices[indices[i+1]].normal[1] = normal.y; vertices[indices[i+1]].normal[2] = normal.z;
-      vertices[indices[i+2]].normal[0] = normal.x; vertices[indices[i+2]].normal[1] = normal.y; vertices[indices[i+2]].normal[2] = normal.z;
+      const glm::vec3 p0 = glm::make_vec3(vertexPositions + 3*meshIndices[i]);
+      const glm::vec3 p1 = glm::make_vec3(vertexPositions + 3*meshIndices[i+1]);
+      const glm::vec3 p2 = glm::make_vec3(vertexPositions + 3*meshIndices[i+2]);
+      const glm::vec3 normal = glm::cross(glm::normalize(p1 - p0), glm::normalize(p2 - p0));
+
+      for (size_t j = 0; j < 3; j++)
+      {
+        float* n = vertices[meshIndices[i+j]].normal;
+        n[0] = normal.x; n[1] = normal.y; n[2] = normal.z;
+      }
     }
   }
 
-  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(vertices, indices);
-  return m;
+  return Mesh<VertexP3N3>(std::move(vertices), std::move(meshIndices));
 }
 
 template <>
-Mesh<VertexP3N3> MeshFactory::MakeTriangleFan<Mesh<VertexP3N3>>(Vector<glm::vec3> vertexPositions, bool doubleSided)
+Mesh<VertexP3N3> MeshFactory::MakeTriangleFan<Mesh<VertexP3N3>>(const Vector<glm::vec3>& vertexPositions, bool doubleSided)
 {
   Vector<VertexP3N3> vertices;
   Vector<GLuint> indices;
@@ -504,7 +538,7 @@ Mesh<VertexP3N3> MeshFactory::MakeTriangleFan<Mesh<VertexP3N3>>(Vector<glm::vec3
     }
   }
 
-  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(vertices, indices);
+  Mesh<VertexP3N3> m = Mesh<VertexP3N3>(std::move(vertices), std::move(indices));
   return m;
 }
 
@@ -517,6 +551,8 @@ LineMesh MeshFactory::MakeLineMesh(const Vector<glm::vec3>& vertexPositions)
   Vector<VertexLine> vertices;
   Vector<GLuint> indices;
   const size_t size = vertexPositions.size();
+  vertices.reserve(4 * (size - 1));
+  indices.reserve(6 * (size - 1));
   for (size_t i = 0; i < size - 1; i++)
   {
     const size_t next = i + 1;
@@ -552,7 +588,7 @@ LineMesh MeshFactory::MakeLineMesh(const Vector<glm::vec3>& vertexPositions)
     indices.push_back(i*4+3);
   }
 
-  return LineMesh(vertices, indices);
+  return LineMesh(std::move(vertices), std::move(indices));
 }
 
 glm::mat4 MeshFactory::MakeTransform(glm::vec3 offset, glm::vec3 from_rotation, glm::vec3 to_rotation)
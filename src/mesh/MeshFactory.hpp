@@ -18,27 +18,27 @@ public:
   // @MeshT The <Mesh> type to construct
   // @vertexPositions Coordinates of the triangle vertices
   template <typename MeshT>
-  static MeshT MakeTriangle(Vector<glm::vec2> vertexPositions);
+  static MeshT MakeTriangle(const Vector<glm::vec2>& vertexPositions);
 
   // 3D triangles
   // @MeshT The <Mesh> type to construct
   // @vertexPositions Coordinates of the triangle vertices
   template <typename MeshT>
-  static MeshT MakeTriangle(Vector<glm::vec3> vertexPositions);
+  static MeshT MakeTriangle(const Vector<glm::vec3>& vertexPositions);
 
   // 3D triangles with per-vertex colors
   // @MeshT           The <Mesh> type to construct
   // @vertexPositions Coordinates of the triangle vertices
   // @vertexColors    Colors to assign to each vertex. Length must match <vertexPositions>
   template <typename MeshT>
-  static MeshT MakeTriangle(Vector<glm::vec3> vertexPositions, Vector<Color> vertexColors);
+  static MeshT MakeTriangle(const Vector<glm::vec3>& vertexPositions, const Vector<Color>& vertexColors);
 
   // 3D colored triangles (constant color)
   // @MeshT           The <Mesh> type to construct
   // @vertexPositions Coordinates of the triangle vertices
   // @vertexColors    Color to apply at each vertex
   template <typename MeshT>
-  static MeshT MakeTriangle(Vector<glm::vec3> vertexPositions, Color vertexColors);
+  static MeshT MakeTriangle(const Vector<glm::vec3>& vertexPositions, Color vertexColors);
 
   // 2D quads
   // @MeshT  The <Mesh> type to construct
@@ -65,7 +65,7 @@ public:
   // @height Height of the quad
   // @vertexColors Colors to assign to each vertex. Length should be 4.
   template <typename MeshT>
-  static MeshT MakeQuad(glm::vec3 center, glm::vec3 normal, double width, double height, Vector<Color> vertexColors);
+  static MeshT MakeQuad(glm::vec3 center, glm::vec3 normal, double width, double height, const Vector<Color>& vertexColors);
 
   // 3D quads with constant color
   // @MeshT  The <Mesh> type to construct
@@ -129,6 +129,17 @@ public:
   template <typename MeshT>
   static MeshT MakeUVSphere(glm::vec3 center, double radius, Color color, int resolution);
 
+  // Number of levels of detail made by <MakeUVSphereLods>
+  static const size_t NumLodLevels = 4;
+
+  // Unit UVSpheres for each level of detail, from the finest to the coarsest
+  // All levels have an even resolution, so no vertex lies on the sphere's equator (x == 0).
+  // @MeshT The <Mesh> type to construct
+  //
+  // @return <NumLodLevels> meshes
+  template <typename MeshT>
+  static Vector<MeshT> MakeUVSphereLods();
+
   // Basic Capsule
   // @MeshT        The <Mesh> type to construct
   // @center1      Center of first lobe
@@ -151,10 +162,20 @@ public:
   // Constructs a mesh from raw data
   // @MeshT           The <Mesh> type to construct
   // @vertexPositions All vertex positions for the mesh
-  // @indices         Indices into <vertexPositions> for constructing triangles
+  // @indices         Indices into <vertexPositions> for constructing triangles. If empty, all vertices are used in order.
   // @normals         Normal vectors for each vertex in <vertexPositions>
   template <typename MeshT>
-  static MeshT MakeTriangleMesh(Vector<glm::vec3> vertexPositions, Vector<GLuint> indices, Vector<glm::vec3> normals);
+  static MeshT MakeTriangleMesh(const Vector<glm::vec3>& vertexPositions, const Vector<GLuint>& indices, const Vector<glm::vec3>& normals);
+
+  // Constructs a mesh from raw arrays, without copying them into intermediate vectors first
+  // @MeshT           The <Mesh> type to construct
+  // @vertexPositions x,y,z coordinates of each vertex, 3 * <numVertices> floats
+  // @numVertices     Number of vertices in <vertexPositions>
+  // @indices         Indices into <vertexPositions> for constructing triangles. If <numIndices> is 0, all vertices are used in order.
+  // @numIndices      Number of indices in <indices>
+  // @normals         [Optional] x,y,z normal of each vertex. If nullptr, flat normals are generated for each triangle.
+  template <typename MeshT>
+  static MeshT MakeTriangleMesh(const float* vertexPositions, size_t numVertices, const GLuint* indices, size_t numIndices, const float* normals);
 
   // Triangle fan
   // @vertexPositions All vertex positions for the mesh. Ideally, these should describe a convex polygon.
@@ -164,14 +185,15 @@ public:
   // For best results, <vertexPositions> should describe a *convex* shape.
   // Normals for each triangle are automatically generated, and are uniform across each face.
   template <typename MeshT>
-  static MeshT MakeTriangleFan(Vector<glm::vec3> vertexPositions, bool doubleSided = false);
+  static MeshT MakeTriangleFan(const Vector<glm::vec3>& vertexPositions, bool doubleSided = false);
 
   static LineMesh MakeLineMesh(const Vector<glm::vec3>& vertexPositions);
 
-protected:
   // creates a transformation matrix to change orientation between from_rotation and to_rotation with a translation of offset
   static glm::mat4 MakeTransform(glm::vec3 offset, glm::vec3 from_rotation, glm::vec3 to_rotation);
 
+protected:
+
   // Creates a quad, centered at the origin & aligned with the XY plane
   static void MakeQuadMesh(double width, double height, Vector<glm::vec3>* vertex_positions, Vector<GLuint>* indices);
 
@@ -182,6 +182,30 @@ struct VertexP3C4S
   }
 };
 
+// Instance of a primitive shape: the first three rows of its affine transform and its color
+struct VertexM34C4
+{
+  GLfloat rows[3][4];
+  GLfloat color[4];
+
+  // @bufferOffset Byte offset of the first instance in the bound buffer
+  static GLuint EnableVertexAttribArray(GLuint attribOffset = 0, size_t bufferOffset = 0)
+  {
+    for (GLuint i = 0; i < 3; i++)
+    {
+      glVertexAttribPointer(attribOffset + i, 4, GL_FLOAT, GL_FALSE,
+                            sizeof(VertexM34C4),
+                            (const GLvoid*)(bufferOffset + offsetof(VertexM34C4, rows) + i * sizeof(rows[0])));
+      glEnableVertexAttribArray(attribOffset + i);
+    }
+    glVertexAttribPointer(attribOffset + 3, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(VertexM34C4),
+                          (const GLvoid*)(bufferOffset + offsetof(VertexM34C4, color)));
+    glEnableVertexAttribArray(attribOffset + 3);
+    return 4;
+  }
+};
+
 // PCL-specific pcl::PointXYZRGBA format
 struct Vertex_PCL_PointXYZRGBA
 {
@@ -203,6 +227,65 @@ struct Vertex_PCL_PointXYZRGBA
   }
 };
 
+// Colored point without padding, the color bytes are in RGBA order
+// Colored clouds are stored in this format, see <IngestPoints>
+struct VertexP3RGBA
+{
+  GLfloat position[3];
+  uint32_t color;
+
+  static GLuint EnableVertexAttribArray(GLuint attribOffset = 0)
+  {
+    glVertexAttribPointer(attribOffset, 3, GL_FLOAT, GL_FALSE,
+                          sizeof(VertexP3RGBA),
+                          (const GLvoid*)offsetof(VertexP3RGBA, position));
+    glVertexAttribPointer(attribOffset + 1, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(VertexP3RGBA),
+                          (const GLvoid*)offsetof(VertexP3RGBA, color));
+    glEnableVertexAttribArray(attribOffset);
+    glEnableVertexAttribArray(attribOffset + 1);
+    return 2;
+  }
+};
+
+// Point with a position quantized to 16 bits per axis, relative to the bounding box of its cloud
+// The shader gets the position normalized to 0..1 and scales it back with the box, see <QuantizePoints>
+struct VertexP3Q
+{
+  GLushort position[3];
+  GLushort padding;
+
+  static GLuint EnableVertexAttribArray(GLuint attribOffset = 0)
+  {
+    glVertexAttribPointer(attribOffset, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+                          sizeof(VertexP3Q),
+                          (const GLvoid*)offsetof(VertexP3Q, position));
+    glEnableVertexAttribArray(attribOffset);
+    return 1;
+  }
+};
+
+// <VertexP3Q> with the color of a <VertexP3RGBA>
+struct VertexP3QC4
+{
+  GLushort position[3];
+  GLushort padding;
+  uint32_t color;
+
+  static GLuint EnableVertexAttribArray(GLuint attribOffset = 0)
+  {
+    glVertexAttribPointer(attribOffset, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+                          sizeof(VertexP3QC4),
+                          (const GLvoid*)offsetof(VertexP3QC4, position));
+    glVertexAttribPointer(attribOffset + 1, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(VertexP3QC4),
+                          (const GLvoid*)offsetof(VertexP3QC4, color));
+    glEnableVertexAttribArray(attribOffset);
+    glEnableVertexAttribArray(attribOffset + 1);
+    return 2;
+  }
+};
+
 // A vertex with three position coordinates and three normal coordinates (XYZNNN)
 struct VertexP3N3
 {
@@ -0,0 +1,135 @@
+#ifndef _AR_HISTORYPOINTCLOUD_HPP
+#define _AR_HISTORYPOINTCLOUD_HPP
+
+#include <algorithm>
+#include "pointcloud/PointCloud.hpp"
+
+namespace ar
+{
+
+/*
+ * Point cloud which keeps its last <NumFrames> updates on the GPU, each in its own buffer, and draws all of them
+ * as a trail: frames fade out with the time since they were uploaded, see <HistoryDuration>.
+ * A new frame replaces the oldest one once all buffers are in use, the frames are never merged on the CPU.
+ * It is updated like a regular <PointCloud>.
+ */
+template <typename VertexT>
+class HistoryPointCloud : public PointCloud<VertexT>
+{
+  typedef PointCloud<VertexT> Base;
+  using Base::_dirty;
+  using Base::_name;
+  using Base::_shouldDraw;
+  using Base::_fadeDepth;
+  using Base::_pointSize;
+  using Base::_bounds;
+
+public:
+
+  using HistoryFrame = BasePointCloud::HistoryFrame;
+
+  // @numFrames Number of updates to keep, at least one
+  // @duration  Seconds after which a frame is faded out completely
+  HistoryPointCloud(size_t numFrames, float duration)
+    : _buffers(numFrames), _ring(numFrames), _newest(numFrames - 1), _duration(duration)
+  {
+    _frames.reserve(numFrames);
+  }
+
+  virtual void InitResource() override
+  {
+    for (auto& buffer : _buffers)
+    {
+      buffer._usage = BufferUsage::Stream;
+      buffer.Init();
+    }
+  }
+
+  virtual void ReleaseResource() override
+  {
+    for (auto& buffer : _buffers)
+      buffer.Release();
+    _frames.clear();
+    _numFrames = 0;
+    _newest = _buffers.size() - 1;
+  }
+
+  size_t NumFrames() const { return _buffers.size(); }
+
+  // Uploads the new points into the buffer of the oldest frame
+  virtual void UpdateBuffer() override
+  {
+    if (!_dirty)
+      return;
+
+    _newest = (_newest + 1) % _buffers.size();
+    _numFrames = std::min(_numFrames + 1, _buffers.size());
+
+    Base::uploadPoints(_buffers[_newest]);
+    _ring[_newest].vao = _buffers[_newest]._vao;
+    _ring[_newest].numPoints = Base::NumPoints();
+    _ring[_newest].time = glfwGetTime();
+    _ring[_newest].bounds = _bounds;
+    _dirty = false;
+
+    // the cloud's bounds cover all frames which are drawn
+    _frames.clear();
+    _bounds = Bounds();
+    for (size_t i = _numFrames; i > 0; i--)
+    {
+      _frames.push_back(_ring[(_newest + _buffers.size() + 1 - i) % _buffers.size()]);
+      _bounds.Grow(_frames.back().bounds);
+    }
+  }
+
+  virtual const Vector<HistoryFrame>* GetHistory() const override { return &_frames; }
+  virtual float HistoryDuration() const override { return _duration; }
+
+  virtual GLuint GetVAO() override { return _buffers[_newest]._vao; }
+
+  // every frame has its own buffer, which is only rewritten after all other frames
+  virtual void SetStreaming(bool) override { }
+  virtual bool IsStreaming() const override { return false; }
+
+  virtual GLint FirstPoint() const override { return 0; }
+  virtual void FenceDraw() override { }
+
+  virtual bool ShouldDraw() const override { return _shouldDraw && !_frames.empty(); }
+
+  virtual void RenderGUI() override
+  {
+    if (!ImGui::Begin(_name.c_str()))
+    {
+      ImGui::End();
+      return;
+    }
+
+    size_t numPoints = 0;
+    for (const auto& frame : _frames)
+      numPoints += frame.numPoints;
+
+    ImGui::Text("Num points: %d in %d / %d frames", (int)numPoints, (int)_frames.size(), (int)NumFrames());
+    Base::renderVoxelFilterStats();
+    Base::renderDrawSettings();
+
+    static float duration;
+    duration = _duration;
+    ImGui::SliderFloat("History (s)", &duration, 0.1f, 30.0f);
+    _duration = duration;
+
+    ImGui::End();
+  }
+
+private:
+
+  Vector<GenericVertexBuffer<VertexT>> _buffers; // one per frame, used as a ring
+  Vector<HistoryFrame> _ring; // frame of every buffer
+  size_t _newest;        // buffer of the last upload
+  size_t _numFrames = 0; // buffers which were uploaded to
+  Vector<HistoryFrame> _frames; // oldest first
+  float _duration;
+};
+
+} // namespace ar
+
+#endif // _AR_HISTORYPOINTCLOUD_HPP
@@ -5,7 +5,10 @@
 #include "Material.hpp"
 #include "mesh/Vertex.hpp"
 #include "common.hpp"
-#include "rendering/VertexBuffer.hpp"
+#include "rendering/StreamingVertexBuffer.hpp"
+#include "rendering/Culling.hpp"
+#include "pointcloud/PointCloudOctree.hpp"
+#include "pointcloud/PointCloudQuantization.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtx/euler_angles.hpp>
@@ -26,7 +29,7 @@ public:
 
   bool Dirty() const { return _dirty; }
 
-  ShaderProgram* GetShader() { return _shaderProgram; }
+  ShaderProgram* GetShader() const { return _shaderProgram; }
   void SetShader(ShaderProgram* s)
   {
     _shaderProgram = s;
@@ -34,7 +37,7 @@ public:
       _material->SetShader(s);
   }
 
-  SharedPtr<Material> GetMaterial() { return _material; };
+  const SharedPtr<Material>& GetMaterial() const { return _material; };
   void SetMaterial(SharedPtr<Material> m)
   {
     _material = m;
@@ -45,12 +48,61 @@ public:
   glm::mat4 GetTransform() const  { return _transform; }
   void SetTransform(glm::mat4 transform) { _transform = transform; }
 
+  // Box around the uploaded points, without the transform
+  const Bounds& GetBounds() const { return _bounds; }
+
   virtual bool ShouldDraw() const = 0;
   virtual size_t NumPoints() const = 0;
+  virtual size_t VertexSize() const = 0;
   virtual void UpdateBuffer() = 0;
   virtual GLuint GetVAO() = 0;
   virtual void RenderGUI() = 0;
 
+  // Streaming clouds upload into a ring of GPU buffers instead of reallocating their buffer, see <StreamingVertexBuffer>
+  virtual void SetStreaming(bool streaming) = 0;
+  virtual bool IsStreaming() const = 0;
+
+  // LOD clouds are drawn from an octree which is built on <worker>, see <PointCloudOctree>
+  // Must be called before the cloud is initialized.
+  void SetLod(bool lod) { _lod = lod; }
+  bool IsLod() const { return _lod; }
+  void SetLodWorker(WorkerThread* worker) { _lodWorker = worker; }
+
+  // Quantized clouds store their points as <VertexP3Q> or <VertexP3QC4>, relative to these bounds
+  virtual bool IsQuantized() const = 0;
+  const QuantizationBounds& GetQuantizationBounds() const { return _quantizationBounds; }
+  void SetQuantizationBounds(const QuantizationBounds& bounds) { _quantizationBounds = bounds; }
+
+  // Point counts before and after the voxel grid filter of the last update, shown in the GUI, see <VoxelGridFilter>
+  void SetVoxelFilterStats(float leafSize, size_t numInputPoints, size_t numFilteredPoints)
+  {
+    _voxelSize = leafSize;
+    _numInputPoints = numInputPoints;
+    _numFilteredPoints = numFilteredPoints;
+  }
+
+  // @return The octree of a LOD cloud, nullptr otherwise
+  virtual BasePointCloudOctree* GetOctree() = 0;
+
+  // An upload kept by a cloud with history, see <HistoryPointCloud>
+  struct HistoryFrame
+  {
+    GLuint vao;
+    size_t numPoints;
+    double time; // glfwGetTime() of the upload
+    Bounds bounds;
+  };
+
+  // @return The uploads kept by a cloud with history, oldest first, nullptr for other clouds
+  virtual const Vector<HistoryFrame>* GetHistory() const { return nullptr; }
+  // Frames uploaded more than this many seconds ago are not drawn anymore
+  virtual float HistoryDuration() const { return 0.0f; }
+
+  // First point to draw from the VAO
+  virtual GLint FirstPoint() const = 0;
+  // Call after the cloud was drawn
+  virtual void FenceDraw() = 0;
+
   float _fadeDepth = 5.0f;
   float _pointSize = 1.0f;
 
@@ -58,6 +110,34 @@ protected:
 
   friend class PointCloudRenderer;
 
+  void renderVoxelFilterStats() const
+  {
+    if (_voxelSize > 0.0f)
+      ImGui::Text("Voxel filter (%.3f): %d -> %d points", _voxelSize, (int)_numInputPoints, (int)_numFilteredPoints);
+  }
+
+  // The settings every kind of cloud shows in its GUI window
+  void renderDrawSettings()
+  {
+    ImGui::Separator();
+    ImGui::PushItemWidth(-100);
+
+    static bool shouldDraw;
+    shouldDraw = _shouldDraw;
+    ImGui::Checkbox("Draw", &shouldDraw);
+    _shouldDraw = shouldDraw;
+
+    static float fadeDepth = 5.0f;
+    fadeDepth = _fadeDepth;
+    ImGui::SliderFloat("Fade Depth", &fadeDepth, 1.0f, 10.0f);
+    _fadeDepth = fadeDepth;
+
+    static float pointsSize = 1.0f;
+    pointsSize = _pointSize;
+    ImGui::SliderFloat("Points Size", &pointsSize, 0.0f, 5.0f);
+    _pointSize = pointsSize;
+  }
+
   unsigned int _id;
   bool _dirty = false;
   bool _pendingDelete = false;
@@ -67,6 +147,13 @@ protected:
   SharedPtr<Material> _material;
   glm::mat4 _transform = glm::mat4(1.0); // transformation of this object from the origin
   bool _shouldDraw = true;
+  bool _lod = false;
+  WorkerThread* _lodWorker = nullptr;
+  QuantizationBounds _quantizationBounds;
+  Bounds _bounds;
+  float _voxelSize = 0.0f;
+  size_t _numInputPoints = 0;
+  size_t _numFilteredPoints = 0;
 };
 
 template <typename VertexT>
@@ -75,18 +162,30 @@ class PointCloud : public BasePointCloud
 public:
 
   using VertexType = VertexT;
-  using VertexBufferType = GenericVertexBuffer<VertexType>;
+  using VertexBufferType = StreamingVertexBuffer<VertexType>;
 
   PointCloud() = default;
 
   virtual void InitResource() override
   {
     _vertexBuffer.Init();
+
+    if (_lod)
+    {
+      _octree.reset(new PointCloudOctree<VertexType>(_lodWorker));
+      _octree->Init();
+    }
   }
 
   virtual void ReleaseResource() override
   {
     _vertexBuffer.Release();
+
+    if (_octree != nullptr)
+    {
+      _octree->Release();
+      _octree.reset();
+    }
   }
 
   VertexBufferType& GetVertexBuffer() { return _vertexBuffer; }
@@ -94,16 +193,43 @@ public:
   void SetPoints(const VertexType* points, size_t numPoints)
   {
     _points.assign(points, points + numPoints);
+    _sharedPoints.reset();
+    _numPoints = numPoints;
+    _dirty = true;
+  }
+
+  // Replaces the points with the content of <points>, and hands the previous points back in <points>
+  void SwapPoints(Vector<VertexType>& points)
+  {
+    std::swap(_points, points);
+    _sharedPoints.reset();
+    _numPoints = _points.size();
+    _dirty = true;
+  }
+
+  // Uses the points in <points> without copying them, they must be in the stored format already.
+  // Points which need converting, like colored PCL points, are converted before they reach the render thread.
+  // The reference to <points> is dropped as soon as they were uploaded to the GPU.
+  void SetSharedPoints(SharedPtr<const void> points, size_t numPoints)
+  {
+    _points.clear();
+    _sharedPoints = std::move(points);
+    _numPoints = numPoints;
     _dirty = true;
   }
 
   virtual void UpdateBuffer() override
   {
+    if (_octree != nullptr)
+    {
+      updateOctree();
+      return;
+    }
+
     if (!_dirty)
       return;
 
-    _vertexBuffer.SetVertices(_points);
-    _vertexBuffer.BufferData();
+    uploadPoints(_vertexBuffer);
     _dirty = false;
   }
 
@@ -112,15 +238,28 @@ public:
     return _vertexBuffer._vao;
   }
 
+  virtual void SetStreaming(bool streaming) override { _vertexBuffer.SetStreaming(streaming); }
+  virtual bool IsStreaming() const override { return _vertexBuffer.IsStreaming(); }
+
+  virtual BasePointCloudOctree* GetOctree() override { return _octree.get(); }
+  virtual bool IsQuantized() const override { return IsQuantizedVertex<VertexType>::value; }
+
+  virtual GLint FirstPoint() const override { return _vertexBuffer.FirstVertex(); }
+  virtual void FenceDraw() override { _vertexBuffer.FenceDraw(); }
+
   // Removes all points from the point cloud
   void ClearPoints()
   {
     _points.clear();
+    _sharedPoints.reset();
+    _numPoints = 0;
     _vertexBuffer.ClearAll();
+    _bounds = Bounds();
   }
 
   virtual bool ShouldDraw() const override { return _shouldDraw && NumPoints() > 0; }
-  virtual size_t NumPoints() const override { return _points.size(); }
+  virtual size_t NumPoints() const override { return _numPoints; }
+  virtual size_t VertexSize() const override { return sizeof(VertexType); }
 
   virtual void RenderGUI() override
   {
@@ -131,33 +270,86 @@ public:
     }
 
     ImGui::Text("Num points: %d", (int)NumPoints());
-    ImGui::Separator();
-    ImGui::PushItemWidth(-100);
-
-    static bool shouldDraw;
-    shouldDraw = _shouldDraw;
-    ImGui::Checkbox("Draw", &shouldDraw);
-    _shouldDraw = shouldDraw;
-
-    static float fadeDepth = 5.0f;
-    fadeDepth = _fadeDepth;
-    ImGui::SliderFloat("Fade Depth", &fadeDepth, 1.0f, 10.0f);
-    _fadeDepth = fadeDepth;
+    if (_octree != nullptr)
+      ImGui::Text("Octree nodes: %d", (int)_octree->Nodes().size());
+    renderVoxelFilterStats();
+    renderDrawSettings();
 
-    static float pointsSize = 1.0f;
-    pointsSize = _pointSize;
-    ImGui::SliderFloat("Points Size", &pointsSize, 0.0f, 5.0f);
-    _pointSize = pointsSize;
+    static bool streaming;
+    streaming = IsStreaming();
+    ImGui::Checkbox("Streaming", &streaming);
+    SetStreaming(streaming);
 
     ImGui::End();
   }
 
-private:
+protected:
 
   friend class PointCloudRenderer;
 
+  // Sends the points to <buffer>, caller-owned points are uploaded directly
+  template <typename BufferT>
+  void uploadPoints(BufferT& buffer)
+  {
+    if (_sharedPoints != nullptr)
+    {
+      updateBounds(static_cast<const VertexType*>(_sharedPoints.get()), _numPoints);
+      buffer.BufferVertices(static_cast<const VertexType*>(_sharedPoints.get()), _numPoints);
+      _sharedPoints.reset();
+    }
+    else
+    {
+      updateBounds(_points.data(), _points.size());
+      buffer.BufferVertices(_points.data(), _points.size());
+    }
+  }
+
+  void updateBounds(const VertexType* points, size_t numPoints)
+  {
+    _bounds = pointBounds(points, numPoints, IsQuantizedVertex<VertexType>());
+  }
+
+  // quantized points lie within their quantization bounds, so they don't have to be looked at
+  Bounds pointBounds(const VertexType*, size_t numPoints, std::true_type) const
+  {
+    if (numPoints == 0)
+      return Bounds();
+    return Bounds(_quantizationBounds.min, _quantizationBounds.min + _quantizationBounds.extent);
+  }
+
+  Bounds pointBounds(const VertexType* points, size_t numPoints, std::false_type) const
+  {
+    return PointBounds(points, numPoints);
+  }
+
+  void updateOctree()
+  {
+    if (_dirty)
+    {
+      // the builder reads the points on the worker thread, so it gets them without copying
+      if (_sharedPoints != nullptr)
+      {
+        updateBounds(static_cast<const VertexType*>(_sharedPoints.get()), _numPoints);
+        _octree->Build(std::move(_sharedPoints), _numPoints);
+      }
+      else
+      {
+        auto points = std::make_shared<Vector<VertexType>>();
+        points->swap(_points);
+        updateBounds(points->data(), points->size());
+        _octree->Build(SharedPtr<const void>(points, points->data()), points->size());
+      }
+      _dirty = false;
+    }
+
+    _octree->Update();
+  }
+
   Vector<VertexType> _points;
+  SharedPtr<const void> _sharedPoints; // caller-owned points which weren't uploaded yet, used instead of _points
+  size_t _numPoints = 0;
   VertexBufferType _vertexBuffer;
+  UniquePtr<PointCloudOctree<VertexType>> _octree;
 };
 
 }
@@ -0,0 +1,166 @@
+#include "PointCloudIngest.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AR_INGEST_X86
+#include <immintrin.h>
+#endif
+
+namespace ar
+{
+
+static size_t ingestScalar(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, VertexP3RGBA* out, bool dropInvalid)
+{
+  size_t numOut = 0;
+  for (size_t i = 0; i < numPoints; i++)
+  {
+    const Vertex_PCL_PointXYZRGBA& point = points[i];
+    if (dropInvalid && !(std::isfinite(point.position[0]) && std::isfinite(point.position[1]) && std::isfinite(point.position[2])))
+      continue;
+
+    VertexP3RGBA& vertex = out[numOut++];
+    vertex.position[0] = point.position[0];
+    vertex.position[1] = point.position[1];
+    vertex.position[2] = point.position[2];
+    vertex.color = SwizzleBGRA(point.color);
+  }
+  return numOut;
+}
+
+#ifdef AR_INGEST_X86
+
+// One point per iteration. Every point is stored, but the output only advances past valid points,
+// so dropping points doesn't need a branch.
+__attribute__((target("sse2")))
+static size_t ingestSSE2(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, VertexP3RGBA* out, bool dropInvalid)
+{
+  const __m128i positionMask = _mm_set_epi32(0, -1, -1, -1);
+  const __m128i exponentMask = _mm_set1_epi32(0x7F800000);
+  const __m128i greenAlphaMask = _mm_set1_epi32(0xFF00FF00);
+  const __m128i byteMask = _mm_set1_epi32(0xFF);
+
+  size_t numOut = 0;
+  for (size_t i = 0; i < numPoints; i++)
+  {
+    const __m128i* in = reinterpret_cast<const __m128i*>(points + i);
+    const __m128i position = _mm_loadu_si128(in);
+    __m128i color = _mm_loadu_si128(in + 1); // color in the first lane, followed by padding
+
+    // BGRA -> RGBA
+    color = _mm_or_si128(_mm_and_si128(color, greenAlphaMask),
+                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(color, 16), byteMask),
+                                      _mm_slli_epi32(_mm_and_si128(color, byteMask), 16)));
+
+    const __m128i vertex = _mm_or_si128(_mm_and_si128(position, positionMask), _mm_slli_si128(color, 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + numOut), vertex);
+
+    // a coordinate is NaN or infinite if all of its exponent bits are set
+    const __m128i invalid = _mm_cmpeq_epi32(_mm_and_si128(position, exponentMask), exponentMask);
+    const bool keep = !dropInvalid || (_mm_movemask_ps(_mm_castsi128_ps(invalid)) & 0x7) == 0;
+    numOut += keep ? 1 : 0;
+  }
+  return numOut;
+}
+
+// Two points per iteration, same approach as the SSE2 kernel
+__attribute__((target("avx2")))
+static size_t ingestAVX2(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, VertexP3RGBA* out, bool dropInvalid)
+{
+  // moves the color (lane 4) of a point next to its position
+  const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 0, 1, 2, 4);
+  // BGRA -> RGBA for the color in the last lane of each half
+  const __m256i swizzle = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 14, 13, 12, 15,
+                                           0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 14, 13, 12, 15);
+  const __m256i exponentMask = _mm256_set1_epi32(0x7F800000);
+
+  size_t i = 0;
+  size_t numOut = 0;
+  for (; i + 2 <= numPoints; i += 2)
+  {
+    const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(points + i));
+    const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(points + i + 1));
+
+    __m256i vertices = _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(first, gather),
+                                                 _mm256_permutevar8x32_epi32(second, gather), 0x20);
+    vertices = _mm256_shuffle_epi8(vertices, swizzle);
+
+    const __m256i invalid = _mm256_cmpeq_epi32(_mm256_and_si256(vertices, exponentMask), exponentMask);
+    const int invalidMask = _mm256_movemask_ps(_mm256_castsi256_ps(invalid));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + numOut), _mm256_castsi256_si128(vertices));
+    numOut += (!dropInvalid || (invalidMask & 0x07) == 0) ? 1 : 0;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + numOut), _mm256_extracti128_si256(vertices, 1));
+    numOut += (!dropInvalid || (invalidMask & 0x70) == 0) ? 1 : 0;
+  }
+
+  return numOut + ingestScalar(points + i, numPoints - i, out + numOut, dropInvalid);
+}
+
+#endif // AR_INGEST_X86
+
+bool IsIngestKernelSupported(IngestKernel kernel)
+{
+  switch (kernel)
+  {
+    case IngestKernel::Scalar: return true;
+#ifdef AR_INGEST_X86
+    case IngestKernel::SSE2: return __builtin_cpu_supports("sse2");
+    case IngestKernel::AVX2: return __builtin_cpu_supports("avx2");
+#endif
+    default: return false;
+  }
+}
+
+IngestKernel BestIngestKernel()
+{
+  if (IsIngestKernelSupported(IngestKernel::AVX2))
+    return IngestKernel::AVX2;
+  if (IsIngestKernelSupported(IngestKernel::SSE2))
+    return IngestKernel::SSE2;
+  return IngestKernel::Scalar;
+}
+
+size_t IngestPoints(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, VertexP3RGBA* out, bool dropInvalid)
+{
+  static const IngestKernel kernel = BestIngestKernel();
+  return IngestPoints(points, numPoints, out, dropInvalid, kernel);
+}
+
+size_t IngestPoints(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, VertexP3RGBA* out, bool dropInvalid, IngestKernel kernel)
+{
+  switch (kernel)
+  {
+#ifdef AR_INGEST_X86
+    case IngestKernel::SSE2: return ingestSSE2(points, numPoints, out, dropInvalid);
+    case IngestKernel::AVX2: return ingestAVX2(points, numPoints, out, dropInvalid);
+#endif
+    default: return ingestScalar(points, numPoints, out, dropInvalid);
+  }
+}
+
+void IngestPoints(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, Vector<VertexP3RGBA>& out, WorkerPool* pool)
+{
+  out.resize(numPoints);
+
+  // every range converts into its own part of <out>, the gaps left by dropped points are closed afterwards
+  const size_t numRanges = (numPoints + IngestPointsPerRange - 1) / IngestPointsPerRange;
+  Vector<size_t> numConverted(numRanges);
+  ParallelForRanges(pool, numPoints, IngestPointsPerRange, [&](size_t range, size_t begin, size_t end)
+  {
+    numConverted[range] = IngestPoints(points + begin, end - begin, out.data() + begin);
+  });
+
+  size_t numOut = numRanges > 0 ? numConverted[0] : 0;
+  for (size_t range = 1; range < numRanges; range++)
+  {
+    const auto first = out.begin() + range * IngestPointsPerRange;
+    if (numOut != range * IngestPointsPerRange)
+      std::copy(first, first + numConverted[range], out.begin() + numOut);
+    numOut += numConverted[range];
+  }
+  out.resize(numOut);
+}
+
+} // namespace ar
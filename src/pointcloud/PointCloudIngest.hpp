@@ -0,0 +1,57 @@
+#ifndef _AR_POINTCLOUDINGEST_HPP
+#define _AR_POINTCLOUDINGEST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "common.hpp"
+#include "mesh/Vertex.hpp"
+#include "WorkerPool.hpp"
+
+namespace ar
+{
+
+// Implementations of <IngestPoints>, picked at runtime by the CPU's capabilities
+enum class IngestKernel
+{
+  Scalar,
+  SSE2,
+  AVX2
+};
+
+// @return The fastest kernel the CPU supports
+IngestKernel BestIngestKernel();
+
+// @return False if the CPU can't run <kernel>
+bool IsIngestKernelSupported(IngestKernel kernel);
+
+// Converts PCL XYZRGBA points to the format colored clouds are stored in, in a single pass:
+// strips the padding, swaps the color from BGRA to RGBA and drops points with invalid (NaN or infinite) positions.
+// @points       Points to convert
+// @numPoints    Number of points in <points>
+// @out          Receives the converted points, must have room for <numPoints> points
+// @dropInvalid  Set to drop points with invalid positions, organized PCL clouds are full of them
+//
+// @return       Number of points written to <out>
+size_t IngestPoints(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, VertexP3RGBA* out, bool dropInvalid = true);
+
+// <IngestPoints> with a specific kernel, which must be supported
+size_t IngestPoints(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, VertexP3RGBA* out, bool dropInvalid, IngestKernel kernel);
+
+// <IngestPoints> for large clouds, split into ranges of <IngestPointsPerRange> points over <pool>.
+// Invalid points are dropped.
+// @out  Receives the converted points, its capacity is reused
+// @pool Threads to run on besides the calling one, may be nullptr
+void IngestPoints(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, Vector<VertexP3RGBA>& out, WorkerPool* pool);
+
+// Points converted by one range of a <WorkerPool>, large enough to make handing out a range worth it
+const size_t IngestPointsPerRange = 64 * 1024;
+
+// Swaps the red and blue bytes of a PCL color
+inline uint32_t SwizzleBGRA(uint32_t color)
+{
+  return (color & 0xFF00FF00u) | ((color >> 16) & 0xFFu) | ((color & 0xFFu) << 16);
+}
+
+} // namespace ar
+
+#endif // _AR_POINTCLOUDINGEST_HPP
@@ -0,0 +1,375 @@
+#ifndef _AR_POINTCLOUDOCTREE_HPP
+#define _AR_POINTCLOUDOCTREE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <limits>
+#include <glm/glm.hpp>
+#include "common.hpp"
+#include "WorkerThread.hpp"
+#include "rendering/VertexBuffer.hpp"
+
+namespace ar
+{
+
+/*
+ * Level-of-detail octree of a point cloud, as seen by the render thread.
+ * Every node holds a subsample of the points inside its cube, children refine their parent:
+ * drawing a node together with all of its ancestors shows the points in the node's cube at the node's resolution.
+ * The renderer picks the nodes to draw every frame, see <PointCloudRenderer>.
+ */
+class BasePointCloudOctree : public RenderResource
+{
+public:
+
+  static const size_t NoNode = static_cast<size_t>(-1);
+
+  struct Node
+  {
+    glm::vec3 min;          // corner of the node's cube, in object space
+    float size = 0.0f;      // edge length of the cube
+    unsigned int level = 0;
+    size_t numPoints = 0;
+    size_t children[8];
+    GLuint vao = 0;         // vertex array holding the node's points
+
+    Node()
+    {
+      for (auto& child : children)
+        child = NoNode;
+    }
+  };
+
+  virtual ~BasePointCloudOctree() = default;
+
+  // Uploads the nodes published by the builder since the last call
+  // Must ONLY be called from the thread owning the OpenGL Context!
+  virtual void Update() = 0;
+
+  // All nodes of the tree, the first one is the root. Empty until the builder published the first nodes.
+  const Vector<Node>& Nodes() const { return _nodes; }
+
+protected:
+
+  Vector<Node> _nodes;
+};
+
+/*
+ * Builds the octree on a <WorkerThread>, chunk by chunk.
+ * A point is kept by the first node along its path whose sampling grid cell of the point is still empty,
+ * all other points are passed on to the children. Coarse levels are therefore a uniformly thinned out version of the cloud.
+ * The nodes which changed are published after every chunk, so a large cloud becomes visible while it's still being built.
+ * Only the points added to a node since it was last published are handed over and appended to the node's buffer,
+ * so every point is copied and uploaded once, no matter how many chunks the build takes.
+ */
+template <typename VertexT>
+class PointCloudOctree : public BasePointCloudOctree
+{
+public:
+
+  static const unsigned int GridResolution = 32;   // sampling grid cells per node along each axis
+  static const unsigned int MaxLevel = 12;         // nodes on this level keep all points passed to them
+  static const size_t ChunkSize = 256 * 1024;      // points inserted between two publishes
+
+  explicit PointCloudOctree(WorkerThread* worker)
+    : _worker(worker), _shared(std::make_shared<SharedState>())
+  { }
+
+  virtual ~PointCloudOctree()
+  {
+    // aborts a build which is still running
+    _shared->generation++;
+  }
+
+  // Rebuilds the tree from the <numPoints> points in <points> on the worker thread.
+  // A build which is still running is aborted; the current nodes are kept until the new build published its first nodes.
+  void Build(SharedPtr<const void> points, size_t numPoints)
+  {
+    const unsigned int generation = ++_shared->generation;
+    SharedPtr<SharedState> shared = _shared;
+
+    _worker->Submit([shared, generation, points, numPoints]()
+    {
+      Builder builder(shared, generation);
+      builder.Run(static_cast<const VertexT*>(points.get()), numPoints);
+    });
+  }
+
+  virtual void Update() override
+  {
+    {
+      MutexLockGuard guard(_shared->mutex);
+      if (_shared->reset)
+      {
+        releaseNodes();
+        _shared->reset = false;
+      }
+      std::swap(_updates, _shared->published);
+    }
+
+    for (auto& update : _updates)
+      apply(update);
+    _updates.clear();
+  }
+
+protected:
+
+  virtual void InitResource() override { }
+
+  virtual void ReleaseResource() override
+  {
+    releaseNodes();
+  }
+
+private:
+
+  // A node as it is handed from the builder to the render thread
+  struct NodeUpdate
+  {
+    size_t node;
+    size_t parent;
+    unsigned int childIndex;
+    glm::vec3 min;
+    float size;
+    unsigned int level;
+    size_t firstPoint;      // points of the node which were published before
+    Vector<VertexT> points; // added since then
+  };
+
+  // State shared with the builder, which may outlive the tree
+  struct SharedState
+  {
+    std::mutex mutex;
+    Vector<NodeUpdate> published;
+    bool reset = false; // set when a new build published its first nodes
+    std::atomic<unsigned int> generation {0};
+  };
+
+  class Builder
+  {
+  public:
+
+    Builder(SharedPtr<SharedState> shared, unsigned int generation)
+      : _shared(std::move(shared)), _generation(generation)
+    { }
+
+    void Run(const VertexT* points, size_t numPoints)
+    {
+      // the root is a cube around all valid points
+      glm::vec3 min(std::numeric_limits<float>::max());
+      glm::vec3 max(std::numeric_limits<float>::lowest());
+      for (size_t i = 0; i < numPoints; i++)
+      {
+        if (!isValid(points[i]))
+          continue;
+
+        const glm::vec3 p = position(points[i]);
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+      }
+
+      if (min.x > max.x)
+      {
+        publish(); // no valid points, remove the previous nodes
+        return;
+      }
+
+      const glm::vec3 extent = max - min;
+      const float size = std::max(std::max(extent.x, extent.y), extent.z) * 1.001f + 1e-6f;
+      _nodes.emplace_back();
+      _nodes[0].min = min;
+      _nodes[0].size = size;
+
+      for (size_t begin = 0; begin < numPoints; begin += ChunkSize)
+      {
+        if (_shared->generation != _generation)
+          return;
+
+        const size_t end = std::min(begin + ChunkSize, numPoints);
+        for (size_t i = begin; i < end; i++)
+        {
+          if (isValid(points[i]))
+            insert(points[i]);
+        }
+
+        if (!publish())
+          return;
+      }
+    }
+
+  private:
+
+    static const size_t NumGridCells = GridResolution * GridResolution * GridResolution;
+
+    struct BuildNode
+    {
+      glm::vec3 min;
+      float size = 0.0f;
+      unsigned int level = 0;
+      size_t parent = NoNode;
+      unsigned int childIndex = 0;
+      size_t children[8] = { NoNode, NoNode, NoNode, NoNode, NoNode, NoNode, NoNode, NoNode };
+      std::bitset<NumGridCells> occupied;
+      Vector<VertexT> points; // not published yet
+      size_t numPublished = 0;
+      bool changed = false;
+    };
+
+    static glm::vec3 position(const VertexT& vertex)
+    {
+      return glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+    }
+
+    // sensors mark missing measurements with NaN
+    static bool isValid(const VertexT& vertex)
+    {
+      return std::isfinite(vertex.position[0]) && std::isfinite(vertex.position[1]) && std::isfinite(vertex.position[2]);
+    }
+
+    void insert(const VertexT& vertex)
+    {
+      const glm::vec3 p = position(vertex);
+      size_t index = 0;
+
+      for (;;)
+      {
+        BuildNode& node = _nodes[index];
+        const glm::vec3 local = (p - node.min) / node.size; // 0..1 inside the node
+
+        if (node.level == MaxLevel)
+        {
+          node.points.push_back(vertex);
+          node.changed = true;
+          return;
+        }
+
+        const size_t x = clamp<int>(static_cast<int>(local.x * GridResolution), 0, GridResolution - 1);
+        const size_t y = clamp<int>(static_cast<int>(local.y * GridResolution), 0, GridResolution - 1);
+        const size_t z = clamp<int>(static_cast<int>(local.z * GridResolution), 0, GridResolution - 1);
+        const size_t cell = (z * GridResolution + y) * GridResolution + x;
+        if (!node.occupied[cell])
+        {
+          node.occupied.set(cell);
+          node.points.push_back(vertex);
+          node.changed = true;
+          return;
+        }
+
+        const unsigned int childIndex = (local.x >= 0.5f ? 1 : 0) | (local.y >= 0.5f ? 2 : 0) | (local.z >= 0.5f ? 4 : 0);
+        size_t child = node.children[childIndex];
+        if (child == NoNode)
+          child = addChild(index, childIndex); // invalidates <node>
+
+        index = child;
+      }
+    }
+
+    size_t addChild(size_t parent, unsigned int childIndex)
+    {
+      BuildNode child;
+      child.size = _nodes[parent].size * 0.5f;
+      child.min = _nodes[parent].min + child.size * glm::vec3(childIndex & 1, (childIndex >> 1) & 1, (childIndex >> 2) & 1);
+      child.level = _nodes[parent].level + 1;
+      child.parent = parent;
+      child.childIndex = childIndex;
+
+      const size_t index = _nodes.size();
+      _nodes.push_back(std::move(child));
+      _nodes[parent].children[childIndex] = index;
+      return index;
+    }
+
+    // Hands the nodes which changed since the last call to the render thread
+    // @return False if the build was aborted
+    bool publish()
+    {
+      Vector<NodeUpdate> updates;
+      for (size_t i = 0; i < _nodes.size(); i++)
+      {
+        BuildNode& node = _nodes[i];
+        if (!node.changed)
+          continue;
+
+        // parents are always published before their children, since they have a lower index
+        NodeUpdate update { i, node.parent, node.childIndex, node.min, node.size, node.level, node.numPublished, std::move(node.points) };
+        node.numPublished += update.points.size();
+        node.points = Vector<VertexT>();
+        updates.push_back(std::move(update));
+        node.changed = false;
+      }
+
+      MutexLockGuard guard(_shared->mutex);
+      if (_shared->generation != _generation)
+        return false;
+
+      if (!_published)
+      {
+        _shared->published.clear();
+        _shared->reset = true;
+        _published = true;
+      }
+
+      for (auto& update : updates)
+        _shared->published.push_back(std::move(update));
+      return true;
+    }
+
+    SharedPtr<SharedState> _shared;
+    const unsigned int _generation;
+    bool _published = false;
+    Vector<BuildNode> _nodes;
+  };
+
+  void apply(const NodeUpdate& update)
+  {
+    if (update.node >= _nodes.size())
+    {
+      _nodes.resize(update.node + 1);
+      _buffers.resize(update.node + 1);
+    }
+
+    Node& node = _nodes[update.node];
+    node.min = update.min;
+    node.size = update.size;
+    node.level = update.level;
+    node.numPoints = update.firstPoint + update.points.size();
+    if (update.parent != NoNode)
+      _nodes[update.parent].children[update.childIndex] = update.node;
+
+    auto& buffer = _buffers[update.node];
+    if (buffer == nullptr)
+    {
+      buffer.reset(new GenericVertexBuffer<VertexT>());
+      buffer->Init();
+    }
+
+    // the updates of a node arrive in order, each one after the points of the previous ones
+    if (update.firstPoint == 0)
+      buffer->BufferVertices(update.points.data(), update.points.size());
+    else
+      buffer->AppendBufferedVertices(update.points.data(), update.points.size());
+    node.vao = buffer->_vao;
+  }
+
+  void releaseNodes()
+  {
+    for (auto& buffer : _buffers)
+    {
+      if (buffer != nullptr)
+        buffer->Release();
+    }
+    _buffers.clear();
+    _nodes.clear();
+  }
+
+  WorkerThread* _worker;
+  SharedPtr<SharedState> _shared;
+  Vector<NodeUpdate> _updates;
+  Vector<UniquePtr<GenericVertexBuffer<VertexT>>> _buffers; // vertex buffer of every node
+};
+
+} // namespace ar
+
+#endif // _AR_POINTCLOUDOCTREE_HPP
@@ -0,0 +1,135 @@
+#ifndef _AR_POINTCLOUDQUANTIZATION_HPP
+#define _AR_POINTCLOUDQUANTIZATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include "common.hpp"
+#include "mesh/Vertex.hpp"
+#include "pointcloud/PointCloudIngest.hpp"
+#include "WorkerPool.hpp"
+
+namespace ar
+{
+
+// Box the positions of a quantized cloud are relative to
+// A quantized position q (normalized to 0..1) is at min + q * extent.
+struct QuantizationBounds
+{
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 extent = glm::vec3(0.0f);
+};
+
+// True for the packed vertex formats of quantized clouds
+template <typename VertexT>
+struct IsQuantizedVertex : std::false_type { };
+template <>
+struct IsQuantizedVertex<VertexP3Q> : std::true_type { };
+template <>
+struct IsQuantizedVertex<VertexP3QC4> : std::true_type { };
+
+namespace detail
+{
+  inline void copyColor(const VertexP4&, VertexP3Q&) { }
+  inline void copyColor(const Vertex_PCL_PointXYZRGBA& from, VertexP3QC4& to) { to.color = SwizzleBGRA(from.color); }
+  inline void copyColor(const VertexP3RGBA& from, VertexP3QC4& to) { to.color = from.color; }
+
+  // sensors mark missing measurements with NaN
+  template <typename VertexT>
+  bool hasValidPosition(const VertexT& vertex)
+  {
+    return std::isfinite(vertex.position[0]) && std::isfinite(vertex.position[1]) && std::isfinite(vertex.position[2]);
+  }
+}
+
+// Converts <numPoints> points to the packed format <PackedT> (<VertexP3Q> or <VertexP3QC4>).
+// The positions are quantized against the bounding box of all points, points without a valid position are dropped.
+// With 16 bits per axis, a 10m wide cloud keeps a precision of 0.15mm.
+// @points    Points in the format the cloud was added with
+// @numPoints Number of points in <points>
+// @packed    Receives the converted points, its capacity is reused
+// @pool      Threads to split large clouds over besides the calling one, may be nullptr
+//
+// @return    The bounds to draw <packed> with
+template <typename PackedT, typename VertexT>
+QuantizationBounds QuantizePoints(const VertexT* points, size_t numPoints, Vector<PackedT>& packed, WorkerPool* pool = nullptr)
+{
+  const size_t rangeSize = IngestPointsPerRange;
+  const size_t numRanges = (numPoints + rangeSize - 1) / rangeSize;
+
+  // 1. bounds and number of valid points of every range
+  struct RangeBounds
+  {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+    size_t numValid = 0;
+  };
+  Vector<RangeBounds> rangeBounds(numRanges);
+  ParallelForRanges(pool, numPoints, rangeSize, [&](size_t range, size_t begin, size_t end)
+  {
+    RangeBounds& bounds = rangeBounds[range];
+    for (size_t i = begin; i < end; i++)
+    {
+      if (!detail::hasValidPosition(points[i]))
+        continue;
+
+      const glm::vec3 p(points[i].position[0], points[i].position[1], points[i].position[2]);
+      bounds.min = glm::min(bounds.min, p);
+      bounds.max = glm::max(bounds.max, p);
+      bounds.numValid++;
+    }
+  });
+
+  QuantizationBounds bounds;
+  glm::vec3 max(std::numeric_limits<float>::lowest());
+  bounds.min = glm::vec3(std::numeric_limits<float>::max());
+
+  // first output index of every range
+  Vector<size_t> offsets(numRanges);
+  size_t numValid = 0;
+  for (size_t range = 0; range < numRanges; range++)
+  {
+    bounds.min = glm::min(bounds.min, rangeBounds[range].min);
+    max = glm::max(max, rangeBounds[range].max);
+    offsets[range] = numValid;
+    numValid += rangeBounds[range].numValid;
+  }
+
+  packed.clear();
+  if (numValid == 0)
+    return QuantizationBounds();
+
+  packed.resize(numValid);
+  bounds.extent = max - bounds.min;
+
+  // flat clouds have no extent along one axis, keep the scale finite there
+  const glm::vec3 scale = glm::vec3(65535.0f) / glm::max(bounds.extent, glm::vec3(std::numeric_limits<float>::min()));
+
+  // 2. every range packs its valid points into its own part of <packed>
+  ParallelForRanges(pool, numPoints, rangeSize, [&](size_t range, size_t begin, size_t end)
+  {
+    PackedT* out = packed.data() + offsets[range];
+    for (size_t i = begin; i < end; i++)
+    {
+      if (!detail::hasValidPosition(points[i]))
+        continue;
+
+      PackedT& vertex = *out++;
+      for (int axis = 0; axis < 3; axis++)
+      {
+        const float q = (points[i].position[axis] - bounds.min[axis]) * scale[axis] + 0.5f;
+        vertex.position[axis] = static_cast<GLushort>(clamp(q, 0.0f, 65535.0f));
+      }
+      vertex.padding = 0;
+      detail::copyColor(points[i], vertex);
+    }
+  });
+
+  return bounds;
+}
+
+} // namespace ar
+
+#endif // _AR_POINTCLOUDQUANTIZATION_HPP
@@ -0,0 +1,94 @@
+#ifndef _AR_POINTCLOUDSTAGING_HPP
+#define _AR_POINTCLOUDSTAGING_HPP
+
+#include "common.hpp"
+#include <memory>
+#include <mutex>
+
+namespace ar
+{
+
+/*
+ * A fixed number of buffers producers can write the next points of a single point cloud into.
+ * A published buffer is handed to the renderer as a shared, caller-owned buffer (see <PointCloud::SetSharedPoints>)
+ * and becomes available again once the renderer uploaded or discarded it.
+ * This way each cloud never holds on to more than <NumBuffers> frames, and a steady stream doesn't allocate.
+ * Expects a single producer per point cloud.
+ */
+class PointCloudStaging : public std::enable_shared_from_this<PointCloudStaging>
+{
+public:
+
+  // one being filled, one waiting in the command queue and one being uploaded
+  static const size_t NumBuffers = 3;
+
+  // Gets a buffer with room for <numBytes>. Calling this again before <Publish> returns the same buffer.
+  // @return nullptr if all buffers are still in use by the renderer
+  void* Acquire(size_t numBytes, size_t numPoints, bool colored)
+  {
+    MutexLockGuard guard(_mutex);
+
+    if (_acquired == NumBuffers)
+    {
+      for (size_t i = 0; i < NumBuffers && _acquired == NumBuffers; i++)
+      {
+        if (!_buffers[i].inUse)
+          _acquired = i;
+      }
+
+      if (_acquired == NumBuffers)
+        return nullptr;
+    }
+
+    Buffer& buffer = _buffers[_acquired];
+    buffer.inUse = true;
+    buffer.numPoints = numPoints;
+    buffer.colored = colored;
+    if (buffer.data.size() < numBytes)
+      buffer.data.resize(numBytes);
+
+    return buffer.data.data();
+  }
+
+  // Takes the buffer returned by <Acquire>, the buffer is released again when the last copy of the returned pointer is gone
+  // @return nullptr if no buffer was acquired
+  SharedPtr<const void> Publish(size_t& numPoints, bool& colored)
+  {
+    MutexLockGuard guard(_mutex);
+
+    if (_acquired == NumBuffers)
+      return nullptr;
+
+    const size_t index = _acquired;
+    _acquired = NumBuffers;
+
+    numPoints = _buffers[index].numPoints;
+    colored = _buffers[index].colored;
+
+    // the deleter keeps the staging buffers alive while the renderer still uses one of them
+    SharedPtr<PointCloudStaging> self = shared_from_this();
+    return SharedPtr<const void>(_buffers[index].data.data(), [self, index](const void*)
+    {
+      MutexLockGuard guard(self->_mutex);
+      self->_buffers[index].inUse = false;
+    });
+  }
+
+private:
+
+  struct Buffer
+  {
+    Vector<unsigned char> data;
+    size_t numPoints = 0;
+    bool colored = false;
+    bool inUse = false;
+  };
+
+  std::mutex _mutex;
+  Buffer _buffers[NumBuffers];
+  size_t _acquired = NumBuffers; // buffer which is being filled, NumBuffers if there is none
+};
+
+} // namespace ar
+
+#endif // _AR_POINTCLOUDSTAGING_HPP
@@ -0,0 +1,114 @@
+#ifndef _AR_ROLLINGPOINTCLOUD_HPP
+#define _AR_ROLLINGPOINTCLOUD_HPP
+
+#include "pointcloud/PointCloud.hpp"
+#include "rendering/RingVertexBuffer.hpp"
+
+namespace ar
+{
+
+/*
+ * Point cloud which is grown by appending points instead of replacing all of them, like a map built from sensor frames.
+ * It holds at most <Capacity> points in a <RingVertexBuffer>; once it is full, the oldest points are replaced.
+ * Only the appended points are uploaded, so the cost per frame doesn't grow with the size of the cloud.
+ */
+template <typename VertexT>
+class RollingPointCloud : public BasePointCloud
+{
+public:
+
+  using VertexType = VertexT;
+
+  explicit RollingPointCloud(size_t capacity)
+    : _vertexBuffer(capacity)
+  { }
+
+  virtual void InitResource() override
+  {
+    _vertexBuffer.Init();
+  }
+
+  virtual void ReleaseResource() override
+  {
+    _vertexBuffer.Release();
+  }
+
+  size_t Capacity() const { return _vertexBuffer.Capacity(); }
+
+  // Queues <points> to be uploaded with the next <UpdateBuffer>
+  // If nothing is queued yet, <points> is swapped with the (empty) queue instead of copied.
+  void AppendPoints(Vector<VertexType>& points)
+  {
+    if (_pendingPoints.empty())
+      std::swap(_pendingPoints, points);
+    else
+      _pendingPoints.insert(_pendingPoints.end(), points.begin(), points.end());
+
+    // points which would be overwritten before they are uploaded don't need to be kept
+    if (_pendingPoints.size() > Capacity())
+      _pendingPoints.erase(_pendingPoints.begin(), _pendingPoints.end() - Capacity());
+
+    _dirty = true;
+  }
+
+  // Removes all points from the point cloud
+  void ClearPoints()
+  {
+    _pendingPoints.clear();
+    _vertexBuffer.ClearAll();
+    _bounds = Bounds();
+    _dirty = false;
+  }
+
+  virtual void UpdateBuffer() override
+  {
+    if (!_dirty)
+      return;
+
+    // points which are overwritten stay in the bounds, they only ever grow until the cloud is cleared
+    _bounds.Grow(PointBounds(_pendingPoints.data(), _pendingPoints.size()));
+    _vertexBuffer.AppendVertices(_pendingPoints.data(), _pendingPoints.size());
+    _pendingPoints.clear();
+    _dirty = false;
+  }
+
+  virtual GLuint GetVAO() override { return _vertexBuffer._vao; }
+
+  // rolling clouds always upload into their fixed buffer
+  virtual void SetStreaming(bool) override { }
+  virtual bool IsStreaming() const override { return false; }
+
+  virtual BasePointCloudOctree* GetOctree() override { return nullptr; }
+  virtual bool IsQuantized() const override { return false; }
+
+  virtual GLint FirstPoint() const override { return 0; }
+  virtual void FenceDraw() override { }
+
+  virtual bool ShouldDraw() const override { return _shouldDraw && NumPoints() > 0; }
+  virtual size_t NumPoints() const override { return _vertexBuffer.NumVertices(); }
+  virtual size_t VertexSize() const override { return sizeof(VertexType); }
+
+  virtual void RenderGUI() override
+  {
+    if (!ImGui::Begin(_name.c_str()))
+    {
+      ImGui::End();
+      return;
+    }
+
+    ImGui::Text("Num points: %d / %d", (int)NumPoints(), (int)Capacity());
+    renderVoxelFilterStats();
+    renderDrawSettings();
+
+    ImGui::End();
+  }
+
+private:
+
+  Vector<VertexType> _pendingPoints; // appended since the last upload
+  RingVertexBuffer<VertexType> _vertexBuffer;
+};
+
+} // namespace ar
+
+#endif // _AR_ROLLINGPOINTCLOUD_HPP
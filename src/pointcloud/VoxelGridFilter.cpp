@@ -0,0 +1,157 @@
+#include "VoxelGridFilter.hpp"
+#include "PointCloudIngest.hpp"
+
+#include <cmath>
+#include <unordered_map>
+
+namespace ar
+{
+
+namespace
+{
+  // points handled by one range of the pool
+  const size_t PointsPerRange = 64 * 1024;
+
+  // 21 bits per axis, cells beyond that range are merged into the outermost ones
+  const uint64_t InvalidKey = ~0ull;
+  const float MaxCell = (1 << 20) - 1;
+
+  uint64_t voxelKey(const GLfloat* position, float invLeafSize)
+  {
+    if (!(std::isfinite(position[0]) && std::isfinite(position[1]) && std::isfinite(position[2])))
+      return InvalidKey;
+
+    uint64_t key = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      const float cell = clamp(std::floor(position[axis] * invLeafSize), -MaxCell - 1.0f, MaxCell);
+      key |= static_cast<uint64_t>(static_cast<int64_t>(cell) + (1 << 20)) << (21 * axis);
+    }
+    return key;
+  }
+
+  // spreads the cells evenly over the partitions, neighboring cells have similar keys
+  size_t partitionOf(uint64_t key, size_t numPartitions)
+  {
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) % numPartitions;
+  }
+
+  struct Cell
+  {
+    double position[3] = { 0.0, 0.0, 0.0 };
+    uint32_t channels[4] = { 0, 0, 0, 0 };
+    uint32_t numPoints = 0;
+  };
+
+  void accumulate(Cell& cell, const VertexP4& point)
+  {
+    for (int axis = 0; axis < 3; axis++)
+      cell.position[axis] += point.position[axis];
+    cell.numPoints++;
+  }
+
+  void accumulate(Cell& cell, const Vertex_PCL_PointXYZRGBA& point)
+  {
+    for (int axis = 0; axis < 3; axis++)
+      cell.position[axis] += point.position[axis];
+    for (int channel = 0; channel < 4; channel++)
+      cell.channels[channel] += (point.color >> (8 * channel)) & 0xFF;
+    cell.numPoints++;
+  }
+
+  void average(const Cell& cell, VertexP4& out)
+  {
+    for (int axis = 0; axis < 3; axis++)
+      out.position[axis] = static_cast<GLfloat>(cell.position[axis] / cell.numPoints);
+    out.position[3] = 1.0f;
+  }
+
+  void average(const Cell& cell, VertexP3RGBA& out)
+  {
+    for (int axis = 0; axis < 3; axis++)
+      out.position[axis] = static_cast<GLfloat>(cell.position[axis] / cell.numPoints);
+
+    uint32_t color = 0;
+    for (int channel = 0; channel < 4; channel++)
+      color |= ((cell.channels[channel] + cell.numPoints / 2) / cell.numPoints) << (8 * channel);
+    out.color = SwizzleBGRA(color);
+  }
+
+  template <typename VertexT, typename OutT>
+  void filter(const VertexT* points, size_t numPoints, float leafSize, Vector<OutT>& out, WorkerPool* pool)
+  {
+    out.clear();
+    if (numPoints == 0)
+      return;
+
+    const size_t numRanges = (numPoints + PointsPerRange - 1) / PointsPerRange;
+    const size_t numThreads = pool != nullptr ? pool->NumThreads() + 1 : 1;
+
+    // 1. the cell of every point
+    Vector<uint64_t> keys(numPoints);
+    const float invLeafSize = 1.0f / leafSize;
+    auto computeKeys = [&](size_t range)
+    {
+      const size_t end = std::min((range + 1) * PointsPerRange, numPoints);
+      for (size_t i = range * PointsPerRange; i < end; i++)
+        keys[i] = voxelKey(points[i].position, invLeafSize);
+    };
+
+    // 2. every partition averages the points of its own cells, so no partition writes to another one's cells
+    const size_t numPartitions = std::min(numThreads, numRanges);
+    Vector<Vector<OutT>> partitionPoints(numPartitions);
+    auto averageCells = [&](size_t partition)
+    {
+      std::unordered_map<uint64_t, uint32_t> cellIndices;
+      Vector<Cell> cells;
+      for (size_t i = 0; i < numPoints; i++)
+      {
+        const uint64_t key = keys[i];
+        if (key == InvalidKey || partitionOf(key, numPartitions) != partition)
+          continue;
+
+        auto inserted = cellIndices.insert(std::make_pair(key, static_cast<uint32_t>(cells.size())));
+        if (inserted.second)
+          cells.emplace_back();
+        accumulate(cells[inserted.first->second], points[i]);
+      }
+
+      auto& result = partitionPoints[partition];
+      result.resize(cells.size());
+      for (size_t i = 0; i < cells.size(); i++)
+        average(cells[i], result[i]);
+    };
+
+    if (pool != nullptr)
+    {
+      pool->ParallelFor(numRanges, computeKeys);
+      pool->ParallelFor(numPartitions, averageCells);
+    }
+    else
+    {
+      for (size_t range = 0; range < numRanges; range++)
+        computeKeys(range);
+      averageCells(0);
+    }
+
+    size_t numOut = 0;
+    for (const auto& result : partitionPoints)
+      numOut += result.size();
+
+    out.reserve(numOut);
+    for (const auto& result : partitionPoints)
+      out.insert(out.end(), result.begin(), result.end());
+  }
+}
+
+void VoxelGridFilter(const VertexP4* points, size_t numPoints, float leafSize, Vector<VertexP4>& out, WorkerPool* pool)
+{
+  filter(points, numPoints, leafSize, out, pool);
+}
+
+void VoxelGridFilter(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, float leafSize, Vector<VertexP3RGBA>& out, WorkerPool* pool)
+{
+  filter(points, numPoints, leafSize, out, pool);
+}
+
+} // namespace ar
@@ -0,0 +1,27 @@
+#ifndef _AR_VOXELGRIDFILTER_HPP
+#define _AR_VOXELGRIDFILTER_HPP
+
+#include <cstddef>
+#include "common.hpp"
+#include "mesh/Vertex.hpp"
+#include "WorkerPool.hpp"
+
+namespace ar
+{
+
+// Downsamples a cloud to at most one point per cell of a voxel grid, at the average position and color
+// of the points in the cell. Points with invalid (NaN or infinite) positions are dropped.
+// The work is split over <pool>, the grid is aligned with the origin of the cloud's coordinate system.
+// @points    Points to downsample
+// @numPoints Number of points in <points>
+// @leafSize  Edge length of a grid cell
+// @out       Receives the downsampled points, its capacity is reused
+// @pool      Threads to run on besides the calling one, may be nullptr
+void VoxelGridFilter(const VertexP4* points, size_t numPoints, float leafSize, Vector<VertexP4>& out, WorkerPool* pool);
+
+// Colored version, the points are converted to the format colored clouds are stored in like <IngestPoints> does
+void VoxelGridFilter(const Vertex_PCL_PointXYZRGBA* points, size_t numPoints, float leafSize, Vector<VertexP3RGBA>& out, WorkerPool* pool);
+
+} // namespace ar
+
+#endif // _AR_VOXELGRIDFILTER_HPP
@@ -0,0 +1,214 @@
+#include "BatchedMeshRendering.hpp"
+#include "ShaderSources.g.hpp"
+
+namespace ar
+{
+
+BatchedMeshRenderer::BatchedMeshRenderer()
+{
+}
+
+void BatchedMeshRenderer::Init()
+{
+  Base::Init();
+
+  _shader.loadAndLink(ShaderSources::sh_batchedMesh_vert, ShaderSources::sh_batchedLit_frag);
+
+  // the object index is a second vertex buffer in the mesh VAO
+  glGenBuffers(1, &_objectIndexVbo);
+  GLStateCache::Get().BindVertexArray(_vertexBuffer._vao);
+  GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _objectIndexVbo);
+  glVertexAttribIPointer(ObjectIndexAttrib, 1, GL_UNSIGNED_INT, sizeof(GLuint), (const GLvoid*)0);
+  glEnableVertexAttribArray(ObjectIndexAttrib);
+  GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, 0);
+  GLStateCache::Get().BindVertexArray(0);
+
+  glGenBuffers(1, &_objectDataBuffer);
+  glGenTextures(1, &_objectDataTexture);
+  glBindBuffer(GL_TEXTURE_BUFFER, _objectDataBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, _objectDataTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _objectDataBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void BatchedMeshRenderer::Release()
+{
+  Base::Release();
+
+  GLStateCache::Get().DeleteBuffer(_objectIndexVbo);
+  GLStateCache::Get().DeleteBuffer(_objectDataBuffer);
+  glDeleteTextures(1, &_objectDataTexture);
+  _shader.destroy();
+}
+
+void BatchedMeshRenderer::Update()
+{
+  Base::Update();
+
+  // the object indices always cover the whole vertex buffer, so they grow and shrink with it
+  const size_t numVertices = _vertexBuffer._vertices.size();
+  _objectIndices.resize(numVertices);
+
+  GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _objectIndexVbo);
+  if (numVertices != _numBufferedObjectIndices)
+  {
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * numVertices, _objectIndices.data(), GL_DYNAMIC_DRAW);
+    _numBufferedObjectIndices = numVertices;
+  }
+  else if (!_dirtyObjectIndices.Empty())
+  {
+    for (const auto& range : _dirtyObjectIndices.Merge())
+      glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLuint) * range.offset, sizeof(GLuint) * range.size, &_objectIndices[range.offset]);
+  }
+  _dirtyObjectIndices.Clear();
+
+  // transforms are changed by commands without telling us, so all of them are sent every frame
+  _objectData.resize(_objects.size() * TexelsPerObject);
+  for (const auto& mesh : _meshes)
+  {
+    const GLuint slot = *_slots.Find(mesh->ID());
+    if (!_objects[slot].batched)
+      continue;
+
+    const glm::mat4 transform = mesh->GetTransform();
+    glm::vec4* texels = &_objectData[slot * TexelsPerObject];
+    texels[0] = transform[0];
+    texels[1] = transform[1];
+    texels[2] = transform[2];
+    texels[3] = transform[3];
+    texels[4] = _objects[slot].color;
+  }
+
+  if (!_objectData.empty())
+  {
+    glBindBuffer(GL_TEXTURE_BUFFER, _objectDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * _objectData.size(), _objectData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  }
+
+  _numDrawCalls = 0;
+  _numDrawnMeshes = 0;
+}
+
+void BatchedMeshRenderer::RenderPass(const SceneInfo& sceneInfo)
+{
+  _drawCounts.clear();
+  _drawOffsets.clear();
+  _drawBaseVertices.clear();
+
+  DrawState state;
+  for (const auto& item : _renderQueue.Items(sceneInfo.onlyOpaque))
+  {
+    const auto& m = _meshes[item.index];
+    _numDrawnMeshes++;
+
+    const GLuint slot = *_slots.Find(m->ID());
+    if (!_objects[slot].batched)
+    {
+      // transparent meshes are sorted back to front, the batched meshes before this one have to be drawn first
+      if (!sceneInfo.onlyOpaque && !_drawCounts.empty())
+      {
+        flushBatch(sceneInfo);
+        state = DrawState();
+      }
+
+      DrawMesh(*m, sceneInfo, state);
+      _numDrawCalls++;
+      continue;
+    }
+
+    _drawCounts.push_back(m->IndexCount());
+    _drawOffsets.push_back((const GLvoid*)(m->GetIndexOffset() * sizeof(GLuint)));
+    _drawBaseVertices.push_back(m->GetVertexOffset());
+  }
+
+  if (!_drawCounts.empty())
+    flushBatch(sceneInfo);
+}
+
+void BatchedMeshRenderer::flushBatch(const SceneInfo& sceneInfo)
+{
+  _shader.enable();
+
+  const glm::mat4 vp = sceneInfo.projectionMatrix * sceneInfo.viewMatrix;
+  glUniformMatrix4fv(_shader.getUniform("VP"), 1, GL_FALSE, &vp[0][0]);
+  glUniformMatrix4fv(_shader.getUniform("V"), 1, GL_FALSE, &(sceneInfo.viewMatrix[0][0]));
+  glUniform3fv(_shader.getUniform("light_dir"), 1, &(sceneInfo.lightDir[0]));
+  glUniform1i(_shader.getUniform("lightAlpha"), (int)sceneInfo.lightAlpha);
+  glUniform1i(_shader.getUniform("objects"), 0);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, _objectDataTexture);
+
+  GLStateCache::Get().BindVertexArray(_vertexBuffer._vao);
+  GLStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
+
+  glMultiDrawElementsBaseVertex(sceneInfo.renderType,
+                                _drawCounts.data(),
+                                GL_UNSIGNED_INT,
+                                _drawOffsets.data(),
+                                (GLsizei)_drawCounts.size(),
+                                _drawBaseVertices.data());
+
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  _numDrawCalls++;
+
+  _drawCounts.clear();
+  _drawOffsets.clear();
+  _drawBaseVertices.clear();
+}
+
+void BatchedMeshRenderer::MeshChanged(Mesh3D* mesh)
+{
+  const GLuint* slotPtr = _slots.Find(mesh->ID());
+  GLuint slot;
+  if (slotPtr != nullptr)
+  {
+    slot = *slotPtr;
+  }
+  else if (!_freeSlots.empty())
+  {
+    slot = _freeSlots.back();
+    _freeSlots.pop_back();
+    _slots.Set(mesh->ID(), slot);
+  }
+  else
+  {
+    slot = (GLuint)_objects.size();
+    _objects.emplace_back();
+    _slots.Set(mesh->ID(), slot);
+  }
+
+  // only flat colors with the default shader can be looked up by the batched shader
+  BatchedObject& object = _objects[slot];
+  const auto material = dynamic_cast<const FlatColorMaterial*>(mesh->GetMaterial().get());
+  object.batched = material != nullptr && mesh->GetShader() == _defaultShader;
+  if (material != nullptr)
+  {
+    const Color& color = material->GetColor();
+    object.color = glm::vec4(color.r, color.g, color.b, color.a);
+  }
+
+  // tag every vertex of the mesh with its slot
+  const size_t offset = mesh->GetVertexOffset();
+  const size_t numVertices = mesh->VertexCount();
+  if (_objectIndices.size() < offset + numVertices)
+    _objectIndices.resize(std::max(_vertexBuffer._vertices.size(), offset + numVertices));
+
+  std::fill(_objectIndices.begin() + offset, _objectIndices.begin() + offset + numVertices, slot);
+  _dirtyObjectIndices.Add(offset, numVertices);
+}
+
+void BatchedMeshRenderer::MeshRemoved(const Mesh3D* mesh)
+{
+  const GLuint* slot = _slots.Find(mesh->ID());
+  if (slot == nullptr)
+    return;
+
+  _objects[*slot].batched = false;
+  _freeSlots.push_back(*slot);
+  _slots.Erase(mesh->ID());
+}
+
+} // namespace ar
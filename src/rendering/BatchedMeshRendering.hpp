@@ -0,0 +1,85 @@
+#ifndef _ARBATCHEDMESH_RENDERING_HPP
+#define _ARBATCHEDMESH_RENDERING_HPP
+
+#include "RenderingCommon.hpp"
+#include "MeshRendering.hpp"
+#include "RangeAllocator.hpp"
+
+namespace ar
+{
+
+/*
+  Mesh renderer which draws all meshes using the default shader and a flat color
+  with one glMultiDrawElementsBaseVertex per pass.
+
+  Every mesh gets a slot in a buffer texture holding its model matrix and color.
+  Each vertex stores the slot of its mesh in an extra attribute, which the shader uses
+  to look up its object, since GL 3.3 has no draw ID.
+  Meshes with other shaders or materials are drawn one by one as before.
+  In the transparent pass such a mesh splits the batch, so all meshes stay in back to front order.
+*/
+class BatchedMeshRenderer : public MeshRenderer<Vertex3D>
+{
+  typedef MeshRenderer<Vertex3D> Base;
+
+public:
+
+  BatchedMeshRenderer();
+
+  virtual void Init() override;
+  virtual void Release() override;
+  virtual void Update() override;
+  virtual void RenderPass(const SceneInfo& sceneInfo) override;
+
+  // Draw calls issued for meshes in the last frame, and the number of meshes they drew
+  size_t NumDrawCalls() const { return _numDrawCalls; }
+  size_t NumDrawnMeshes() const { return _numDrawnMeshes; }
+
+protected:
+
+  virtual void MeshChanged(Mesh3D* mesh) override;
+  virtual void MeshRemoved(const Mesh3D* mesh) override;
+
+private:
+
+  // Draws the meshes collected in _drawCounts, _drawOffsets & _drawBaseVertices with one call and clears them
+  void flushBatch(const SceneInfo& sceneInfo);
+
+  static const GLuint ObjectIndexAttrib = 2; // follows the attributes of Vertex3D
+  static const size_t TexelsPerObject = 5;   // model matrix columns, color
+
+  struct BatchedObject
+  {
+    glm::vec4 color;
+    bool batched = false; // false if the mesh needs its own draw call
+  };
+
+  ShaderProgram _shader;
+
+  // slot of the object every vertex in the vertex buffer belongs to
+  GLuint _objectIndexVbo;
+  Vector<GLuint> _objectIndices;
+  DirtyRanges _dirtyObjectIndices;
+  size_t _numBufferedObjectIndices = 0;
+
+  // TexelsPerObject texels for every slot, read through a buffer texture
+  GLuint _objectDataBuffer;
+  GLuint _objectDataTexture;
+  Vector<glm::vec4> _objectData;
+
+  HandleMap<GLuint> _slots; // slot of every mesh
+  Vector<BatchedObject> _objects;
+  Vector<GLuint> _freeSlots;
+
+  // arguments of glMultiDrawElementsBaseVertex, reused every pass
+  Vector<GLsizei> _drawCounts;
+  Vector<const GLvoid*> _drawOffsets;
+  Vector<GLint> _drawBaseVertices;
+
+  size_t _numDrawCalls = 0;
+  size_t _numDrawnMeshes = 0;
+};
+
+} // namespace ar
+
+#endif // _ARBATCHEDMESH_RENDERING_HPP
@@ -0,0 +1,196 @@
+#ifndef _ARCULLING_HPP
+#define _ARCULLING_HPP
+
+#include "common.hpp"
+#include "rendering/Frustum.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <glm/glm.hpp>
+
+namespace ar
+{
+
+// Axis-aligned bounding box, empty as long as nothing was added to it
+struct Bounds
+{
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+  Bounds() = default;
+  Bounds(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) { }
+
+  bool Empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+  void Grow(const glm::vec3& p)
+  {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+
+  void Grow(const Bounds& other)
+  {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  // @return The box around this box after it was transformed by <m>
+  Bounds Transformed(const glm::mat4& m) const
+  {
+    if (Empty())
+      return *this;
+
+    const glm::vec3 center = glm::vec3(m * glm::vec4((min + max) * 0.5f, 1.0f));
+    const glm::vec3 halfSize = (max - min) * 0.5f;
+
+    // every axis of the box contributes the absolute value of its transformed length to each extent
+    glm::vec3 extent(0.0f);
+    for (int axis = 0; axis < 3; axis++)
+      extent += glm::abs(glm::vec3(m[axis])) * halfSize[axis];
+
+    return Bounds(center - extent, center + extent);
+  }
+};
+
+// @return The box around the positions of <points>, points with non-finite coordinates are left out
+template <typename VertexT>
+Bounds PointBounds(const VertexT* points, size_t numPoints)
+{
+  Bounds bounds;
+  for (size_t i = 0; i < numPoints; i++)
+  {
+    const glm::vec3 p(points[i].position[0], points[i].position[1], points[i].position[2]);
+    if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+      bounds.Grow(p);
+  }
+  return bounds;
+}
+
+/*
+ * World space bounds of all objects of a renderer, tested against the view frustum once per frame.
+ * The boxes are stored as centers and extents, one array per coordinate, so every plane is tested against all boxes
+ * in a loop without branches which the compiler can vectorize.
+ * Entries are kept parallel to the renderer's list of objects: <Remove> moves the last entry into the removed one's place,
+ * like the renderers do with their objects.
+ */
+class CullingSet
+{
+public:
+
+  size_t Size() const { return _visible.size(); }
+
+  // @return Index of the new entry
+  size_t Add(const Bounds& bounds)
+  {
+    _centerX.push_back(0.0f);
+    _centerY.push_back(0.0f);
+    _centerZ.push_back(0.0f);
+    _extentX.push_back(0.0f);
+    _extentY.push_back(0.0f);
+    _extentZ.push_back(0.0f);
+    _visible.push_back(1);
+    Set(Size() - 1, bounds);
+    return Size() - 1;
+  }
+
+  // Empty bounds are never visible
+  void Set(size_t index, const Bounds& bounds)
+  {
+    if (bounds.Empty())
+    {
+      _centerX[index] = _centerY[index] = _centerZ[index] = 0.0f;
+      _extentX[index] = _extentY[index] = _extentZ[index] = -std::numeric_limits<float>::max();
+      return;
+    }
+
+    const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    const glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+    _centerX[index] = center.x;
+    _centerY[index] = center.y;
+    _centerZ[index] = center.z;
+    _extentX[index] = extent.x;
+    _extentY[index] = extent.y;
+    _extentZ[index] = extent.z;
+  }
+
+  void Remove(size_t index)
+  {
+    removeAt(_centerX, index);
+    removeAt(_centerY, index);
+    removeAt(_centerZ, index);
+    removeAt(_extentX, index);
+    removeAt(_extentY, index);
+    removeAt(_extentZ, index);
+    removeAt(_visible, index);
+  }
+
+  void Clear()
+  {
+    _centerX.clear();
+    _centerY.clear();
+    _centerZ.clear();
+    _extentX.clear();
+    _extentY.clear();
+    _extentZ.clear();
+    _visible.clear();
+  }
+
+  // Tests all boxes against <frustum>, which must be in world space
+  // @return Number of boxes which are at least partly inside
+  size_t Cull(const Frustum& frustum)
+  {
+    const size_t n = Size();
+    std::fill(_visible.begin(), _visible.end(), 1);
+
+    const float* cx = _centerX.data();
+    const float* cy = _centerY.data();
+    const float* cz = _centerZ.data();
+    const float* ex = _extentX.data();
+    const float* ey = _extentY.data();
+    const float* ez = _extentZ.data();
+    unsigned char* visible = _visible.data();
+
+    for (const auto& plane : frustum.planes)
+    {
+      const glm::vec3 normal(plane);
+      const glm::vec3 absNormal = glm::abs(normal);
+
+      // a box is outside of the plane if its center is further away than its extent along the normal
+      for (size_t i = 0; i < n; i++)
+      {
+        const float distance = normal.x * cx[i] + normal.y * cy[i] + normal.z * cz[i] + plane.w;
+        const float radius = absNormal.x * ex[i] + absNormal.y * ey[i] + absNormal.z * ez[i];
+        visible[i] &= (unsigned char)(distance + radius >= 0.0f);
+      }
+    }
+
+    size_t numVisible = 0;
+    for (size_t i = 0; i < n; i++)
+      numVisible += visible[i];
+    return numVisible;
+  }
+
+  // @return False if the entry at <index> was outside of the frustum in the last <Cull>
+  bool Visible(size_t index) const { return _visible[index] != 0; }
+
+  // @return Center of the box at <index>
+  glm::vec3 Center(size_t index) const { return glm::vec3(_centerX[index], _centerY[index], _centerZ[index]); }
+
+private:
+
+  template <typename T>
+  static void removeAt(Vector<T>& values, size_t index)
+  {
+    values[index] = values.back();
+    values.pop_back();
+  }
+
+  Vector<float> _centerX, _centerY, _centerZ;
+  Vector<float> _extentX, _extentY, _extentZ;
+  Vector<unsigned char> _visible;
+};
+
+} // namespace ar
+
+#endif // _ARCULLING_HPP
@@ -0,0 +1,149 @@
+#include "DepthFrameRendering.hpp"
+#include "ShaderSources.g.hpp"
+
+#include <imgui.h>
+
+namespace ar
+{
+
+void DepthFrameRenderer::Init()
+{
+  _shader.loadAndLink(ShaderSources::sh_depthCloud_vert, ShaderSources::sh_flatShaded_frag);
+
+  // core profiles can't draw without a vertex array, even if it has no attributes
+  glGenVertexArrays(1, &_vao);
+
+  glGenTextures(1, &_depthTexture);
+  glGenTextures(1, &_colorTexture);
+  for (GLuint texture : { _depthTexture, _colorTexture })
+  {
+    // read with texelFetch, integer textures can't be filtered anyway
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void DepthFrameRenderer::Release()
+{
+  GLStateCache::Get().DeleteVertexArray(_vao);
+  glDeleteTextures(1, &_depthTexture);
+  glDeleteTextures(1, &_colorTexture);
+  _shader.destroy();
+}
+
+void DepthFrameRenderer::Update()
+{
+  if (!_newFrame)
+    return;
+
+  // storage is only reallocated when the size of the frames changes
+  const bool resize = _newWidth != _width || _newHeight != _height;
+  _width = _newWidth;
+  _height = _newHeight;
+  _colored = !_newColor.empty();
+
+  // rows of 16 bit / 24 bit pixels aren't 4 byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  glBindTexture(GL_TEXTURE_2D, _depthTexture);
+  if (resize)
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, _width, _height, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, _newDepth.data());
+  else
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _width, _height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, _newDepth.data());
+
+  if (_colored)
+  {
+    glBindTexture(GL_TEXTURE_2D, _colorTexture);
+    if (_colorWidth != _width || _colorHeight != _height)
+    {
+      _colorWidth = _width;
+      _colorHeight = _height;
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, _width, _height, 0, GL_RGB, GL_UNSIGNED_BYTE, _newColor.data());
+    }
+    else
+    {
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, _newColor.data());
+    }
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  _newFrame = false;
+}
+
+void DepthFrameRenderer::RenderPass(const SceneInfo& sceneInfo)
+{
+  // points are opaque, like the default material of point clouds
+  if (!sceneInfo.onlyOpaque || !_shouldDraw || _width == 0 || _height == 0)
+    return;
+
+  _shader.enable();
+
+  const glm::mat4 model(1.0f);
+  const glm::mat4 mvp = sceneInfo.projectionMatrix * sceneInfo.viewMatrix * model;
+  glUniformMatrix4fv(_shader.getUniform("MVP"), 1, GL_FALSE, &mvp[0][0]);
+  glUniformMatrix4fv(_shader.getUniform("M"), 1, GL_FALSE, &model[0][0]);
+  glUniform1f(_shader.getUniform("fadeDepth"), _fadeDepth);
+  glUniform4f(_shader.getUniform("color"), 1.0f, 1.0f, 1.0f, 1.0f);
+
+  glUniform1i(_shader.getUniform("width"), _width);
+  glUniform2fv(_shader.getUniform("focalLength"), 1, &_intrinsics.focalLength[0]);
+  glUniform2fv(_shader.getUniform("principalPoint"), 1, &_intrinsics.principalPoint[0]);
+  glUniform1f(_shader.getUniform("depthScale"), _intrinsics.depthScale);
+  glUniform1i(_shader.getUniform("colored"), _colored);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, _depthTexture);
+  glUniform1i(_shader.getUniform("depthTexture"), 0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, _colorTexture);
+  glUniform1i(_shader.getUniform("colorTexture"), 1);
+
+  GLStateCache::Get().SetPointSize(_pointSize);
+
+  GLStateCache::Get().BindVertexArray(_vao);
+  glDrawArrays(GL_POINTS, 0, _width * _height);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void DepthFrameRenderer::RenderGUI()
+{
+  if (_width == 0 || _height == 0)
+    return;
+
+  if (!ImGui::Begin("Depth Frame"))
+  {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Text("Size: %d x %d", (int)_width, (int)_height);
+  ImGui::Separator();
+  ImGui::PushItemWidth(-100);
+
+  ImGui::Checkbox("Draw", &_shouldDraw);
+  ImGui::SliderFloat("Fade Depth", &_fadeDepth, 1.0f, 10.0f);
+  ImGui::SliderFloat("Points Size", &_pointSize, 0.0f, 5.0f);
+
+  ImGui::End();
+}
+
+void DepthFrameRenderer::SetNewFrame(unsigned int width, unsigned int height, Vector<uint16_t>& depth, Vector<unsigned char>& color, const DepthIntrinsics& intrinsics)
+{
+  _newWidth = width;
+  _newHeight = height;
+  std::swap(_newDepth, depth);
+  std::swap(_newColor, color);
+  _intrinsics = intrinsics;
+  _newFrame = true;
+}
+
+} // namespace ar
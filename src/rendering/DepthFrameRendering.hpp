@@ -0,0 +1,75 @@
+#ifndef _ARDEPTHFRAME_RENDERING_HPP
+#define _ARDEPTHFRAME_RENDERING_HPP
+
+#include "RenderingCommon.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace ar
+{
+
+// Pinhole model of a depth sensor, from the same camera matrix <Camera::SetIntrinsics> takes
+struct DepthIntrinsics
+{
+  glm::vec2 focalLength = glm::vec2(1.0f);    // fx, fy in pixels
+  glm::vec2 principalPoint = glm::vec2(0.0f); // cx, cy in pixels
+  float depthScale = 0.001f;                  // meters per depth unit
+
+  DepthIntrinsics() = default;
+  DepthIntrinsics(const double cameraMatrix[3][3], float depthScale)
+    : focalLength(cameraMatrix[0][0], cameraMatrix[1][1]),
+      principalPoint(cameraMatrix[0][2], cameraMatrix[1][2]),
+      depthScale(depthScale)
+  { }
+};
+
+/*
+ * Draws the latest depth image as a point cloud.
+ * The raw depth image is uploaded as a texture and unprojected in the vertex shader, one point per pixel,
+ * so a frame costs 2 bytes per point to upload (5 with color) and no work on the CPU.
+ */
+class DepthFrameRenderer : public RenderComponent
+{
+public:
+
+  DepthFrameRenderer() = default;
+
+  virtual void Init() override;
+  virtual void Release() override;
+  virtual void Update() override;
+  virtual void RenderPass(const SceneInfo& sceneInfo) override;
+  virtual void RenderGUI() override;
+
+  // Replaces the current frame
+  // @depth  <width> * <height> depth values, 0 where there is no measurement
+  // @color  RGB24 image registered to the depth image, or empty
+  // NOTE: swaps out the depth and color vectors!
+  void SetNewFrame(unsigned int width, unsigned int height, Vector<uint16_t>& depth, Vector<unsigned char>& color, const DepthIntrinsics& intrinsics);
+
+private:
+
+  ShaderProgram _shader;
+  GLuint _vao = 0; // empty, the points are generated from gl_VertexID
+  GLuint _depthTexture = 0;
+  GLuint _colorTexture = 0;
+
+  unsigned int _width = 0, _height = 0;     // size of the depth texture
+  unsigned int _colorWidth = 0, _colorHeight = 0; // size of the color texture, it only gets storage with the first colored frame
+  bool _colored = false;
+  DepthIntrinsics _intrinsics;
+
+  // the frame waiting to be uploaded
+  unsigned int _newWidth = 0, _newHeight = 0;
+  Vector<uint16_t> _newDepth;
+  Vector<unsigned char> _newColor;
+  bool _newFrame = false;
+
+  bool _shouldDraw = true;
+  float _fadeDepth = 5.0f;
+  float _pointSize = 1.0f;
+};
+
+} // namespace ar
+
+#endif // _ARDEPTHFRAME_RENDERING_HPP
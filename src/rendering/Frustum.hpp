@@ -0,0 +1,51 @@
+#ifndef _ARFRUSTUM_HPP
+#define _ARFRUSTUM_HPP
+
+#include <glm/glm.hpp>
+
+namespace ar
+{
+
+/*
+ * The six clipping planes of a view volume, for culling objects before they are drawn.
+ * The planes are in the space the matrix transforms from, so with a model-view-projection matrix
+ * boxes can be tested in object space.
+ */
+struct Frustum
+{
+  glm::vec4 planes[6]; // xyz: normal pointing inwards, w: distance
+
+  explicit Frustum(const glm::mat4& m)
+  {
+    // rows of the matrix, glm matrices are column-major
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+      rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // bottom
+    planes[3] = rows[3] - rows[1]; // top
+    planes[4] = rows[3] + rows[2]; // near
+    planes[5] = rows[3] - rows[2]; // far
+  }
+
+  // @return False if the box between <min> and <max> is completely outside of the frustum
+  bool Intersects(const glm::vec3& min, const glm::vec3& max) const
+  {
+    for (const auto& plane : planes)
+    {
+      // corner of the box furthest along the plane normal
+      const glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x,
+                             plane.y >= 0.0f ? max.y : min.y,
+                             plane.z >= 0.0f ? max.z : min.z);
+      if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+        return false;
+    }
+    return true;
+  }
+};
+
+} // namespace ar
+
+#endif // _ARFRUSTUM_HPP
@@ -0,0 +1,228 @@
+#ifndef _AR_GLSTATECACHE_HPP
+#define _AR_GLSTATECACHE_HPP
+
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+
+namespace ar
+{
+
+/*
+ * Remembers the OpenGL state set on the current thread's context, so state which is already set isn't sent again
+ * and nothing has to be queried back from the driver.
+ * Every render thread has its own cache (see <Get>), all state it covers must be changed through it.
+ * Code which changes the state behind its back (like the GUI) has to call <Invalidate> afterwards.
+ *
+ * The element array buffer binding belongs to the vertex array object, so it is forgotten whenever the VAO changes.
+ */
+class GLStateCache
+{
+public:
+
+  // @return The cache of the calling thread
+  static GLStateCache& Get()
+  {
+    static thread_local GLStateCache cache;
+    return cache;
+  }
+
+  void UseProgram(GLuint program)
+  {
+    if (set(_program, program))
+      glUseProgram(program);
+  }
+
+  void BindVertexArray(GLuint vao)
+  {
+    if (set(_vertexArray, vao))
+    {
+      glBindVertexArray(vao);
+      _elementArrayBuffer = Unknown;
+    }
+  }
+
+  // Binds to GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER, other targets aren't cached
+  void BindBuffer(GLenum target, GLuint buffer)
+  {
+    GLuint* cached = target == GL_ARRAY_BUFFER ? &_arrayBuffer : target == GL_ELEMENT_ARRAY_BUFFER ? &_elementArrayBuffer : nullptr;
+    if (cached == nullptr || set(*cached, buffer))
+      glBindBuffer(target, buffer);
+  }
+
+  void SetBlend(bool enable)
+  {
+    if (set(_blend, enable ? 1 : 0))
+    {
+      if (enable)
+        glEnable(GL_BLEND);
+      else
+        glDisable(GL_BLEND);
+    }
+  }
+
+  void BlendFunc(GLenum source, GLenum destination)
+  {
+    const bool changed = _blendSource != source || _blendDestination != destination;
+    count(changed);
+    if (!changed)
+      return;
+
+    _blendSource = source;
+    _blendDestination = destination;
+    glBlendFunc(source, destination);
+  }
+
+  void SetDepthTest(bool enable)
+  {
+    if (set(_depthTest, enable ? 1 : 0))
+    {
+      if (enable)
+        glEnable(GL_DEPTH_TEST);
+      else
+        glDisable(GL_DEPTH_TEST);
+    }
+  }
+
+  void SetDepthMask(bool enable)
+  {
+    if (set(_depthMask, enable ? 1 : 0))
+      glDepthMask(enable ? GL_TRUE : GL_FALSE);
+  }
+
+  void SetPointSize(float size)
+  {
+    if (set(_pointSize, size))
+      glPointSize(size);
+  }
+
+  void SetViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+  {
+    const bool changed = _viewport[0] != x || _viewport[1] != y || _viewport[2] != width || _viewport[3] != height;
+    count(changed);
+    if (!changed)
+      return;
+
+    _viewport[0] = x;
+    _viewport[1] = y;
+    _viewport[2] = width;
+    _viewport[3] = height;
+    glViewport(x, y, width, height);
+  }
+
+  // The last viewport set through the cache, without asking the driver
+  const GLint* Viewport() const { return _viewport; }
+
+  // Deleted objects are unbound by OpenGL, and their names may be handed out again
+  void DeleteProgram(GLuint program)
+  {
+    if (_program == program)
+      _program = 0;
+    glDeleteProgram(program);
+  }
+
+  void DeleteVertexArray(GLuint vao)
+  {
+    if (_vertexArray == vao)
+    {
+      _vertexArray = 0;
+      _elementArrayBuffer = Unknown;
+    }
+    glDeleteVertexArrays(1, &vao);
+  }
+
+  void DeleteBuffer(GLuint buffer)
+  {
+    if (_arrayBuffer == buffer)
+      _arrayBuffer = 0;
+    if (_elementArrayBuffer == buffer)
+      _elementArrayBuffer = 0;
+    glDeleteBuffers(1, &buffer);
+  }
+
+  // Forgets all state, the next change of every state is sent to OpenGL again.
+  // The viewport is kept, code which changes it has to restore it.
+  void Invalidate()
+  {
+    _program = Unknown;
+    _vertexArray = Unknown;
+    _arrayBuffer = Unknown;
+    _elementArrayBuffer = Unknown;
+    _blend = -1;
+    _blendSource = Unknown;
+    _blendDestination = Unknown;
+    _depthTest = -1;
+    _depthMask = -1;
+    _pointSize = -1.0f;
+  }
+
+  // Starts counting the calls of the next frame
+  void EndFrame()
+  {
+    _numIssuedLastFrame = _numIssued;
+    _numSkippedLastFrame = _numSkipped;
+    _numIssued = 0;
+    _numSkipped = 0;
+  }
+
+  // Number of state changes sent to OpenGL during the last frame
+  size_t NumIssuedCalls() const { return _numIssuedLastFrame; }
+  // Number of state changes which were dropped during the last frame because the state was set already
+  size_t NumSkippedCalls() const { return _numSkippedLastFrame; }
+
+private:
+
+  static const GLuint Unknown = ~0u;
+
+  GLStateCache()
+  {
+    for (auto& value : _viewport)
+      value = -1;
+    Invalidate();
+  }
+
+  GLStateCache(const GLStateCache&) = delete;
+  GLStateCache& operator=(const GLStateCache&) = delete;
+
+  // @return True if <value> differs from <cached>, which is updated then
+  template <typename T>
+  bool set(T& cached, T value)
+  {
+    const bool changed = cached != value;
+    cached = value;
+    count(changed);
+    return changed;
+  }
+
+  void count(bool changed)
+  {
+    if (changed)
+      _numIssued++;
+    else
+      _numSkipped++;
+  }
+
+  GLuint _program;
+  GLuint _vertexArray;
+  GLuint _arrayBuffer;
+  GLuint _elementArrayBuffer; // of _vertexArray
+  int _blend;
+  GLenum _blendSource;
+  GLenum _blendDestination;
+  int _depthTest;
+  int _depthMask;
+  float _pointSize;
+  GLint _viewport[4];
+
+  size_t _numIssued = 0;
+  size_t _numSkipped = 0;
+  size_t _numIssuedLastFrame = 0;
+  size_t _numSkippedLastFrame = 0;
+};
+
+} // namespace ar
+
+#endif // _AR_GLSTATECACHE_HPP
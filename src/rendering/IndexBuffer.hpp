@@ -4,6 +4,8 @@
 #include "common.hpp"
 #include "RenderResource.hpp"
 #include "RenderDefinitions.hpp"
+#include "GLStateCache.hpp"
+#include "RangeAllocator.hpp"
 
 #ifndef GL_GLEXT_PROTOTYPES
 #define GL_GLEXT_PROTOTYPES
@@ -38,7 +40,7 @@ public:
 
   virtual void ReleaseResource() override
   {
-    glDeleteBuffers(1, &_vio);
+    GLStateCache::Get().DeleteBuffer(_vio);
   }
 
   int AddIndices(const Vector<GLuint>& indices)
@@ -47,6 +49,7 @@ public:
 
     // append new indices to the end of our existing list
     _indices.insert(std::end(_indices), std::begin(indices), std::end(indices));
+    _ranges.Extend(indices.size());
     _dirty = true;
 
     return (int)offset;
@@ -55,27 +58,71 @@ public:
   void SetIndices(const Vector<GLuint>& indices)
   {
     _indices = indices;
+    _ranges.Reset(_indices.size(), _indices.size());
     _dirty = true;
   }
 
+  // Copies <numIndices> indices into a free range of the buffer, the buffer grows if there is none
+  // Returns the offset to the first new index
+  int AllocIndices(const GLuint* indices, size_t numIndices)
+  {
+    size_t offset = _ranges.Allocate(numIndices);
+    if (offset == RangeAllocator::NoRange)
+    {
+      _ranges.Grow(std::max(_ranges.Capacity() * 2, _ranges.Capacity() + numIndices));
+      _indices.resize(_ranges.Capacity());
+      offset = _ranges.Allocate(numIndices);
+      _dirty = true;
+    }
+
+    WriteIndices(offset, indices, numIndices);
+    return (int)offset;
+  }
+
+  // Overwrites <numIndices> indices starting at <offset>, which must be part of an allocated range
+  void WriteIndices(size_t offset, const GLuint* indices, size_t numIndices)
+  {
+    std::copy(indices, indices + numIndices, _indices.begin() + offset);
+    _dirtyRanges.Add(offset, numIndices);
+  }
+
+  // Gives back a range handed out by <AllocIndices>
+  void FreeIndices(size_t offset, size_t numIndices)
+  {
+    _ranges.Free(offset, numIndices);
+  }
+
+  size_t NumFreeIndices() const { return _ranges.NumFree(); }
+  size_t NumUsedIndices() const { return _ranges.NumUsed(); }
+
   virtual void BufferData() override
   {
     if (!_initialized)
       throw std::runtime_error("The index buffer was not initialized.");
 
-    if (!_dirty)
+    if (!_dirty && _dirtyRanges.Empty())
       return;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vio);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * _indices.size(), &_indices[0], GetGLUsage(_usage));
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
+    GLStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vio);
+    if (_dirty)
+    {
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * _indices.size(), _indices.data(), GetGLUsage(_usage));
+    }
+    else
+    {
+      for (const auto& range : _dirtyRanges.Merge())
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * range.offset, sizeof(GLuint) * range.size, &_indices[range.offset]);
+    }
+
+    _dirtyRanges.Clear();
     _dirty = false;
   }
 
   void ClearAll()
   {
     _indices.clear();
+    _ranges.Reset(0);
+    _dirtyRanges.Clear();
 
     _dirty = true;
   }
@@ -84,6 +131,8 @@ public:
   BufferUsage _usage = BufferUsage::Static;
   GLuint _vio;
   Vector<GLuint> _indices;
+  RangeAllocator _ranges;     // which of <_indices> are in use
+  DirtyRanges _dirtyRanges;   // ranges of <_indices> to upload with the next BufferData
 };
 
 } // namespace ar
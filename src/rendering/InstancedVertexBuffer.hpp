@@ -3,6 +3,7 @@
 
 #include "common.hpp"
 #include "VertexBuffer.hpp"
+#include "RangeAllocator.hpp"
 
 namespace ar
 {
@@ -23,34 +24,35 @@ public:
     // instance buffer
     glGenBuffers(1, &_ibo);
 
-    glBindVertexArray(Base::_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, Base::_vbo);
+    GLStateCache::Get().BindVertexArray(Base::_vao);
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, Base::_vbo);
 
     // tell OpenGL about our vertex format
     auto numVertexAttribs = VertexT::EnableVertexAttribArray(0);
+    _numVertexAttribs = numVertexAttribs;
 
     // set vertex format for instance buffer
-    glBindBuffer(GL_ARRAY_BUFFER, _ibo);
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _ibo);
     auto numInstaceAttribs = InstanceT::EnableVertexAttribArray(numVertexAttribs);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, 0);
 
     for (GLuint i = 0; i < numVertexAttribs; i++)
     {
       glVertexAttribDivisor(i, 0); // attributes per draw call (mesh vertices etc.)
     }
-    for (GLuint i = numVertexAttribs; i < numInstaceAttribs + numInstaceAttribs; i++)
+    for (GLuint i = numVertexAttribs; i < numVertexAttribs + numInstaceAttribs; i++)
     {
       glVertexAttribDivisor(i, 1); // attributes per instance
     }
 
     // reset GL state
-    glBindVertexArray(0);
+    GLStateCache::Get().BindVertexArray(0);
   }
 
   virtual void ReleaseResource() override
   {
     Base::ReleaseResource();
-    glDeleteBuffers(1, &_ibo);
+    GLStateCache::Get().DeleteBuffer(_ibo);
   }
 
   void SetInstances(Vector<InstanceT> instances)
@@ -65,6 +67,30 @@ public:
     _dirtyInstances = true;
   }
 
+  // Adds one instance behind the others
+  // @return Index of the new instance
+  size_t AddInstance(const InstanceT& instance)
+  {
+    _instances.push_back(instance);
+    _dirtyInstanceRanges.Add(_instances.size() - 1, 1);
+    return _instances.size() - 1;
+  }
+
+  // Overwrites a single instance, only this instance is uploaded with the next <BufferData>
+  void SetInstance(size_t index, const InstanceT& instance)
+  {
+    _instances[index] = instance;
+    _dirtyInstanceRanges.Add(index, 1);
+  }
+
+  // Removes an instance by moving the last instance into its place
+  void RemoveInstance(size_t index)
+  {
+    if (index + 1 < _instances.size())
+      SetInstance(index, _instances.back());
+    _instances.pop_back();
+  }
+
   virtual void ClearAll() override
   {
     Base::ClearAll();
@@ -81,20 +107,54 @@ public:
   {
     Base::BufferData();
 
-    if (!_dirtyInstances)
+    if (!_dirtyInstances && _dirtyInstanceRanges.Empty())
       return;
 
-    glBindBuffer(GL_ARRAY_BUFFER, _ibo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceT) * _instances.size(), &_instances[0], GetGLUsage(Base::_usage));
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _ibo);
+    if (_dirtyInstances)
+    {
+      glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceT) * _instances.size(), _instances.data(), GetGLUsage(Base::_usage));
+      _instanceCapacity = _instances.size();
+    }
+    else if (_instances.size() > _instanceCapacity)
+    {
+      // grow the storage along with the vector, so adding instances one by one doesn't reallocate every time
+      _instanceCapacity = _instances.capacity();
+      glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceT) * _instanceCapacity, nullptr, GetGLUsage(Base::_usage));
+      glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceT) * _instances.size(), _instances.data());
+    }
+    else
+    {
+      for (const auto& range : _dirtyInstanceRanges.Merge())
+      {
+        // instances behind the end were removed meanwhile
+        if (range.offset >= _instances.size())
+          continue;
+        const size_t size = std::min(range.size, _instances.size() - range.offset);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(InstanceT) * range.offset, sizeof(InstanceT) * size, &_instances[range.offset]);
+      }
+    }
 
+    _dirtyInstanceRanges.Clear();
     _dirtyInstances = false;
   }
 
+  // Makes the next instanced draw start at instance <firstInstance> instead of the first one.
+  // Drawing with a base instance needs GL 4.2, so the instance attributes are moved instead.
+  // Requires an <InstanceT> whose EnableVertexAttribArray takes a buffer offset; the vertex array has to be bound.
+  void SetFirstInstance(size_t firstInstance)
+  {
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _ibo);
+    InstanceT::EnableVertexAttribArray(_numVertexAttribs, firstInstance * sizeof(InstanceT));
+  }
+
   inline size_t InstanceCount() const { return _instances.size(); }
 
   bool _dirtyInstances = false;
+  DirtyRanges _dirtyInstanceRanges; // instances written since the last upload, unless all of them are dirty
+  size_t _instanceCapacity = 0;     // number of instances the instance buffer has room for
   GLuint _ibo;  // instance buffer
+  GLuint _numVertexAttribs = 0; // instance attributes follow the vertex attributes
   Vector<InstanceT> _instances;
 };
 
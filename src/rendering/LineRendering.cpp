@@ -24,32 +24,30 @@ void LineRenderer::RenderPass(const SceneInfo& sceneInfo)
   glUniform1f(_shader.getUniform("nearPlane"), sceneInfo.nearClip);
   glUniform1f(_shader.getUniform("aspect"), sceneInfo.aspect);
 
-  for (const auto& m : _meshes)
+  // all lines share the shader, opaque lines are sorted by material
+  const Material* currentMaterial = nullptr;
+  for (const auto& item : _renderQueue.Items(sceneInfo.onlyOpaque))
   {
-    if (!sceneInfo.shouldDraw(m->ID()))
-      continue;
-    else if (m->GetMaterial()->GetOpaque() != sceneInfo.onlyOpaque)
-      continue;
-
-    const LineMesh* mesh = static_cast<LineMesh*>(m.get());
+    const LineMesh* mesh = static_cast<LineMesh*>(_meshes[item.index].get());
 
     const glm::mat4 mv = sceneInfo.viewMatrix * mesh->GetTransform();
     glUniformMatrix4fv(_shader.getUniform("MV"), 1, GL_FALSE, &mv[0][0]);
     glUniform1f(_shader.getUniform("lineThickness"), mesh->GetThickness());
 
-    mesh->GetMaterial()->Apply();
+    if (mesh->GetMaterial().get() != currentMaterial)
+    {
+      mesh->GetMaterial()->Apply();
+      currentMaterial = mesh->GetMaterial().get();
+    }
 
-    glBindVertexArray(_vertexBuffer._vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
+    GLStateCache::Get().BindVertexArray(_vertexBuffer._vao);
+    GLStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
 
     glDrawElementsBaseVertex(sceneInfo.renderType,
                              mesh->IndexCount(),
                              GL_UNSIGNED_INT,
                              (void*)(mesh->GetIndexOffset() * sizeof(GLuint)),
                              mesh->GetVertexOffset());
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
   }
 }
 
@@ -3,6 +3,9 @@
 namespace ar
 {
 
+template <typename VertexT>
+const size_t MeshRenderer<VertexT>::MinCompactionSize;
+
 template <typename VertexT>
 MeshRenderer<VertexT>::MeshRenderer()
 {
@@ -25,133 +28,229 @@ void MeshRenderer<VertexT>::Release()
 template <typename VertexT>
 void MeshRenderer<VertexT>::Update()
 {
-  if (_vertexBufferNeedsRebuild)
-  {
-    _vertexBuffer.ClearAll();
-    _indexBuffer.ClearAll();
+  // Meshes are added, updated and removed in place, so after many removals most of the buffers can be holes.
+  // Only then are all meshes packed to the front again, which uploads the whole buffers once.
+  const bool verticesFragmented = _vertexBuffer.NumFreeVertices() > std::max(_vertexBuffer.NumUsedVertices(), MinCompactionSize);
+  const bool indicesFragmented = _indexBuffer.NumFreeIndices() > std::max(_indexBuffer.NumUsedIndices(), MinCompactionSize);
+  if (verticesFragmented || indicesFragmented)
+    Compact();
 
-    for (auto& mesh : _meshes)
-    {
-      mesh->SetVertexOffset(_vertexBuffer.AddVertices(mesh->GetVertices()));
-      mesh->SetIndexOffset(_indexBuffer.AddIndices(mesh->GetIndices()));
-      mesh->ClearDirty();
-    }
+  _vertexBuffer.BufferData();
+  _indexBuffer.BufferData();
+}
+
+template <typename VertexT>
+void MeshRenderer<VertexT>::Compact()
+{
+  _vertexBuffer.ClearAll();
+  _indexBuffer.ClearAll();
 
-    _vertexBufferNeedsRebuild = false;
+  for (auto& mesh : _meshes)
+  {
+    mesh->SetVertexOffset(_vertexBuffer.AddVertices(mesh->GetVertices()));
+    mesh->SetIndexOffset(_indexBuffer.AddIndices(mesh->GetIndices()));
+    mesh->ClearDirty();
+    MeshChanged(mesh.get());
   }
+}
 
-  _vertexBuffer.BufferData();
-  _indexBuffer.BufferData();
+template <typename VertexT>
+void MeshRenderer<VertexT>::AllocMesh(Mesh<VertexT>* mesh)
+{
+  const auto& vertices = mesh->GetVertices();
+  const auto& indices = mesh->GetIndices();
+  mesh->SetVertexOffset(_vertexBuffer.AllocVertices(vertices.data(), vertices.size()));
+  mesh->SetIndexOffset(_indexBuffer.AllocIndices(indices.data(), indices.size()));
+  mesh->ClearDirty();
+  MeshChanged(mesh);
 }
 
 template <typename VertexT>
-void MeshRenderer<VertexT>::RenderPass(const SceneInfo& sceneInfo)
+void MeshRenderer<VertexT>::FreeMesh(const Mesh<VertexT>* mesh)
+{
+  _vertexBuffer.FreeVertices(mesh->GetVertexOffset(), mesh->VertexCount());
+  _indexBuffer.FreeIndices(mesh->GetIndexOffset(), mesh->IndexCount());
+}
+
+template <typename VertexT>
+void MeshRenderer<VertexT>::UpdateBounds(Mesh<VertexT>* mesh)
+{
+  const auto& vertices = mesh->GetVertices();
+  mesh->SetBounds(PointBounds(vertices.data(), vertices.size()));
+}
+
+template <typename VertexT>
+void MeshRenderer<VertexT>::BuildRenderQueue(const SceneInfo& sceneInfo)
 {
-  for (auto& m : _meshes)
+  const Frustum frustum(sceneInfo.projectionMatrix * sceneInfo.viewMatrix);
+  _numCulledMeshes = _meshes.size() - _culling.Cull(frustum);
+
+  _renderQueue.Clear();
+  for (size_t i = 0; i < _meshes.size(); i++)
   {
-    if (!sceneInfo.shouldDraw(m->ID()))
-      continue;
-    else if (m->GetMaterial()->GetOpaque() != sceneInfo.onlyOpaque)
+    const auto& m = _meshes[i];
+    if (!_culling.Visible(i) || !sceneInfo.shouldDraw(m->ID()))
       continue;
 
-    const auto& shader = m->GetShader();
+    const auto& material = m->GetMaterial();
+    if (material->GetOpaque())
+      _renderQueue.AddOpaque(i, m->GetShader(), material.get());
+    else
+      _renderQueue.AddTransparent(i, RenderQueue::ViewDepth(sceneInfo.viewMatrix, _culling.Center(i)));
+  }
+  _renderQueue.Sort();
+}
+
+template <typename VertexT>
+void MeshRenderer<VertexT>::RenderPass(const SceneInfo& sceneInfo)
+{
+  DrawState state;
+  for (const auto& item : _renderQueue.Items(sceneInfo.onlyOpaque))
+    DrawMesh(*_meshes[item.index], sceneInfo, state);
+}
+
+template <typename VertexT>
+void MeshRenderer<VertexT>::DrawMesh(const Mesh<VertexT>& m, const SceneInfo& sceneInfo, DrawState& state)
+{
+  const auto& shader = m.GetShader();
+  if (shader != state.shader)
+  {
     shader->enable();
 
     // uniforms global to all objects
-    glUniformMatrix4fv(shader->getUniform("M"), 1, GL_FALSE, &(m->GetTransform()[0][0]));
     glUniformMatrix4fv(shader->getUniform("V"), 1, GL_FALSE, &(sceneInfo.viewMatrix[0][0]));
     glUniform3fv(shader->getUniform("light_dir"), 1, &(sceneInfo.lightDir[0]));
-
     glUniform1i(shader->getUniform("lightAlpha"), (int)sceneInfo.lightAlpha);
 
-    // object-specific uniforms
-    glm::mat4 mvp = sceneInfo.projectionMatrix * sceneInfo.viewMatrix * m->GetTransform();
-    glUniformMatrix4fv(shader->getUniform("MVP"), 1, GL_FALSE, &mvp[0][0]);
-    m->GetMaterial()->Apply();
-
-    glBindVertexArray(_vertexBuffer._vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
+    state.shader = shader;
+    state.material = nullptr;
+  }
 
-    glDrawElementsBaseVertex(sceneInfo.renderType,
-                             m->IndexCount(),
-                             GL_UNSIGNED_INT,
-                             (void*)(m->GetIndexOffset() * sizeof(GLuint)),
-                             m->GetVertexOffset());
+  // object-specific uniforms
+  glUniformMatrix4fv(shader->getUniform("M"), 1, GL_FALSE, &(m.GetTransform()[0][0]));
+  glm::mat4 mvp = sceneInfo.projectionMatrix * sceneInfo.viewMatrix * m.GetTransform();
+  glUniformMatrix4fv(shader->getUniform("MVP"), 1, GL_FALSE, &mvp[0][0]);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+  if (m.GetMaterial().get() != state.material)
+  {
+    m.GetMaterial()->Apply();
+    state.material = m.GetMaterial().get();
   }
+
+  GLStateCache::Get().BindVertexArray(_vertexBuffer._vao);
+  GLStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
+
+  glDrawElementsBaseVertex(sceneInfo.renderType,
+                           m.IndexCount(),
+                           GL_UNSIGNED_INT,
+                           (void*)(m.GetIndexOffset() * sizeof(GLuint)),
+                           m.GetVertexOffset());
 }
 
 template <typename VertexT>
 void MeshRenderer<VertexT>::AddMesh(Mesh<VertexT>* mesh)
 {
   mesh->SetShader(_defaultShader);
-
-  if (_removedMesh)
-  {
-    _removedMesh = false;
-    _vertexBufferNeedsRebuild = true;
-  }
-  else
-  {
-    mesh->SetVertexOffset(_vertexBuffer.AddVertices(mesh->GetVertices()));
-    mesh->SetIndexOffset(_indexBuffer.AddIndices(mesh->GetIndices()));
-    mesh->ClearDirty();
-  }
+  UpdateBounds(mesh);
+  AllocMesh(mesh);
 
   _meshes.emplace_back(mesh);
-  _handleIndexMap[mesh->ID()] = _meshes.size() - 1;
+  _handleIndexMap.Set(mesh->ID(), _meshes.size() - 1);
+  _culling.Add(mesh->GetBounds().Transformed(mesh->GetTransform()));
 }
 
 template <typename VertexT>
-void MeshRenderer<VertexT>::RemoveMesh(unsigned int handle)
+bool MeshRenderer<VertexT>::RemoveMesh(unsigned int handle)
 {
-  if (_handleIndexMap.find(handle) == _handleIndexMap.end())
-    return;
+  const size_t* indexPtr = _handleIndexMap.Find(handle);
+  if (indexPtr == nullptr)
+    return false;
 
-  const auto index = _handleIndexMap[handle];
-  _handleIndexMap[_meshes.back()->ID()] = index;
-  _handleIndexMap.erase(handle);
+  const auto index = *indexPtr;
+  MeshRemoved(_meshes[index].get());
+  FreeMesh(_meshes[index].get());
+  _handleIndexMap.Set(_meshes.back()->ID(), index);
+  _handleIndexMap.Erase(handle);
 
   // Swap with end of meshes list
   std::swap(_meshes[index], _meshes.back());
   _meshes.pop_back();
+  _culling.Remove(index);
 
-  // Don't rebuild the vertex buffer just yet, only when we add a new mesh
-  _removedMesh = true;
+  return true;
 }
 
 template <typename VertexT>
 void MeshRenderer<VertexT>::RemoveAllMeshes()
 {
+  for (auto& mesh : _meshes)
+    MeshRemoved(mesh.get());
+
   _meshes.clear();
-  _handleIndexMap.clear();
+  _handleIndexMap.Clear();
+  _culling.Clear();
 
-  _removedMesh = true;
+  _vertexBuffer.ClearAll();
+  _indexBuffer.ClearAll();
 }
 
 template <typename VertexT>
 void MeshRenderer<VertexT>::UpdateMesh(unsigned int handle, Mesh<VertexT>* mesh)
 {
-  if (_handleIndexMap.find(handle) == _handleIndexMap.end())
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
+  {
+    delete mesh;
     return;
+  }
 
   mesh->SetShader(_defaultShader);
   mesh->SetID(handle);
+  UpdateBounds(mesh);
 
-  _meshes[_handleIndexMap[handle]] = UniquePtr<Mesh<VertexT>>(mesh);
-  _vertexBufferNeedsRebuild = true;
+  auto& oldMesh = _meshes[*index];
+  if (mesh->VertexCount() == oldMesh->VertexCount() && mesh->IndexCount() == oldMesh->IndexCount())
+  {
+    // same size, overwrite the old mesh's ranges
+    const auto& vertices = mesh->GetVertices();
+    const auto& indices = mesh->GetIndices();
+    _vertexBuffer.WriteVertices(oldMesh->GetVertexOffset(), vertices.data(), vertices.size());
+    _indexBuffer.WriteIndices(oldMesh->GetIndexOffset(), indices.data(), indices.size());
+    mesh->SetVertexOffset(oldMesh->GetVertexOffset());
+    mesh->SetIndexOffset(oldMesh->GetIndexOffset());
+    mesh->ClearDirty();
+    MeshChanged(mesh);
+  }
+  else
+  {
+    FreeMesh(oldMesh.get());
+    AllocMesh(mesh);
+  }
+
+  oldMesh = UniquePtr<Mesh<VertexT>>(mesh);
+  _culling.Set(*index, mesh->GetBounds().Transformed(mesh->GetTransform()));
 }
 
 template <typename VertexT>
 void MeshRenderer<VertexT>::SetMeshTransform(unsigned int handle, const glm::mat4& transform, bool absolute)
 {
-  if (_handleIndexMap.find(handle) == _handleIndexMap.end())
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
     return;
 
-  auto& mesh = _meshes[_handleIndexMap[handle]];
+  auto& mesh = _meshes[*index];
   mesh->SetTransform(absolute ? transform : transform * mesh->GetTransform());
+  _culling.Set(*index, mesh->GetBounds().Transformed(mesh->GetTransform()));
+}
+
+template <typename VertexT>
+Vector<unsigned int> MeshRenderer<VertexT>::Handles() const
+{
+  Vector<unsigned int> handles;
+  handles.reserve(_meshes.size());
+  for (auto& mesh : _meshes)
+    handles.push_back(mesh->ID());
+  return handles;
 }
 
 template class MeshRenderer<Vertex3D>;
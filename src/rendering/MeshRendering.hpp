@@ -4,8 +4,10 @@
 #include "RenderingCommon.hpp"
 #include "mesh/Mesh.hpp"
 #include "mesh/Vertex.hpp"
+#include "HandleTable.hpp"
+#include "Culling.hpp"
+#include "RenderQueue.hpp"
 #include <glm/glm.hpp>
-#include <unordered_map>
 
 namespace ar
 {
@@ -28,26 +30,71 @@ public:
   virtual void RenderPass(const SceneInfo& sceneInfo) override;
 
   void AddMesh(Mesh<VertexT>* mesh);
-  void RemoveMesh(unsigned int handle);
+  // @return False if there was no mesh for <handle>
+  bool RemoveMesh(unsigned int handle);
   void RemoveAllMeshes();
   void UpdateMesh(unsigned int handle, Mesh<VertexT>* mesh);
 
   void SetMeshTransform(unsigned int handle, const glm::mat4& transform, bool absolute);
 
+  // Handles of all meshes currently in the scene
+  Vector<unsigned int> Handles() const;
+
+  // Tests all meshes against the view frustum and sorts the ones which are drawn into the opaque and transparent pass.
+  // Call once per frame, before the render passes.
+  void BuildRenderQueue(const SceneInfo& sceneInfo);
+
+  // Meshes in the scene, and how many of them were outside of the view frustum in the last frame
+  size_t NumMeshes() const { return _meshes.size(); }
+  size_t NumCulledMeshes() const { return _numCulledMeshes; }
+
   inline void SetDefaultShader(ShaderProgram* shader) { _defaultShader = shader; }
 
 protected:
 
+  // Buffers are only compacted once they have more free elements than this
+  static const size_t MinCompactionSize = 64 * 1024;
+
+  // Copies the mesh's vertices and indices into free ranges of the buffers
+  void AllocMesh(Mesh<VertexT>* mesh);
+  // Gives back the ranges of a mesh which was passed to <AllocMesh>
+  void FreeMesh(const Mesh<VertexT>* mesh);
+  // Packs all meshes to the start of the buffers
+  void Compact();
+
+  // Computes the mesh's bounds from its vertices
+  void UpdateBounds(Mesh<VertexT>* mesh);
+
+  // Shader and material set up by the last <DrawMesh> of a pass
+  struct DrawState
+  {
+    const ShaderProgram* shader = nullptr;
+    const Material* material = nullptr;
+  };
+
+  // Draws a single mesh with its own shader and material, which are only set up if they differ from <state>
+  void DrawMesh(const Mesh<VertexT>& mesh, const SceneInfo& sceneInfo, DrawState& state);
+
+  // Called after a mesh was added, replaced or moved to other ranges of the buffers
+  virtual void MeshChanged(Mesh<VertexT>* mesh) { }
+  // Called before a mesh is removed
+  virtual void MeshRemoved(const Mesh<VertexT>* mesh) { }
+
   ShaderProgram* _defaultShader;
 
   GenericVertexBuffer<VertexT> _vertexBuffer;
   GenericIndexBuffer _indexBuffer;
   Vector<UniquePtr<Mesh<VertexT>>> _meshes;
 
-  std::unordered_map<unsigned int, size_t> _handleIndexMap;
+  // index into _meshes for every handle
+  HandleMap<size_t> _handleIndexMap;
+
+  // world space bounds of every mesh, in the order of _meshes
+  CullingSet _culling;
+  size_t _numCulledMeshes = 0;
 
-  bool _vertexBufferNeedsRebuild = false;
-  bool _removedMesh = false;
+  // meshes drawn in this frame, see <BuildRenderQueue>
+  RenderQueue _renderQueue;
 };
 
 } // namespace ar
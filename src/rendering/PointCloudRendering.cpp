@@ -1,6 +1,11 @@
 #include "PointCloudRendering.hpp"
+#include "Frustum.hpp"
 #include "ShaderSources.g.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace ar
 {
 
@@ -10,15 +15,27 @@ PointCloudRenderer::PointCloudRenderer()
 
 void PointCloudRenderer::Init()
 {
-  _pointCloudShader.loadAndLink(ShaderSources::sh_pointCloud_vert, ShaderSources::sh_flatShaded_frag);
   // super hacky #define insert
-  std::string str = ShaderSources::sh_pointCloud_vert;
-  str.insert(str.find("\n", str.find("#version")), "\n#define WITH_COLOR\n");
-  _pointCloudColorShader.loadAndLink(str, ShaderSources::sh_flatShaded_frag);
+  auto withDefines = [](const char* defines)
+  {
+    std::string str = ShaderSources::sh_pointCloud_vert;
+    str.insert(str.find("\n", str.find("#version")), defines);
+    return str;
+  };
+
+  _pointCloudShader.loadAndLink(ShaderSources::sh_pointCloud_vert, ShaderSources::sh_flatShaded_frag);
+  _pointCloudColorShader.loadAndLink(withDefines("\n#define WITH_COLOR\n"), ShaderSources::sh_flatShaded_frag);
+  _pointCloudQuantizedShader.loadAndLink(withDefines("\n#define QUANTIZED\n"), ShaderSources::sh_flatShaded_frag);
+  _pointCloudQuantizedColorShader.loadAndLink(withDefines("\n#define WITH_COLOR\n#define QUANTIZED\n"), ShaderSources::sh_flatShaded_frag);
+
+  _lodWorker.Start();
 }
 
 void PointCloudRenderer::Release()
 {
+  // builds which are still running must not outlive the clouds
+  _lodWorker.Stop();
+
   // Release all point clouds
   for (auto& cloud : _pointClouds)
   {
@@ -28,38 +45,229 @@ void PointCloudRenderer::Release()
 
 void PointCloudRenderer::Update()
 {
-  for (auto& cloud : _pointClouds)
-    cloud->UpdateBuffer();
+  for (size_t i = 0; i < _pointClouds.size(); i++)
+  {
+    // the bounds only change when new points are uploaded
+    const bool dirty = _pointClouds[i]->Dirty();
+    _pointClouds[i]->UpdateBuffer();
+    if (dirty)
+      updateCulling(i);
+  }
+}
+
+void PointCloudRenderer::updateCulling(size_t index)
+{
+  const auto& cloud = _pointClouds[index];
+  _culling.Set(index, cloud->GetBounds().Transformed(cloud->GetTransform()));
+}
+
+void PointCloudRenderer::BuildRenderQueue(const SceneInfo& sceneInfo)
+{
+  const Frustum frustum(sceneInfo.projectionMatrix * sceneInfo.viewMatrix);
+  _numCulledPointClouds = _pointClouds.size() - _culling.Cull(frustum);
+
+  _renderQueue.Clear();
+  for (size_t i = 0; i < _pointClouds.size(); i++)
+  {
+    const auto& cloud = _pointClouds[i];
+    if (!_culling.Visible(i) || !cloud->ShouldDraw())
+      continue;
+
+    // faded frames have to be blended, so history clouds are always transparent
+    const auto& material = cloud->GetMaterial();
+    if (material->GetOpaque() && cloud->GetHistory() == nullptr)
+      _renderQueue.AddOpaque(i, cloud->GetShader(), material.get());
+    else
+      _renderQueue.AddTransparent(i, RenderQueue::ViewDepth(sceneInfo.viewMatrix, _culling.Center(i)));
+  }
+  _renderQueue.Sort();
 }
 
 void PointCloudRenderer::RenderPass(const SceneInfo& sceneInfo)
 {
-  for (auto& cloud : _pointClouds)
+  const auto& items = _renderQueue.Items(sceneInfo.onlyOpaque);
+  for (const auto& item : items)
+  {
+    const auto& cloud = _pointClouds[item.index];
+    if (cloud->IsLod() || cloud->GetHistory() != nullptr)
+      continue;
+
+    beginCloud(cloud.get(), sceneInfo);
+
+    GLStateCache::Get().BindVertexArray(cloud->GetVAO());
+    glDrawArrays(GL_POINTS, cloud->FirstPoint(), cloud->NumPoints());
+    cloud->FenceDraw();
+  }
+
+  renderLodClouds(sceneInfo, items);
+
+  if (!sceneInfo.onlyOpaque)
+    renderHistoryClouds(sceneInfo, items);
+}
+
+void PointCloudRenderer::beginCloud(BasePointCloud* cloud, const SceneInfo& sceneInfo)
+{
+  const auto& shader = cloud->GetShader();
+  shader->enable();
+  cloud->GetMaterial()->Apply();
+
+  glm::mat4 mvp = sceneInfo.projectionMatrix * sceneInfo.viewMatrix * cloud->GetTransform();
+  glUniformMatrix4fv(shader->getUniform("MVP"), 1, GL_FALSE, &mvp[0][0]);
+  glUniformMatrix4fv(shader->getUniform("M"), 1, GL_FALSE, &cloud->GetTransform()[0][0]);
+  glUniform1f(shader->getUniform("fadeDepth"), cloud->_fadeDepth);
+
+  if (cloud->IsQuantized())
+  {
+    const QuantizationBounds& bounds = cloud->GetQuantizationBounds();
+    glUniform3fv(shader->getUniform("quantizationMin"), 1, &bounds.min[0]);
+    glUniform3fv(shader->getUniform("quantizationExtent"), 1, &bounds.extent[0]);
+  }
+
+  GLStateCache::Get().SetPointSize(cloud->_pointSize);
+}
+
+void PointCloudRenderer::renderLodClouds(const SceneInfo& sceneInfo, const Vector<RenderQueue::Item>& items)
+{
+  // pixels per unit of size / distance
+  const float screenScale = sceneInfo.viewportHeight * 0.5f * sceneInfo.projectionMatrix[1][1];
+
+  // approximate projected size of a node, nodes around the camera get the highest priority
+  auto priority = [&](const glm::mat4& modelView, const BasePointCloudOctree::Node& node)
+  {
+    const glm::vec3 center = node.min + glm::vec3(node.size * 0.5f);
+    const float radius = node.size * 0.866f; // half the diagonal of the cube
+    const float distance = glm::length(glm::vec3(modelView * glm::vec4(center, 1.0f)));
+    return distance > radius ? radius / distance * screenScale : std::numeric_limits<float>::max();
+  };
+
+  auto visible = [](const Frustum& frustum, const BasePointCloudOctree::Node& node)
   {
-    if (!cloud->ShouldDraw())
+    return node.numPoints > 0 && frustum.Intersects(node.min, node.min + glm::vec3(node.size));
+  };
+
+  // start with the roots of all LOD clouds
+  _lodCandidates.clear();
+  for (const auto& item : items)
+  {
+    const auto& cloud = _pointClouds[item.index];
+    if (!cloud->IsLod())
+      continue;
+
+    const auto& nodes = cloud->GetOctree()->Nodes();
+    const Frustum frustum(sceneInfo.projectionMatrix * sceneInfo.viewMatrix * cloud->GetTransform());
+    if (nodes.empty() || !visible(frustum, nodes[0]))
       continue;
-    else if (cloud->GetMaterial()->GetOpaque() != sceneInfo.onlyOpaque)
+
+    LodCandidate root { priority(sceneInfo.viewMatrix * cloud->GetTransform(), nodes[0]), cloud.get(), 0 };
+    _lodCandidates.push_back(root);
+  }
+  std::make_heap(_lodCandidates.begin(), _lodCandidates.end());
+
+  // refine the nodes which appear largest on screen first, until the point budget is used up
+  const size_t pointBudget = _lodPointBudget;
+  size_t numPoints = 0;
+  _lodSelection.clear();
+  while (!_lodCandidates.empty())
+  {
+    std::pop_heap(_lodCandidates.begin(), _lodCandidates.end());
+    const LodCandidate candidate = _lodCandidates.back();
+    _lodCandidates.pop_back();
+
+    const auto& nodes = candidate.cloud->GetOctree()->Nodes();
+    const auto& node = nodes[candidate.node];
+    if (numPoints + node.numPoints > pointBudget)
+      break;
+
+    numPoints += node.numPoints;
+    _lodSelection.push_back(candidate);
+
+    const glm::mat4 modelView = sceneInfo.viewMatrix * candidate.cloud->GetTransform();
+    const Frustum frustum(sceneInfo.projectionMatrix * modelView);
+    for (size_t child : node.children)
+    {
+      if (child == BasePointCloudOctree::NoNode || !visible(frustum, nodes[child]))
+        continue;
+
+      LodCandidate next { priority(modelView, nodes[child]), candidate.cloud, child };
+      if (next.priority < MinLodNodeSize)
+        continue;
+
+      _lodCandidates.push_back(next);
+      std::push_heap(_lodCandidates.begin(), _lodCandidates.end());
+    }
+  }
+
+  if (_lodSelection.empty())
+    return;
+
+  // draw the selected nodes cloud by cloud
+  std::stable_sort(_lodSelection.begin(), _lodSelection.end(), [](const LodCandidate& a, const LodCandidate& b)
+  {
+    return a.cloud < b.cloud;
+  });
+
+  BasePointCloud* currentCloud = nullptr;
+  for (const auto& selected : _lodSelection)
+  {
+    if (selected.cloud != currentCloud)
+    {
+      currentCloud = selected.cloud;
+      beginCloud(currentCloud, sceneInfo);
+    }
+
+    const auto& node = currentCloud->GetOctree()->Nodes()[selected.node];
+    GLStateCache::Get().BindVertexArray(node.vao);
+    glDrawArrays(GL_POINTS, 0, node.numPoints);
+  }
+}
+
+void PointCloudRenderer::renderHistoryClouds(const SceneInfo& sceneInfo, const Vector<RenderQueue::Item>& items)
+{
+  bool blending = false;
+
+  // frames fade with their age, so a cloud which stops receiving updates fades out completely
+  const double now = glfwGetTime();
+
+  for (const auto& item : items)
+  {
+    const auto& cloud = _pointClouds[item.index];
+    const auto* history = cloud->GetHistory();
+    if (history == nullptr)
       continue;
 
-    const auto& shader = cloud->GetShader();
-    shader->enable();
-    cloud->GetMaterial()->Apply();
+    if (!blending)
+    {
+      // the frames overlap, they shouldn't hide each other
+      GLStateCache::Get().SetBlend(true);
+      GLStateCache::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      GLStateCache::Get().SetDepthMask(false);
+      blending = true;
+    }
 
-    glm::mat4 mvp = sceneInfo.projectionMatrix * sceneInfo.viewMatrix * cloud->GetTransform();
-    glUniformMatrix4fv(shader->getUniform("MVP"), 1, GL_FALSE, &mvp[0][0]);
-    glUniformMatrix4fv(shader->getUniform("M"), 1, GL_FALSE, &cloud->GetTransform()[0][0]);
-    glUniform1f(shader->getUniform("fadeDepth"), cloud->_fadeDepth);
+    beginCloud(cloud.get(), sceneInfo);
+    const GLint ageAlpha = cloud->GetShader()->getUniform("ageAlpha");
 
+    // all frames in one go with the same shader, oldest first so newer points end up on top
+    const float duration = cloud->HistoryDuration();
+    for (const auto& frame : *history)
+    {
+      const float age = static_cast<float>(now - frame.time);
+      if (age > duration)
+        continue;
 
-    GLfloat storedPointSize;
-    glGetFloatv(GL_POINT_SIZE, &storedPointSize);
-    glPointSize(cloud->_pointSize);
+      glUniform1f(ageAlpha, duration > 0.0f ? std::max(1.0f - age / duration, 0.0f) : 1.0f);
+      GLStateCache::Get().BindVertexArray(frame.vao);
+      glDrawArrays(GL_POINTS, 0, frame.numPoints);
+    }
 
-    glBindVertexArray(cloud->GetVAO());
-    glDrawArrays(GL_POINTS, 0, cloud->NumPoints());
-    glBindVertexArray(0);
+    // the shader is shared with clouds without history
+    glUniform1f(ageAlpha, 1.0f);
+  }
 
-    glPointSize(storedPointSize);
+  if (blending)
+  {
+    GLStateCache::Get().SetDepthMask(true);
+    GLStateCache::Get().SetBlend(false);
   }
 }
 
@@ -73,66 +281,175 @@ void PointCloudRenderer::RenderGUI()
 
 void PointCloudRenderer::AddPointCloud(UniquePtr<BasePointCloud> pointCloud, bool colored, Color color)
 {
+  pointCloud->SetLodWorker(&_lodWorker);
   pointCloud->Init();
-  pointCloud->SetShader(colored ? &_pointCloudColorShader : &_pointCloudShader);
+  if (pointCloud->IsQuantized())
+    pointCloud->SetShader(colored ? &_pointCloudQuantizedColorShader : &_pointCloudQuantizedShader);
+  else
+    pointCloud->SetShader(colored ? &_pointCloudColorShader : &_pointCloudShader);
   pointCloud->SetMaterial(std::make_shared<FlatColorMaterial>(color));
 
-  _handleIndexMap[pointCloud->ID()] = _pointClouds.size();
+  _handleIndexMap.Set(pointCloud->ID(), _pointClouds.size());
+  _culling.Add(pointCloud->GetBounds().Transformed(pointCloud->GetTransform()));
   _pointClouds.push_back(std::move(pointCloud));
 }
 
+void PointCloudRenderer::uploadPendingFrame(size_t index)
+{
+  BasePointCloud* cloud = _pointClouds[index].get();
+  if (cloud->GetHistory() != nullptr && cloud->Dirty())
+  {
+    cloud->UpdateBuffer();
+    updateCulling(index);
+  }
+}
+
+void PointCloudRenderer::setColor(BasePointCloud* cloud, Color color)
+{
+  // streaming clouds are updated every frame, so the material is kept instead of allocating a new one each time
+  if (auto material = dynamic_cast<FlatColorMaterial*>(cloud->GetMaterial().get()))
+    material->SetColor(color);
+  else
+    cloud->SetMaterial(std::make_shared<FlatColorMaterial>(color));
+}
+
 void PointCloudRenderer::UpdatePointCloud(unsigned int handle, Vector<VertexP4>& points, Color color)
 {
-  if (_handleIndexMap.find(handle) == _handleIndexMap.end())
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
     return;
 
-  auto base_pc = _pointClouds[_handleIndexMap[handle]].get();
+  uploadPendingFrame(*index);
+  auto base_pc = _pointClouds[*index].get();
   auto pc = dynamic_cast<PointCloud<VertexP4>*>(base_pc);
   if (pc == nullptr)
     throw std::runtime_error("The point cloud for given handle has wrong type. Don't update a point cloud with a different type!");
 
-  pc->SetMaterial(std::make_shared<FlatColorMaterial>(color));
-  std::swap(pc->_points, points);
-  pc->_dirty = true;
+  setColor(pc, color);
+  pc->SwapPoints(points);
+}
+
+void PointCloudRenderer::UpdatePointCloud(unsigned int handle, Vector<VertexP3RGBA>& points)
+{
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
+    return;
+
+  uploadPendingFrame(*index);
+  auto pc = dynamic_cast<PointCloud<VertexP3RGBA>*>(_pointClouds[*index].get());
+  if (pc == nullptr)
+    throw std::runtime_error("The point cloud for given handle has wrong type. Don't update a point cloud with a different type!");
+
+  pc->SwapPoints(points);
+}
+
+void PointCloudRenderer::UpdatePointCloud(unsigned int handle, Vector<VertexP3Q>& points, const QuantizationBounds& bounds, Color color)
+{
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
+    return;
+
+  uploadPendingFrame(*index);
+  auto pc = dynamic_cast<PointCloud<VertexP3Q>*>(_pointClouds[*index].get());
+  if (pc == nullptr)
+    throw std::runtime_error("The point cloud for given handle has wrong type. Don't update a point cloud with a different type!");
+
+  setColor(pc, color);
+  pc->SetQuantizationBounds(bounds);
+  pc->SwapPoints(points);
+}
+
+void PointCloudRenderer::UpdatePointCloud(unsigned int handle, Vector<VertexP3QC4>& points, const QuantizationBounds& bounds)
+{
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
+    return;
+
+  uploadPendingFrame(*index);
+  auto pc = dynamic_cast<PointCloud<VertexP3QC4>*>(_pointClouds[*index].get());
+  if (pc == nullptr)
+    throw std::runtime_error("The point cloud for given handle has wrong type. Don't update a point cloud with a different type!");
+
+  pc->SetQuantizationBounds(bounds);
+  pc->SwapPoints(points);
 }
 
-void PointCloudRenderer::UpdatePointCloud(unsigned int handle, Vector<Vertex_PCL_PointXYZRGBA>& points)
+void PointCloudRenderer::UpdatePointCloud(unsigned int handle, SharedPtr<const void> points, size_t numPoints, Color color)
 {
-  if (_handleIndexMap.find(handle) == _handleIndexMap.end())
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
     return;
 
-  auto pc = dynamic_cast<PointCloud<Vertex_PCL_PointXYZRGBA>*>(_pointClouds[_handleIndexMap[handle]].get());
+  uploadPendingFrame(*index);
+  auto pc = dynamic_cast<PointCloud<VertexP4>*>(_pointClouds[*index].get());
   if (pc == nullptr)
     throw std::runtime_error("The point cloud for given handle has wrong type. Don't update a point cloud with a different type!");
 
-  // TODO: error if pc == nullptr
-  std::swap(pc->_points, points);
-  pc->_dirty = true;
+  setColor(pc, color);
+  pc->SetSharedPoints(std::move(points), numPoints);
+}
+
+template <typename VertexT>
+void PointCloudRenderer::appendPoints(unsigned int handle, Vector<VertexT>& points)
+{
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
+    return;
+
+  auto pc = dynamic_cast<RollingPointCloud<VertexT>*>(_pointClouds[*index].get());
+  if (pc == nullptr)
+    throw std::runtime_error("The point cloud for given handle has wrong type. Only append to rolling point clouds of the same type!");
+
+  pc->AppendPoints(points);
+}
+
+void PointCloudRenderer::AppendPoints(unsigned int handle, Vector<VertexP4>& points)
+{
+  appendPoints(handle, points);
+}
+
+void PointCloudRenderer::AppendPoints(unsigned int handle, Vector<VertexP3RGBA>& points)
+{
+  appendPoints(handle, points);
 }
 
 void PointCloudRenderer::SetPointCloudTransform(unsigned int handle, const glm::mat4& transform, bool absolute)
 {
-  if (_handleIndexMap.find(handle) == _handleIndexMap.end())
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
     return;
 
-  auto& pc = _pointClouds[_handleIndexMap[handle]];
+  auto& pc = _pointClouds[*index];
   pc->SetTransform(absolute ? transform : transform * pc->GetTransform());
+  updateCulling(*index);
 }
 
-void PointCloudRenderer::RemovePointCloud(unsigned int handle)
+void PointCloudRenderer::SetVoxelFilterStats(unsigned int handle, float leafSize, size_t numInputPoints, size_t numFilteredPoints)
 {
-  if (_handleIndexMap.find(handle) == _handleIndexMap.end())
+  const size_t* index = _handleIndexMap.Find(handle);
+  if (index == nullptr)
     return;
 
-  const auto index = _handleIndexMap[handle];
-  _handleIndexMap[_pointClouds.back()->ID()] = index;
-  _handleIndexMap.erase(handle);
+  _pointClouds[*index]->SetVoxelFilterStats(leafSize, numInputPoints, numFilteredPoints);
+}
+
+bool PointCloudRenderer::RemovePointCloud(unsigned int handle)
+{
+  const size_t* indexPtr = _handleIndexMap.Find(handle);
+  if (indexPtr == nullptr)
+    return false;
+
+  const auto index = *indexPtr;
+  _handleIndexMap.Set(_pointClouds.back()->ID(), index);
+  _handleIndexMap.Erase(handle);
 
   // Swap with end of point clouds list
   std::swap(_pointClouds[index], _pointClouds.back());
   // Release and remove
   _pointClouds.back()->Release();
   _pointClouds.pop_back();
+  _culling.Remove(index);
+  return true;
 }
 
 void PointCloudRenderer::RemoveAllPointClouds()
@@ -144,7 +461,17 @@ void PointCloudRenderer::RemoveAllPointClouds()
   }
 
   _pointClouds.clear();
-  _handleIndexMap.clear();
+  _handleIndexMap.Clear();
+  _culling.Clear();
+}
+
+Vector<unsigned int> PointCloudRenderer::Handles() const
+{
+  Vector<unsigned int> handles;
+  handles.reserve(_pointClouds.size());
+  for (auto& cloud : _pointClouds)
+    handles.push_back(cloud->ID());
+  return handles;
 }
 
 }
@@ -4,9 +4,15 @@
 #include "RenderingCommon.hpp"
 #include "mesh/Vertex.hpp"
 #include "pointcloud/PointCloud.hpp"
+#include "pointcloud/HistoryPointCloud.hpp"
+#include "pointcloud/RollingPointCloud.hpp"
+#include "HandleTable.hpp"
+#include "WorkerThread.hpp"
+#include "Culling.hpp"
+#include "RenderQueue.hpp"
 
+#include <atomic>
 #include <glm/glm.hpp>
-#include <unordered_map>
 
 namespace ar
 {
@@ -14,6 +20,13 @@ namespace ar
 class PointCloudRenderer : public RenderComponent
 {
 public:
+
+  // Maximum number of points drawn from LOD clouds per frame, by default
+  static const size_t DefaultLodPointBudget = 3000000;
+
+  // Octree nodes which appear smaller than this on screen, in pixels, are not drawn
+  static constexpr float MinLodNodeSize = 30.0f;
+
   PointCloudRenderer();
 
   virtual void Init() override;
@@ -27,18 +40,88 @@ public:
   // NOTE: swaps out points vector!
   void UpdatePointCloud(unsigned int handle, Vector<VertexP4>& points, Color color);
   // NOTE: swaps out points vector!
-  void UpdatePointCloud(unsigned int handle, Vector<Vertex_PCL_PointXYZRGBA>& points);
+  void UpdatePointCloud(unsigned int handle, Vector<VertexP3RGBA>& points);
+  // NOTE: swaps out points vector!
+  void UpdatePointCloud(unsigned int handle, Vector<VertexP3Q>& points, const QuantizationBounds& bounds, Color color);
+  // NOTE: swaps out points vector!
+  void UpdatePointCloud(unsigned int handle, Vector<VertexP3QC4>& points, const QuantizationBounds& bounds);
+  // Uses <points> without copying them, see <PointCloud::SetSharedPoints>.
+  // Only for clouds without colors, colored points are converted before they reach the render thread.
+  void UpdatePointCloud(unsigned int handle, SharedPtr<const void> points, size_t numPoints, Color color);
+  // Adds <points> to a <RollingPointCloud>
+  // NOTE: swaps out points vector!
+  void AppendPoints(unsigned int handle, Vector<VertexP4>& points);
+  // NOTE: swaps out points vector!
+  void AppendPoints(unsigned int handle, Vector<VertexP3RGBA>& points);
   void SetPointCloudTransform(unsigned int handle, const glm::mat4& transform, bool absolute);
-  void RemovePointCloud(unsigned int handle);
+  // see <BasePointCloud::SetVoxelFilterStats>
+  void SetVoxelFilterStats(unsigned int handle, float leafSize, size_t numInputPoints, size_t numFilteredPoints);
+  // @return False if there was no point cloud for <handle>
+  bool RemovePointCloud(unsigned int handle);
   void RemoveAllPointClouds();
 
+  // Handles of all point clouds currently in the scene
+  Vector<unsigned int> Handles() const;
+
+  // Limits the points drawn from all LOD clouds together, can be called from any thread
+  void SetLodPointBudget(size_t numPoints) { _lodPointBudget = numPoints; }
+
+  // Tests all clouds against the view frustum and sorts the ones which are drawn into the opaque and transparent pass.
+  // The nodes of LOD clouds are culled one by one while they are selected, see <renderLodClouds>.
+  // Call once per frame, before the render passes.
+  void BuildRenderQueue(const SceneInfo& sceneInfo);
+
+  // Clouds in the scene, and how many of them were outside of the view frustum in the last frame
+  size_t NumPointClouds() const { return _pointClouds.size(); }
+  size_t NumCulledPointClouds() const { return _numCulledPointClouds; }
+
 private:
 
+  // An octree node which could be drawn, see <renderLodClouds>
+  struct LodCandidate
+  {
+    float priority; // projected size in pixels
+    BasePointCloud* cloud;
+    size_t node;
+
+    bool operator<(const LodCandidate& other) const { return priority < other.priority; }
+  };
+
+  void beginCloud(BasePointCloud* cloud, const SceneInfo& sceneInfo);
+  // Clouds with history draw every update as a frame of their own, see <HistoryPointCloud>.
+  // An update which wasn't uploaded yet is uploaded before the next one replaces it, even if both arrive in the same frame.
+  void uploadPendingFrame(size_t index);
+  // Changes the color of the cloud's material, which is only replaced if it isn't a <FlatColorMaterial>
+  static void setColor(BasePointCloud* cloud, Color color);
+  template <typename VertexT>
+  void appendPoints(unsigned int handle, Vector<VertexT>& points);
+  void renderLodClouds(const SceneInfo& sceneInfo, const Vector<RenderQueue::Item>& items);
+  // Draws the frames of clouds with history with blending, see <HistoryPointCloud>
+  void renderHistoryClouds(const SceneInfo& sceneInfo, const Vector<RenderQueue::Item>& items);
+  // Sets the world space bounds of the cloud at <index> in <_pointClouds>
+  void updateCulling(size_t index);
+
   Vector<UniquePtr<BasePointCloud>> _pointClouds;
   ShaderProgram _pointCloudShader;
   ShaderProgram _pointCloudColorShader;
+  ShaderProgram _pointCloudQuantizedShader;
+  ShaderProgram _pointCloudQuantizedColorShader;
+
+  // index into _pointClouds for every handle
+  HandleMap<size_t> _handleIndexMap;
+
+  // world space bounds of every cloud, in the order of _pointClouds
+  CullingSet _culling;
+  size_t _numCulledPointClouds = 0;
+
+  // clouds drawn in this frame, see <BuildRenderQueue>
+  RenderQueue _renderQueue;
 
-  std::unordered_map<unsigned int, size_t> _handleIndexMap;
+  // builds the octrees of LOD clouds
+  WorkerThread _lodWorker;
+  std::atomic<size_t> _lodPointBudget {DefaultLodPointBudget};
+  Vector<LodCandidate> _lodCandidates;
+  Vector<LodCandidate> _lodSelection;
 };
 
 } // namespace ar
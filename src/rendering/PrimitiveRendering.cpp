@@ -0,0 +1,350 @@
+#include "PrimitiveRendering.hpp"
+#include "ShaderSources.g.hpp"
+#include "mesh/MeshFactory.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ar
+{
+
+// Bounding sphere of a unit shape transformed by <m>
+static glm::vec4 boundingSphere(PrimitiveShape shape, const glm::mat4& m)
+{
+  const float x = glm::length(glm::vec3(m[0]));
+  const float y = glm::length(glm::vec3(m[1]));
+  const float z = glm::length(glm::vec3(m[2]));
+
+  float radius;
+  switch (shape)
+  {
+    case PrimitiveShape::Box:     radius = 0.5f * std::sqrt(x*x + y*y + z*z); break; // the unit box spans -0.5 to 0.5
+    case PrimitiveShape::Capsule: radius = x + std::max(y, z); break;                // half the axis plus the radius
+    default:                      radius = std::max(x, std::max(y, z)); break;
+  }
+  return glm::vec4(glm::vec3(m[3]), radius);
+}
+
+PrimitiveRenderer::PrimitiveRenderer()
+{
+}
+
+void PrimitiveRenderer::Init()
+{
+  // capsules use the sphere meshes too, their vertices are never at x == 0, see <MeshFactory::MakeUVSphereLods>
+  // boxes are as simple as they get already, so they only have one level
+  const Vector<Mesh<VertexP3N3>> spheres = MeshFactory::MakeUVSphereLods<Mesh<VertexP3N3>>();
+  const Vector<Mesh<VertexP3N3>> boxes = { MeshFactory::MakeBox<Mesh<VertexP3N3>>(glm::vec3(0, 0, 0), 1.0, 1.0, 1.0) };
+  const Vector<Mesh<VertexP3N3>>* chains[] = { &spheres, &boxes, &spheres };
+
+  for (size_t i = 0; i < static_cast<size_t>(PrimitiveShape::Count); i++)
+  {
+    ShapeBatch& shape = _shapes[i];
+    shape.vertexBuffer.Init();
+    shape.indexBuffer.Init();
+
+    for (const auto& mesh : *chains[i])
+    {
+      LodLevel level;
+      level.vertexOffset = shape.vertexBuffer.AddVertices(mesh.GetVertices());
+      level.indexOffset = shape.indexBuffer.AddIndices(mesh.GetIndices());
+      level.indexCount = mesh.IndexCount();
+      shape.levels.push_back(level);
+    }
+  }
+
+  _shader.loadAndLink(ShaderSources::sh_primitive_vert, ShaderSources::sh_batchedLit_frag);
+}
+
+void PrimitiveRenderer::Release()
+{
+  for (auto& shape : _shapes)
+  {
+    shape.vertexBuffer.Release();
+    shape.indexBuffer.Release();
+  }
+  _shader.destroy();
+}
+
+void PrimitiveRenderer::Update()
+{
+  _numDrawCalls = 0;
+}
+
+void PrimitiveRenderer::RenderPass(const SceneInfo& sceneInfo)
+{
+  // levels are picked in the opaque pass, which comes first, the transparent pass draws the same instance order
+  if (sceneInfo.onlyOpaque)
+  {
+    selectLevels(sceneInfo);
+
+    _numTriangles = 0;
+    for (auto& shape : _shapes)
+    {
+      shape.vertexBuffer.BufferData();
+      shape.indexBuffer.BufferData();
+
+      for (const auto& level : shape.levels)
+        _numTriangles += level.indexCount / 3 * level.numInstances;
+    }
+  }
+
+  _shader.enable();
+
+  const glm::mat4 vp = sceneInfo.projectionMatrix * sceneInfo.viewMatrix;
+  glUniformMatrix4fv(_shader.getUniform("VP"), 1, GL_FALSE, &vp[0][0]);
+  glUniformMatrix4fv(_shader.getUniform("V"), 1, GL_FALSE, &(sceneInfo.viewMatrix[0][0]));
+  glUniform3fv(_shader.getUniform("light_dir"), 1, &(sceneInfo.lightDir[0]));
+  glUniform1i(_shader.getUniform("lightAlpha"), (int)sceneInfo.lightAlpha);
+  glUniform1i(_shader.getUniform("onlyOpaque"), (int)sceneInfo.onlyOpaque);
+
+  for (size_t i = 0; i < static_cast<size_t>(PrimitiveShape::Count); i++)
+  {
+    ShapeBatch& shape = _shapes[i];
+    if (shape.vertexBuffer.InstanceCount() == 0)
+      continue;
+
+    glUniform1i(_shader.getUniform("capsule"), i == static_cast<size_t>(PrimitiveShape::Capsule));
+
+    GLStateCache::Get().BindVertexArray(shape.vertexBuffer._vao);
+    GLStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, shape.indexBuffer._vio);
+
+    for (const auto& level : shape.levels)
+    {
+      if (level.numInstances == 0)
+        continue;
+
+      shape.vertexBuffer.SetFirstInstance(level.firstInstance);
+      glDrawElementsInstancedBaseVertex(sceneInfo.renderType,
+                                        level.indexCount,
+                                        GL_UNSIGNED_INT,
+                                        (void*)(level.indexOffset * sizeof(GLuint)),
+                                        level.numInstances,
+                                        level.vertexOffset);
+      _numDrawCalls++;
+    }
+  }
+}
+
+void PrimitiveRenderer::selectLevels(const SceneInfo& sceneInfo)
+{
+  static_assert(MeshFactory::NumLodLevels == 4, "LodThresholds has one threshold between each two levels");
+
+  float thresholds[MeshFactory::NumLodLevels - 1];
+  {
+    MutexLockGuard guard(_lodThresholdsLock);
+    thresholds[0] = _lodThresholds.high;
+    thresholds[1] = _lodThresholds.medium;
+    thresholds[2] = _lodThresholds.low;
+  }
+
+  // pixels per unit of size / distance
+  const float screenScale = sceneInfo.viewportHeight * 0.5f * sceneInfo.projectionMatrix[1][1];
+
+  for (auto& shape : _shapes)
+  {
+    const size_t numInstances = shape.instances.size();
+    const size_t numLevels = shape.levels.size();
+    bool changed = shape.reorder;
+
+    if (numLevels > 1)
+    {
+      for (size_t i = 0; i < numInstances; i++)
+      {
+        const glm::vec4& bounds = shape.bounds[i];
+        const float distance = glm::length(glm::vec3(sceneInfo.viewMatrix * glm::vec4(glm::vec3(bounds), 1.0f)));
+        const float projectedRadius = distance > bounds.w ? bounds.w / distance * screenScale : std::numeric_limits<float>::max();
+
+        unsigned char level = 0;
+        while (level + 1u < numLevels && projectedRadius < thresholds[level])
+          level++;
+
+        if (shape.instanceLevels[i] != level)
+        {
+          shape.instanceLevels[i] = level;
+          changed = true;
+        }
+      }
+    }
+
+    if (!changed)
+      continue;
+
+    // counting sort of the instances by level
+    for (auto& level : shape.levels)
+      level.numInstances = 0;
+    for (size_t i = 0; i < numInstances; i++)
+      shape.levels[shape.instanceLevels[i]].numInstances++;
+
+    size_t next[MeshFactory::NumLodLevels]; // where the next instance of each level goes
+    size_t firstInstance = 0;
+    for (size_t l = 0; l < numLevels; l++)
+    {
+      shape.levels[l].firstInstance = next[l] = firstInstance;
+      firstInstance += shape.levels[l].numInstances;
+    }
+
+    _sortedInstances.resize(numInstances);
+    for (size_t i = 0; i < numInstances; i++)
+    {
+      const size_t drawIndex = next[shape.instanceLevels[i]]++;
+      shape.drawIndices[i] = drawIndex;
+      _sortedInstances[drawIndex] = shape.instances[i];
+    }
+
+    shape.vertexBuffer.SetInstances(_sortedInstances.data(), numInstances);
+    shape.reorder = false;
+  }
+}
+
+void PrimitiveRenderer::SetLodThresholds(const LodThresholds& thresholds)
+{
+  MutexLockGuard guard(_lodThresholdsLock);
+  _lodThresholds = thresholds;
+}
+
+void PrimitiveRenderer::AddPrimitive(unsigned int handle, const Primitive& primitive)
+{
+  PrimitiveObject object;
+  object.primitive = primitive;
+  addInstance(handle, object);
+  _objects.Set(handle, object);
+}
+
+bool PrimitiveRenderer::UpdatePrimitive(unsigned int handle, const Primitive& primitive)
+{
+  PrimitiveObject* object = _objects.Find(handle);
+  if (object == nullptr)
+    return false;
+
+  if (object->primitive.shape != primitive.shape)
+  {
+    removeInstance(*object);
+    object->primitive = primitive;
+    addInstance(handle, *object);
+  }
+  else
+  {
+    object->primitive = primitive;
+    writeInstance(*object);
+  }
+  return true;
+}
+
+bool PrimitiveRenderer::RemovePrimitive(unsigned int handle)
+{
+  const PrimitiveObject* object = _objects.Find(handle);
+  if (object == nullptr)
+    return false;
+
+  removeInstance(*object);
+  _objects.Erase(handle);
+  return true;
+}
+
+void PrimitiveRenderer::RemoveAllPrimitives()
+{
+  for (auto& shape : _shapes)
+  {
+    shape.vertexBuffer.ClearInstances();
+    shape.instances.clear();
+    shape.bounds.clear();
+    shape.handles.clear();
+    shape.instanceLevels.clear();
+    shape.drawIndices.clear();
+    shape.reorder = true;
+  }
+  _objects.Clear();
+}
+
+void PrimitiveRenderer::SetPrimitiveTransform(unsigned int handle, const glm::mat4& transform, bool absolute)
+{
+  PrimitiveObject* object = _objects.Find(handle);
+  if (object == nullptr)
+    return;
+
+  object->primitive.transform = absolute ? transform : transform * object->primitive.transform;
+  writeInstance(*object);
+}
+
+void PrimitiveRenderer::SetVisible(unsigned int handle, bool visible)
+{
+  PrimitiveObject* object = _objects.Find(handle);
+  if (object == nullptr || object->visible == visible)
+    return;
+
+  object->visible = visible;
+  writeInstance(*object);
+}
+
+Vector<unsigned int> PrimitiveRenderer::Handles() const
+{
+  Vector<unsigned int> handles;
+  for (const auto& shape : _shapes)
+    handles.insert(handles.end(), shape.handles.begin(), shape.handles.end());
+  return handles;
+}
+
+void PrimitiveRenderer::addInstance(unsigned int handle, PrimitiveObject& object)
+{
+  ShapeBatch& shape = _shapes[static_cast<size_t>(object.primitive.shape)];
+  object.instance = shape.instances.size();
+  shape.instances.emplace_back();
+  shape.bounds.emplace_back();
+  shape.handles.push_back(handle);
+  shape.instanceLevels.push_back(0);
+  shape.drawIndices.push_back(0);
+  shape.reorder = true;
+  writeInstance(object);
+}
+
+void PrimitiveRenderer::removeInstance(const PrimitiveObject& object)
+{
+  ShapeBatch& shape = _shapes[static_cast<size_t>(object.primitive.shape)];
+  const size_t index = object.instance;
+
+  // the last instance takes over the removed one's place
+  if (index + 1 < shape.handles.size())
+  {
+    shape.instances[index] = shape.instances.back();
+    shape.bounds[index] = shape.bounds.back();
+    shape.handles[index] = shape.handles.back();
+    shape.instanceLevels[index] = shape.instanceLevels.back();
+    _objects.Find(shape.handles[index])->instance = index;
+  }
+  shape.instances.pop_back();
+  shape.bounds.pop_back();
+  shape.handles.pop_back();
+  shape.instanceLevels.pop_back();
+  shape.drawIndices.pop_back();
+  shape.reorder = true;
+}
+
+void PrimitiveRenderer::writeInstance(const PrimitiveObject& object)
+{
+  ShapeBatch& shape = _shapes[static_cast<size_t>(object.primitive.shape)];
+  const glm::mat4 m = object.primitive.transform * object.primitive.shapeTransform;
+  shape.bounds[object.instance] = boundingSphere(object.primitive.shape, m);
+
+  VertexM34C4 instance = {};
+  if (object.visible)
+  {
+    // glm matrices are column major, the instance keeps rows
+    for (int row = 0; row < 3; row++)
+      for (int column = 0; column < 4; column++)
+        instance.rows[row][column] = m[column][row];
+  }
+
+  const Color& color = object.primitive.color;
+  instance.color[0] = color.r;
+  instance.color[1] = color.g;
+  instance.color[2] = color.b;
+  instance.color[3] = color.a;
+
+  // instances added or removed meanwhile are all uploaded with the next <selectLevels>
+  shape.instances[object.instance] = instance;
+  if (!shape.reorder)
+    shape.vertexBuffer.SetInstance(shape.drawIndices[object.instance], instance);
+}
+
+} // namespace ar
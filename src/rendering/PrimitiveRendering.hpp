@@ -0,0 +1,133 @@
+#ifndef _ARPRIMITIVE_RENDERING_HPP
+#define _ARPRIMITIVE_RENDERING_HPP
+
+#include "RenderingCommon.hpp"
+#include "InstancedVertexBuffer.hpp"
+#include "HandleTable.hpp"
+#include "mesh/Vertex.hpp"
+#include "geometry/Color.hpp"
+#include "LodThresholds.hpp"
+#include <mutex>
+#include <glm/glm.hpp>
+
+namespace ar
+{
+
+// Unit meshes the <PrimitiveRenderer> draws instances of
+enum class PrimitiveShape
+{
+  Sphere,  // also used for ellipsoids
+  Box,     // also used for cubes
+  Capsule, // a sphere whose halves are moved apart in the vertex shader
+
+  Count
+};
+
+// A primitive object, made from a unit shape
+struct Primitive
+{
+  PrimitiveShape shape = PrimitiveShape::Sphere;
+  glm::mat4 transform = glm::mat4(1.0f); // object transform, set with <ARVisualizer::Update(handle, Transform, bool)>
+  glm::mat4 shapeTransform = glm::mat4(1.0f); // turns the unit shape into this object, placement included, applied before <transform>
+  Color color;
+
+  // For capsules <shapeTransform> scales the x axis by half the distance between the centers
+  // and the other axes by the radius, see primitive.vert
+};
+
+/*
+  Draws spheres, boxes, capsules and ellipsoids as instances of one unit mesh per shape,
+  with one glDrawElementsInstanced per shape, level of detail and pass.
+  Updating a primitive only rewrites its 64 byte instance.
+
+  Spheres and capsules come with a chain of meshes from <MeshFactory::MakeUVSphereLods>. Once per frame
+  every instance picks its level from its projected radius, see <LodThresholds>, and the instances are
+  reordered by level only when some of them changed levels.
+*/
+class PrimitiveRenderer : public RenderComponent
+{
+public:
+
+  PrimitiveRenderer();
+
+  virtual void Init() override;
+  virtual void Release() override;
+  virtual void Update() override;
+  virtual void RenderPass(const SceneInfo& sceneInfo) override;
+
+  void AddPrimitive(unsigned int handle, const Primitive& primitive);
+  // @return False if there was no primitive for <handle>
+  bool UpdatePrimitive(unsigned int handle, const Primitive& primitive);
+  // @return False if there was no primitive for <handle>
+  bool RemovePrimitive(unsigned int handle);
+  void RemoveAllPrimitives();
+
+  void SetPrimitiveTransform(unsigned int handle, const glm::mat4& transform, bool absolute);
+  void SetVisible(unsigned int handle, bool visible);
+
+  // Handles of all primitives currently in the scene
+  Vector<unsigned int> Handles() const;
+
+  // Can be called from any thread
+  void SetLodThresholds(const LodThresholds& thresholds);
+
+  size_t NumDrawCalls() const { return _numDrawCalls; }
+  size_t NumTriangles() const { return _numTriangles; }
+
+private:
+
+  struct PrimitiveObject
+  {
+    Primitive primitive;
+    size_t instance = 0; // index into the instances of its shape
+    bool visible = true;
+  };
+
+  // One mesh of a shape's LOD chain and the instances drawn with it
+  struct LodLevel
+  {
+    size_t indexOffset = 0;   // first index of the mesh in the shape's index buffer
+    size_t indexCount = 0;
+    int vertexOffset = 0;     // added to each of the mesh's indices
+    size_t firstInstance = 0; // instances drawn with this level are consecutive in the instance buffer
+    size_t numInstances = 0;
+  };
+
+  struct ShapeBatch
+  {
+    InstancedVertexBuffer<VertexP3N3, VertexM34C4> vertexBuffer; // meshes of all levels, instances ordered by level
+    GenericIndexBuffer indexBuffer;
+    Vector<LodLevel> levels;              // from the finest to the coarsest
+
+    // one entry per instance, in the order the primitives were added
+    Vector<VertexM34C4> instances;
+    Vector<glm::vec4> bounds;             // bounding sphere in world space, xyz = center, w = radius
+    Vector<unsigned int> handles;
+    Vector<unsigned char> instanceLevels; // level the instance is drawn with
+    Vector<size_t> drawIndices;           // position of the instance in the instance buffer
+
+    bool reorder = false; // instances were added or removed since the last <selectLevels>
+  };
+
+  void addInstance(unsigned int handle, PrimitiveObject& object);
+  void removeInstance(const PrimitiveObject& object);
+  void writeInstance(const PrimitiveObject& object);
+
+  // Picks the level of every instance and reorders the instance buffers by level where that changed
+  void selectLevels(const SceneInfo& sceneInfo);
+
+  ShaderProgram _shader;
+  ShapeBatch _shapes[static_cast<size_t>(PrimitiveShape::Count)];
+  HandleMap<PrimitiveObject> _objects;
+  Vector<VertexM34C4> _sortedInstances; // scratch space for <selectLevels>
+
+  std::mutex _lodThresholdsLock;
+  LodThresholds _lodThresholds;
+
+  size_t _numDrawCalls = 0;
+  size_t _numTriangles = 0;
+};
+
+} // namespace ar
+
+#endif // _ARPRIMITIVE_RENDERING_HPP
@@ -0,0 +1,177 @@
+#ifndef _AR_RANGEALLOCATOR_HPP
+#define _AR_RANGEALLOCATOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include "common.hpp"
+
+namespace ar
+{
+
+/*
+ * Keeps track of which elements of a buffer with <Capacity> elements are in use, so buffers can hand out
+ * ranges of their storage and take them back without moving the other ranges.
+ * Free ranges are sorted by offset and merged with their neighbours, a new range is taken from the first free
+ * range which is large enough.
+ */
+class RangeAllocator
+{
+public:
+
+  static const size_t NoRange = ~size_t(0);
+
+  size_t Capacity() const { return _capacity; }
+  size_t NumUsed() const { return _numUsed; }
+  size_t NumFree() const { return _capacity - _numUsed; }
+
+  // Number of holes in the storage, a single free range at the end isn't a hole
+  size_t NumHoles() const
+  {
+    if (_freeRanges.empty())
+      return 0;
+
+    const auto& last = *_freeRanges.rbegin();
+    return last.first + last.second == _capacity ? _freeRanges.size() - 1 : _freeRanges.size();
+  }
+
+  // @return Offset of <size> elements which are now in use, or <NoRange> if no free range is large enough
+  size_t Allocate(size_t size)
+  {
+    if (size == 0)
+      return 0;
+
+    for (auto it = _freeRanges.begin(); it != _freeRanges.end(); ++it)
+    {
+      if (it->second < size)
+        continue;
+
+      const size_t offset = it->first;
+      const size_t remaining = it->second - size;
+      auto next = _freeRanges.erase(it);
+      if (remaining > 0)
+        _freeRanges.emplace_hint(next, offset + size, remaining);
+
+      _numUsed += size;
+      return offset;
+    }
+
+    return NoRange;
+  }
+
+  // Gives back the <size> elements at <offset>, which were handed out by <Allocate>
+  void Free(size_t offset, size_t size)
+  {
+    if (size == 0)
+      return;
+
+    _numUsed -= size;
+
+    auto next = _freeRanges.lower_bound(offset);
+    if (next != _freeRanges.end() && offset + size == next->first)
+    {
+      size += next->second;
+      next = _freeRanges.erase(next);
+    }
+
+    if (next != _freeRanges.begin())
+    {
+      auto previous = std::prev(next);
+      if (previous->first + previous->second == offset)
+      {
+        previous->second += size;
+        return;
+      }
+    }
+
+    _freeRanges.emplace_hint(next, offset, size);
+  }
+
+  // Adds free elements at the end, up to <capacity>
+  void Grow(size_t capacity)
+  {
+    if (capacity <= _capacity)
+      return;
+
+    const size_t offset = _capacity;
+    const size_t size = capacity - _capacity;
+    _capacity = capacity;
+    _numUsed += size;
+    Free(offset, size);
+  }
+
+  // Adds <size> elements at the end which are already in use
+  void Extend(size_t size)
+  {
+    _capacity += size;
+    _numUsed += size;
+  }
+
+  // Forgets all ranges, the first <numUsed> elements are in use afterwards
+  void Reset(size_t capacity, size_t numUsed = 0)
+  {
+    _freeRanges.clear();
+    _capacity = capacity;
+    _numUsed = numUsed;
+    if (numUsed < capacity)
+      _freeRanges.emplace(numUsed, capacity - numUsed);
+  }
+
+private:
+
+  size_t _capacity = 0;
+  size_t _numUsed = 0;
+  std::map<size_t, size_t> _freeRanges; // offset -> size
+};
+
+/*
+ * Ranges of a buffer which were written since its last upload, see <RangeAllocator>.
+ */
+class DirtyRanges
+{
+public:
+
+  struct Range
+  {
+    size_t offset;
+    size_t size;
+  };
+
+  bool Empty() const { return _ranges.empty(); }
+
+  void Add(size_t offset, size_t size)
+  {
+    if (size > 0)
+      _ranges.push_back({offset, size});
+  }
+
+  void Clear() { _ranges.clear(); }
+
+  // Sorts the ranges and merges the ones which overlap or touch, so every element is uploaded once
+  const Vector<Range>& Merge()
+  {
+    std::sort(_ranges.begin(), _ranges.end(), [](const Range& a, const Range& b) { return a.offset < b.offset; });
+
+    size_t numMerged = 0;
+    for (const Range& range : _ranges)
+    {
+      Range* last = numMerged > 0 ? &_ranges[numMerged - 1] : nullptr;
+      if (last != nullptr && range.offset <= last->offset + last->size)
+        last->size = std::max(last->size, range.offset + range.size - last->offset);
+      else
+        _ranges[numMerged++] = range;
+    }
+    _ranges.resize(numMerged);
+
+    return _ranges;
+  }
+
+private:
+
+  Vector<Range> _ranges;
+};
+
+} // namespace ar
+
+#endif // _AR_RANGEALLOCATOR_HPP
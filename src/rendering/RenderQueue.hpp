@@ -0,0 +1,87 @@
+#ifndef _ARRENDERQUEUE_HPP
+#define _ARRENDERQUEUE_HPP
+
+#include "common.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <glm/glm.hpp>
+
+namespace ar
+{
+
+/*
+ * The objects of a renderer which are drawn in the current frame, split into the opaque and the transparent pass.
+ * Every object is classified once per frame, each pass then walks its own list instead of testing all objects again.
+ * Opaque objects are sorted by shader and material, so consecutive draws can skip setting them up again,
+ * transparent objects are sorted back to front, so they blend over what is behind them.
+ */
+class RenderQueue
+{
+public:
+
+  struct Item
+  {
+    size_t index; // into the renderer's list of objects
+    const void* shader;
+    const void* material;
+    float depth;  // distance from the camera along the view direction, only for transparent objects
+  };
+
+  // @return Distance of <worldPos> from the camera along the view direction
+  static float ViewDepth(const glm::mat4& viewMatrix, const glm::vec3& worldPos)
+  {
+    return -(viewMatrix * glm::vec4(worldPos, 1.0f)).z;
+  }
+
+  void Clear()
+  {
+    _opaque.clear();
+    _transparent.clear();
+  }
+
+  void AddOpaque(size_t index, const void* shader, const void* material)
+  {
+    _opaque.push_back({ index, shader, material, 0.0f });
+  }
+
+  void AddTransparent(size_t index, float depth)
+  {
+    _transparent.push_back({ index, nullptr, nullptr, depth });
+  }
+
+  // Call after all objects of the frame were added
+  void Sort()
+  {
+    const std::less<const void*> less;
+    std::sort(_opaque.begin(), _opaque.end(), [&less](const Item& a, const Item& b)
+    {
+      if (a.shader != b.shader)
+        return less(a.shader, b.shader);
+      if (a.material != b.material)
+        return less(a.material, b.material);
+      return a.index < b.index;
+    });
+
+    std::sort(_transparent.begin(), _transparent.end(), [](const Item& a, const Item& b)
+    {
+      if (a.depth != b.depth)
+        return a.depth > b.depth;
+      return a.index < b.index;
+    });
+  }
+
+  // @return The objects to draw in the opaque or the transparent pass, in the order they should be drawn
+  const Vector<Item>& Items(bool opaque) const { return opaque ? _opaque : _transparent; }
+
+  size_t Size() const { return _opaque.size() + _transparent.size(); }
+
+private:
+
+  Vector<Item> _opaque;
+  Vector<Item> _transparent;
+};
+
+} // namespace ar
+
+#endif // _ARRENDERQUEUE_HPP
@@ -10,6 +10,7 @@
 #include "SceneInfo.hpp"
 #include "IndexBuffer.hpp"
 #include "VertexBuffer.hpp"
+#include "GLStateCache.hpp"
 #include "RenderResource.hpp"
 #include "RenderComponent.hpp"
 #include "RenderDefinitions.hpp"
@@ -0,0 +1,89 @@
+#ifndef _RINGVERTEXBUFFER_H
+#define _RINGVERTEXBUFFER_H
+
+#include <algorithm>
+#include "common.hpp"
+#include "VertexBuffer.hpp"
+
+namespace ar
+{
+
+/*
+  Vertex buffer holding at most <Capacity> vertices, which are appended instead of replaced.
+
+  The storage for all vertices is allocated once, every append only uploads the new vertices
+  at the write position. Once the buffer is full, new vertices overwrite the oldest ones,
+  so appending costs the same no matter how many vertices were added before.
+  The vertices are not in the order they were appended, which doesn't matter for points.
+*/
+template <typename VertexT>
+class RingVertexBuffer : public GenericVertexBuffer<VertexT>
+{
+  typedef GenericVertexBuffer<VertexT> Base;
+
+public:
+
+  explicit RingVertexBuffer(size_t capacity)
+    : Base(BufferUsage::Dynamic), _capacity(capacity)
+  { }
+
+  virtual void InitResource() override
+  {
+    Base::InitResource();
+
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, Base::_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexT) * _capacity, nullptr, GetGLUsage(Base::_usage));
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  size_t Capacity() const { return _capacity; }
+
+  // Number of vertices in the buffer, never more than <Capacity>
+  size_t NumVertices() const { return _numVertices; }
+
+  // Uploads <numVertices> vertices behind the ones which were appended before
+  // If there are more than <Capacity> vertices, only the last ones are kept.
+  // Must ONLY be called from the thread owning the OpenGL Context!
+  void AppendVertices(const VertexT* vertices, size_t numVertices)
+  {
+    if (!Base::_initialized)
+      throw std::runtime_error("The vertex buffer was not initialized.");
+
+    if (numVertices > _capacity)
+    {
+      vertices += numVertices - _capacity;
+      numVertices = _capacity;
+    }
+    if (numVertices == 0)
+      return;
+
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, Base::_vbo);
+
+    // up to the end of the buffer, then wrap around to the start
+    const size_t numFirst = std::min(numVertices, _capacity - _head);
+    glBufferSubData(GL_ARRAY_BUFFER, _head * sizeof(VertexT), numFirst * sizeof(VertexT), vertices);
+    if (numFirst < numVertices)
+      glBufferSubData(GL_ARRAY_BUFFER, 0, (numVertices - numFirst) * sizeof(VertexT), vertices + numFirst);
+
+    _head = (_head + numVertices) % _capacity;
+    _numVertices = std::min(_numVertices + numVertices, _capacity);
+  }
+
+  // Removes all vertices, the storage is kept
+  virtual void ClearAll() override
+  {
+    Base::ClearAll();
+    _head = 0;
+    _numVertices = 0;
+  }
+
+private:
+
+  const size_t _capacity;
+  size_t _head = 0;        // where the next vertex is written
+  size_t _numVertices = 0;
+};
+
+} // namespace ar
+
+#endif // _RINGVERTEXBUFFER_H
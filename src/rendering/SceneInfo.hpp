@@ -2,7 +2,7 @@
 #define _ARSCENEINFO_H
 
 #include <glm/glm.hpp>
-#include <unordered_map>
+#include "HandleTable.hpp"
 
 namespace ar
 {
@@ -16,13 +16,15 @@ struct SceneInfo
   float nearClip;
   float farClip;
   float aspect;
-  std::unordered_map<unsigned int, bool>* visibilityMap;
+  float viewportHeight; // in pixels
+  const HandleMap<bool>* visibilityMap;
   bool lightAlpha;
   bool onlyOpaque;
 
   bool shouldDraw(unsigned handle) const
   {
-    return visibilityMap->find(handle) == visibilityMap->end() || visibilityMap->at(handle) == true;
+    const bool* visible = visibilityMap->Find(handle);
+    return visible == nullptr || *visible;
   }
 };
 
@@ -0,0 +1,159 @@
+#ifndef _STREAMINGVERTEXBUFFER_H
+#define _STREAMINGVERTEXBUFFER_H
+
+#include <cstring>
+#include "common.hpp"
+#include "VertexBuffer.hpp"
+
+namespace ar
+{
+
+/*
+  Vertex buffer for data which is replaced (nearly) every frame.
+
+  While streaming, the buffer is split into <NumSegments> segments which are written in turn
+  with unsynchronized mappings, so an upload never waits for draws which still read an older segment.
+  A fence is placed after the draws of every segment (see <FenceDraw>); if the next segment is still
+  in use, the buffer is orphaned instead, which lets the driver hand out fresh storage.
+  The storage is only reallocated when the data outgrows a segment.
+
+  Without streaming it behaves like a regular <GenericVertexBuffer>.
+*/
+template <typename VertexT>
+class StreamingVertexBuffer : public GenericVertexBuffer<VertexT>
+{
+  typedef GenericVertexBuffer<VertexT> Base;
+
+public:
+
+  static const size_t NumSegments = 3;
+
+  StreamingVertexBuffer()
+  {
+    for (auto& fence : _fences)
+      fence = nullptr;
+  }
+
+  virtual void ReleaseResource() override
+  {
+    deleteFences();
+    Base::ReleaseResource();
+  }
+
+  // Switches between streaming and regular uploads, takes effect with the next upload
+  void SetStreaming(bool streaming) { _streaming = streaming; }
+  bool IsStreaming() const { return _streaming; }
+
+  // sends <numVertices> vertices to the next free segment of the buffer
+  // Must ONLY be called from the thread owning the OpenGL Context!
+  void BufferVertices(const VertexT* vertices, size_t numVertices)
+  {
+    if (!_streaming)
+    {
+      deleteFences();
+      Base::BufferVertices(vertices, numVertices);
+      _segmentCapacity = 0; // storage doesn't have segments anymore
+      _segment = 0;
+      return;
+    }
+
+    if (!Base::_initialized)
+      throw std::runtime_error("The vertex buffer was not initialized.");
+
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, Base::_vbo);
+
+    if (numVertices > _segmentCapacity)
+    {
+      // leave some headroom, so slowly growing data doesn't reallocate on every upload
+      _segmentCapacity = numVertices + numVertices / 4;
+      orphan();
+    }
+    else
+    {
+      _segment = (_segment + 1) % NumSegments;
+      if (!segmentAvailable(_segment))
+        orphan();
+    }
+
+    const GLintptr offset = _segment * _segmentCapacity * sizeof(VertexT);
+    const GLsizeiptr size = numVertices * sizeof(VertexT);
+    if (size > 0)
+    {
+      void* target = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+      if (target != nullptr)
+      {
+        std::memcpy(target, vertices, size);
+        if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+          glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertices); // mapped data got corrupted, upload it again
+      }
+      else
+      {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertices);
+      }
+    }
+
+    Base::_vertices.clear();
+    Base::_dirty = false;
+  }
+
+  // Index of the first vertex of the last upload, which is the first vertex to draw
+  GLint FirstVertex() const { return static_cast<GLint>(_segment * _segmentCapacity); }
+
+  // Call after the draw calls reading the last upload were issued,
+  // so its segment isn't overwritten before the GPU is done with it
+  void FenceDraw()
+  {
+    if (_segmentCapacity == 0)
+      return;
+
+    GLsync& fence = _fences[_segment];
+    if (fence != nullptr)
+      glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  // Number of times the buffer storage was reallocated while streaming
+  size_t NumOrphans() const { return _numOrphans; }
+
+private:
+
+  // Replaces the storage of the bound buffer, draws still reading the old storage are unaffected
+  void orphan()
+  {
+    glBufferData(GL_ARRAY_BUFFER, NumSegments * _segmentCapacity * sizeof(VertexT), nullptr, GetGLUsage(BufferUsage::Stream));
+    deleteFences();
+    _segment = 0;
+    _numOrphans++;
+  }
+
+  bool segmentAvailable(size_t segment) const
+  {
+    if (_fences[segment] == nullptr)
+      return true;
+
+    // zero timeout, only checks the fence without waiting for the GPU
+    const GLenum status = glClientWaitSync(_fences[segment], 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+  }
+
+  void deleteFences()
+  {
+    for (auto& fence : _fences)
+    {
+      if (fence != nullptr)
+        glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+
+  bool _streaming = false;
+  size_t _segmentCapacity = 0; // vertices per segment, 0 while the storage isn't split into segments
+  size_t _segment = 0;         // segment holding the last upload
+  size_t _numOrphans = 0;
+  GLsync _fences[NumSegments];
+};
+
+} // namespace ar
+
+#endif // _STREAMINGVERTEXBUFFER_H
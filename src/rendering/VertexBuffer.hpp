@@ -4,6 +4,8 @@
 #include "common.hpp"
 #include "RenderResource.hpp"
 #include "RenderDefinitions.hpp"
+#include "GLStateCache.hpp"
+#include "RangeAllocator.hpp"
 
 #ifndef GL_GLEXT_PROTOTYPES
 #define GL_GLEXT_PROTOTYPES
@@ -38,26 +40,26 @@ public:
     glGenVertexArrays(1, &_vao);
     glGenBuffers(1, &_vbo);
 
-    glBindVertexArray(_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    GLStateCache::Get().BindVertexArray(_vao);
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _vbo);
 
     // tell OpenGL about our vertex format
     VertexT::EnableVertexAttribArray();
 
     // reset GL state
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, 0);
+    GLStateCache::Get().BindVertexArray(0);
 
     _dirty = false;
   }
 
   virtual void ReleaseResource() override
   {
-    glDeleteVertexArrays(1, &_vao);
-    glDeleteBuffers(1, &_vbo);
+    GLStateCache::Get().DeleteVertexArray(_vao);
+    GLStateCache::Get().DeleteBuffer(_vbo);
   }
 
-  inline bool IsDirty() const { return _dirty; };
+  inline bool IsDirty() const { return _dirty || !_dirtyRanges.Empty(); };
 
   // Adds the given vertices to the buffer
   // Returns the offset to the first new vertex
@@ -67,6 +69,7 @@ public:
 
     // append new vertices to the end of our existing list
     _vertices.insert(std::end(_vertices), std::begin(vertices), std::end(vertices));
+    _ranges.Extend(vertices.size());
     _dirty = true;
 
     return (int)offset;
@@ -75,9 +78,46 @@ public:
   void SetVertices(const Vector<VertexT>& vertices)
   {
     _vertices = vertices;
+    _ranges.Reset(_vertices.size(), _vertices.size());
     _dirty = true;
   }
 
+  // Copies <numVertices> vertices into a free range of the buffer, the buffer grows if there is none
+  // Only the new range is uploaded with the next <BufferData>, unless the buffer had to grow.
+  // Returns the offset to the first new vertex
+  int AllocVertices(const VertexT* vertices, size_t numVertices)
+  {
+    size_t offset = _ranges.Allocate(numVertices);
+    if (offset == RangeAllocator::NoRange)
+    {
+      // grow geometrically, so adding many vertices one range at a time doesn't reallocate every time
+      _ranges.Grow(std::max(_ranges.Capacity() * 2, _ranges.Capacity() + numVertices));
+      _vertices.resize(_ranges.Capacity());
+      offset = _ranges.Allocate(numVertices);
+      _dirty = true;
+    }
+
+    WriteVertices(offset, vertices, numVertices);
+    return (int)offset;
+  }
+
+  // Overwrites <numVertices> vertices starting at <offset>, which must be part of an allocated range
+  void WriteVertices(size_t offset, const VertexT* vertices, size_t numVertices)
+  {
+    std::copy(vertices, vertices + numVertices, _vertices.begin() + offset);
+    _dirtyRanges.Add(offset, numVertices);
+  }
+
+  // Gives back a range handed out by <AllocVertices>, so later allocations can reuse it
+  void FreeVertices(size_t offset, size_t numVertices)
+  {
+    _ranges.Free(offset, numVertices);
+  }
+
+  // Number of vertices in ranges which are not in use
+  size_t NumFreeVertices() const { return _ranges.NumFree(); }
+  size_t NumUsedVertices() const { return _ranges.NumUsed(); }
+
   // sends all currently-held vertex data to GPU
   // Must ONLY be called from the thread owning the OpenGL Context!
   virtual void BufferData() override
@@ -85,20 +125,90 @@ public:
     if (!_initialized)
       throw std::runtime_error("The vertex buffer was not initialized.");
 
-    if (!_dirty)
+    if (!IsDirty())
       return;
 
-    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexT) * _vertices.size(), &_vertices[0], GetGLUsage(_usage));
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _vbo);
+    if (_dirty)
+    {
+      glBufferData(GL_ARRAY_BUFFER, sizeof(VertexT) * _vertices.size(), _vertices.data(), GetGLUsage(_usage));
+    }
+    else
+    {
+      // the storage is still large enough, only send the ranges written since the last upload
+      for (const auto& range : _dirtyRanges.Merge())
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(VertexT) * range.offset, sizeof(VertexT) * range.size, &_vertices[range.offset]);
+    }
+
+    _dirtyRanges.Clear();
+    _dirty = false;
+  }
+
+  // sends <numVertices> vertices straight to the GPU, without keeping a copy of them in this buffer
+  // Must ONLY be called from the thread owning the OpenGL Context!
+  void BufferVertices(const VertexT* vertices, size_t numVertices)
+  {
+    if (!_initialized)
+      throw std::runtime_error("The vertex buffer was not initialized.");
+
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexT) * numVertices, vertices, GetGLUsage(_usage));
+    _numBufferedVertices = numVertices;
+    _bufferCapacity = numVertices;
 
+    _vertices.clear();
+    _ranges.Reset(0);
+    _dirtyRanges.Clear();
     _dirty = false;
   }
 
+  // sends <numVertices> vertices straight to the GPU behind the ones sent with <BufferVertices> and earlier appends.
+  // Only the new vertices are uploaded: the storage grows geometrically and its content is copied on the GPU when it does.
+  // Must ONLY be called from the thread owning the OpenGL Context!
+  void AppendBufferedVertices(const VertexT* vertices, size_t numVertices)
+  {
+    if (!_initialized)
+      throw std::runtime_error("The vertex buffer was not initialized.");
+
+    const size_t required = _numBufferedVertices + numVertices;
+    if (required > _bufferCapacity)
+    {
+      const size_t capacity = std::max(required, _bufferCapacity * 2);
+
+      GLuint vbo;
+      glGenBuffers(1, &vbo);
+      GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, vbo);
+      glBufferData(GL_ARRAY_BUFFER, sizeof(VertexT) * capacity, nullptr, GetGLUsage(_usage));
+
+      if (_numBufferedVertices > 0)
+      {
+        glBindBuffer(GL_COPY_READ_BUFFER, _vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, sizeof(VertexT) * _numBufferedVertices);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      }
+
+      GLStateCache::Get().DeleteBuffer(_vbo);
+      _vbo = vbo;
+      _bufferCapacity = capacity;
+
+      // the vertex array still points at the old buffer
+      GLStateCache::Get().BindVertexArray(_vao);
+      GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _vbo);
+      VertexT::EnableVertexAttribArray();
+      GLStateCache::Get().BindVertexArray(0);
+    }
+
+    GLStateCache::Get().BindBuffer(GL_ARRAY_BUFFER, _vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(VertexT) * _numBufferedVertices, sizeof(VertexT) * numVertices, vertices);
+    _numBufferedVertices = required;
+  }
+
   // removes ALL vertex and index data from the buffer
   virtual void ClearAll()
   {
     _vertices.clear();
+    _ranges.Reset(0);
+    _dirtyRanges.Clear();
     _dirty = true;
   }
 
@@ -107,6 +217,10 @@ public:
   GLuint _vao; // vertex array object
   GLuint _vbo; // vertex buffer object
   Vector<VertexT> _vertices;
+  RangeAllocator _ranges;     // which of <_vertices> are in use
+  DirtyRanges _dirtyRanges;   // ranges of <_vertices> to upload with the next BufferData
+  size_t _numBufferedVertices = 0; // sent with <BufferVertices> and <AppendBufferedVertices>
+  size_t _bufferCapacity = 0;      // vertices the GPU storage can hold, for <AppendBufferedVertices>
 };
 
 } // namespace ar
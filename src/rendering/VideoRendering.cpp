@@ -104,17 +104,14 @@ void VideoRenderer::RenderPass(const SceneInfo& sceneInfo)
   glBindTexture(GL_TEXTURE_2D, _quadMesh.GetTexture());
   glUniform1i(shader->getUniform("tex"), 0);
 
-  glBindVertexArray(_vertexBuffer._vao);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
+  GLStateCache::Get().BindVertexArray(_vertexBuffer._vao);
+  GLStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
 
   glDrawElementsBaseVertex(sceneInfo.renderType,
                            _quadMesh.IndexCount(),
                            GL_UNSIGNED_INT,
                            (void*)(_quadMesh.GetIndexOffset() * sizeof(GLuint)),
                            _quadMesh.GetVertexOffset());
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
 }
 
 void VideoRenderer::BufferTexture(int width, int height, GLuint tex, unsigned char* pixels)
@@ -55,15 +55,10 @@ void VoxelRenderer::RenderPass(const SceneInfo& sceneInfo)
     glUniformMatrix4fv(shader.getUniform("MVP"), 1, GL_FALSE, &mvp[0][0]);
     glUniform3fv(shader.getUniform("light_dir"), 1, &(ldir[0]));
 
-    glBindVertexArray(_instancedVertexBuffer._vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
-    glBindBuffer(GL_ARRAY_BUFFER, _instancedVertexBuffer._ibo);
+    GLStateCache::Get().BindVertexArray(_instancedVertexBuffer._vao);
+    GLStateCache::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer._vio);
 
     glDrawElementsInstanced(sceneInfo.renderType, _indexBuffer._indices.size(), GL_UNSIGNED_INT, 0, _instancedVertexBuffer.InstanceCount());
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
   }
 }
 
@@ -0,0 +1,25 @@
+#version 330 core
+
+/****************
+  FRAGMENT shader
+  Same lighting as simpleLit.frag, with the color passed in from the vertex shader.
+*****************/
+
+uniform vec3 light_dir;
+uniform bool lightAlpha = false;
+
+in vec3 frag_normal;
+in vec4 frag_color;
+out vec4 outColor;
+
+void main()
+{
+  float d = dot( normalize(frag_normal), normalize(light_dir) );
+
+  outColor = frag_color * mix(0.5, 1.0, d);
+
+  if (!lightAlpha)
+  {
+    outColor.a = frag_color.a;
+  }
+}
@@ -0,0 +1,33 @@
+#version 330 core
+
+/****************
+  VERTEX shader
+  Like simpleNormal.vert, but reads the model matrix and color of each vertex's object
+  from a buffer texture, so many meshes can be drawn with a single call.
+*****************/
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in uint objectIndex;
+
+uniform mat4 VP;
+uniform mat4 V;
+uniform samplerBuffer objects; // 5 texels per object: model matrix columns, color
+
+out vec3 frag_normal;
+out vec4 frag_color;
+
+void main()
+{
+  int base = int(objectIndex) * 5;
+  mat4 M = mat4(texelFetch(objects, base),
+                texelFetch(objects, base + 1),
+                texelFetch(objects, base + 2),
+                texelFetch(objects, base + 3));
+
+  gl_Position = VP * M * vec4(vertexPosition, 1.0);
+
+  // transform surface normal & pass to fragment shader
+  frag_normal = (V * M * vec4(normal, 0)).xyz;
+  frag_color = texelFetch(objects, base + 4);
+}
@@ -0,0 +1,42 @@
+#version 330 core
+
+/****************
+  VERTEX shader
+  Unprojects a depth image, one vertex per pixel (drawn as points without vertex attributes).
+  The position is in the camera frame of the depth sensor: x right, y down, z forward.
+  Pixels without a depth measurement are moved outside of the view volume.
+*****************/
+
+uniform usampler2D depthTexture;
+uniform sampler2D colorTexture;
+uniform bool colored;
+
+uniform int width;
+uniform vec2 focalLength;
+uniform vec2 principalPoint;
+uniform float depthScale;
+
+uniform mat4 MVP;
+uniform mat4 M;
+
+uniform float fadeDepth = 5.0f;
+
+out vec4 frag_color;
+
+void main()
+{
+  ivec2 pixel = ivec2(gl_VertexID % width, gl_VertexID / width);
+  uint depth = texelFetch(depthTexture, pixel, 0).r;
+
+  float z = float(depth) * depthScale;
+  vec3 position = vec3((vec2(pixel) - principalPoint) * z / focalLength, z);
+
+  gl_Position = depth == 0u ? vec4(0.0, 0.0, 2.0, 1.0) : MVP * vec4(position, 1.0);
+
+  vec4 posWorldSpace = M * vec4(position, 1.0);
+
+  // same fading as regular point clouds
+  float inverseDepth = (fadeDepth - posWorldSpace.z + 1.0f) / fadeDepth;
+  vec3 color = colored ? texelFetch(colorTexture, pixel, 0).rgb : vec3(1.0f);
+  frag_color = vec4(color, inverseDepth);
+}
@@ -4,6 +4,8 @@
   VERTEX shader
   Applies the given Model-View-Projection matrix to each vertex.
   Passes an interpolated vertex color to the fragment shader.
+  With QUANTIZED, positions are normalized to 0..1 within the bounding box of the cloud.
+  ageAlpha fades out old frames of clouds with history.
 *****************/
 
 layout(location = 0) in vec4 vertexPosition;
@@ -15,22 +17,34 @@ uniform mat4 MVP;
 uniform mat4 M;
 
 uniform float fadeDepth = 5.0f;
+uniform float ageAlpha = 1.0f;
+
+#ifdef QUANTIZED
+uniform vec3 quantizationMin;
+uniform vec3 quantizationExtent;
+#endif
 
 out vec4 frag_color;
 
 void main()
 {
-  gl_Position = MVP * vec4(vertexPosition.xyz, 1.0);
+  #ifdef QUANTIZED
+  vec3 position = quantizationMin + vertexPosition.xyz * quantizationExtent;
+  #else
+  vec3 position = vertexPosition.xyz;
+  #endif
+
+  gl_Position = MVP * vec4(position, 1.0);
 
-  vec4 posWorldSpace = M * vec4(vertexPosition.xyz, 1.0);
+  vec4 posWorldSpace = M * vec4(position, 1.0);
 
   // Point cloud starts at z = 1.0
   float inverseDepth = (fadeDepth - posWorldSpace.z + 1.0f) / fadeDepth;
   // Fade out with increasing depth
   #ifdef WITH_COLOR
-  vec3 color = vertexColor.bgr;
+  vec3 color = vertexColor.rgb;
   #else
   vec3 color = vec3(1.0f);
   #endif
-  frag_color = vec4(color, inverseDepth);
+  frag_color = vec4(color, inverseDepth * ageAlpha);
 }
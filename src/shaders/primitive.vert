@@ -0,0 +1,60 @@
+#version 330 core
+
+/****************
+  VERTEX shader
+  Draws instances of a unit shape, each with its own transform and color.
+  Capsules are unit spheres whose halves are moved apart along the x axis.
+*****************/
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 normal;
+
+// instance data
+layout(location = 2) in vec4 row0; // rows of the object transform
+layout(location = 3) in vec4 row1;
+layout(location = 4) in vec4 row2;
+layout(location = 5) in vec4 color;
+
+uniform mat4 VP;
+uniform mat4 V;
+uniform bool capsule = false;
+uniform bool onlyOpaque = true;
+
+out vec3 frag_normal;
+out vec4 frag_color;
+
+void main()
+{
+  frag_color = color;
+
+  // each pass only draws its own instances, hidden instances have no transform
+  if ((color.a >= 1.0) != onlyOpaque || dot(row1.xyz, row1.xyz) == 0.0)
+  {
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+    frag_normal = vec3(0.0);
+    return;
+  }
+
+  mat4 M = transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+
+  vec3 position;
+  vec3 worldNormal;
+  if (capsule)
+  {
+    // the x column is half the axis between the centers, the y and z columns are scaled by the radius
+    float radius = length(M[1].xyz);
+    vec3 axis = cross(M[1].xyz, M[2].xyz) / radius;
+
+    position = M[3].xyz + sign(vertexPosition.x) * M[0].xyz +
+               axis * vertexPosition.x + M[1].xyz * vertexPosition.y + M[2].xyz * vertexPosition.z;
+    worldNormal = (axis * normal.x + M[1].xyz * normal.y + M[2].xyz * normal.z) / radius;
+  }
+  else
+  {
+    position = (M * vec4(vertexPosition, 1.0)).xyz;
+    worldNormal = (M * vec4(normal, 0.0)).xyz;
+  }
+
+  gl_Position = VP * vec4(position, 1.0);
+  frag_normal = (V * vec4(worldNormal, 0.0)).xyz;
+}
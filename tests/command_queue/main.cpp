@@ -0,0 +1,113 @@
+#include <cstdio>
+
+#include "CommandQueue.hpp"
+#include "CommandPool.hpp"
+
+/*
+  Checks that the command queue and the coalescer keep every update of a point cloud with history.
+
+  The updates are queued the way the renderer queues its point cloud updates: a cloud with history
+  keeps its last <NumFrames> uploads, so none of its updates may be dropped or coalesced, while the
+  updates of a cloud without history replace each other.
+  Every case enqueues all updates before the consumer runs, so the queue is over budget for most of them.
+*/
+
+static constexpr unsigned int CloudHandle = 1;
+static constexpr size_t NumFrames = 8;
+
+// Stands in for the render thread's cloud, counts the uploads it keeps like <HistoryPointCloud>
+struct FakeCloud
+{
+  size_t numUploads = 0;
+};
+
+// Mirrors the coalescing rules of the renderer's point cloud update
+class UpdateCommand : public ar::PooledRenderCommand<UpdateCommand>
+{
+public:
+  using PooledRenderCommand::PooledRenderCommand;
+
+  void init(FakeCloud* cloud, bool keepsHistory)
+  {
+    _cloud = cloud;
+    _keepsHistory = keepsHistory;
+    _points.assign(1024, 0.0f);
+  }
+
+  virtual void execute() override { _cloud->numUploads++; }
+
+  virtual CoalesceType coalesceType() const override { return CoalesceType::PointCloud; }
+  virtual unsigned int coalesceHandle() const override { return CloudHandle; }
+  virtual bool supersedes() const override { return !_keepsHistory; }
+  virtual size_t payloadSize() const override { return _points.size() * sizeof(float); }
+  virtual void discardPayload() override { ar::Vector<float>().swap(_points); }
+
+private:
+  FakeCloud* _cloud = nullptr;
+  bool _keepsHistory = false;
+  ar::Vector<float> _points;
+};
+
+static const char* policyName(ar::QueuePolicy policy)
+{
+  switch (policy)
+  {
+  case ar::QueuePolicy::Block: return "Block";
+  case ar::QueuePolicy::DropOldestPerHandle: return "DropOldestPerHandle";
+  case ar::QueuePolicy::Reject: return "Reject";
+  }
+  return "?";
+}
+
+// Enqueues <numUpdates> updates, then drains and coalesces them like the render thread
+// @return Number of uploads the cloud received
+static size_t runUpdates(ar::QueuePolicy policy, bool keepsHistory, size_t numUpdates)
+{
+  ar::RenderCommandPool<UpdateCommand> pool(numUpdates);
+  ar::CommandQueue queue;
+  // room for two updates, so most of them arrive while the queue is over budget
+  queue.SetBudget(ar::QueueBudget(2, 0, policy));
+
+  FakeCloud cloud;
+  for (size_t i = 0; i < numUpdates; i++)
+  {
+    UpdateCommand* command = pool.Acquire();
+    command->init(&cloud, keepsHistory);
+    queue.Enqueue(command);
+  }
+
+  ar::Vector<ar::RenderCommand*> commands;
+  queue.DequeueAll(commands);
+  ar::CommandCoalescer coalescer;
+  coalescer.Coalesce(commands);
+  for (ar::RenderCommand* command : commands)
+  {
+    command->execute();
+    command->release();
+  }
+  return cloud.numUploads;
+}
+
+int main()
+{
+  int numFailures = 0;
+
+  // Block would wait for a consumer, which only runs after all updates were enqueued here
+  const ar::QueuePolicy policies[] = { ar::QueuePolicy::DropOldestPerHandle, ar::QueuePolicy::Reject };
+  for (ar::QueuePolicy policy : policies)
+  {
+    const size_t numUploads = runUpdates(policy, true, NumFrames);
+    const size_t numFrames = numUploads < NumFrames ? numUploads : NumFrames;
+    const bool passed = numFrames == NumFrames;
+    std::printf("%-20s history:    %2d updates -> %2d frames kept  %s\n", policyName(policy), (int)NumFrames, (int)numFrames, passed ? "ok" : "FAILED");
+    numFailures += passed ? 0 : 1;
+
+    // without history only the newest update is needed, the check above would not notice the updates being kept otherwise
+    const size_t numReplacingUploads = runUpdates(policy, false, NumFrames);
+    const bool replaced = numReplacingUploads == 1;
+    std::printf("%-20s no history: %2d updates -> %2d uploaded      %s\n", policyName(policy), (int)NumFrames, (int)numReplacingUploads, replaced ? "ok" : "FAILED");
+    numFailures += replaced ? 0 : 1;
+  }
+
+  return numFailures == 0 ? 0 : 1;
+}